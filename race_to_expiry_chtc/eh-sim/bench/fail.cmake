@@ -0,0 +1,2 @@
+# Fails a benchmark target that is not configured, see eh-sim-bench in CMakeLists.txt.
+message(FATAL_ERROR "${MESSAGE}")
@@ -0,0 +1,83 @@
+#include "cache_profile.hpp"
+
+#include <thumbulator/stack_distance.hpp>
+
+#include <functional>
+#include <ostream>
+
+#include "scheme/data_sheet.hpp"
+
+namespace ehsim {
+
+namespace {
+
+/**
+ * Write one line per geometry, for every power of two ways and fully-associative caches.
+ *
+ * @param hit_energy The energy of the hits of a geometry.
+ * @param miss_energy The energy of the misses of a geometry.
+ */
+void write_curves(std::ostream &stream,
+    thumbulator::stack_distance_profiler const &profile,
+    std::function<double(thumbulator::cache_profile_point const &)> const &hit_energy,
+    std::function<double(thumbulator::cache_profile_point const &)> const &miss_energy)
+{
+  stream << "associativity, size, sets, ways, loads, load_misses, stores, store_misses, miss_ratio, "
+            "writebacks, hit_energy, miss_energy\n";
+
+  auto const write_curve = [&](size_t ways) {
+    for(auto const &point : profile.miss_curve(ways)) {
+      if(ways == 0) {
+        stream << "full, ";
+      } else {
+        stream << ways << ", ";
+      }
+      stream << point.size << ", " << point.sets << ", " << point.ways << ", "
+             << point.load_hits + point.load_misses << ", " << point.load_misses << ", "
+             << point.store_hits + point.store_misses << ", " << point.store_misses << ", "
+             << point.miss_ratio() << ", " << point.writebacks << ", " << hit_energy(point) << ", "
+             << miss_energy(point) << "\n";
+    }
+  };
+
+  for(size_t ways = 1; ways <= profile.get_max_assoc(); ways *= 2) {
+    write_curve(ways);
+  }
+  write_curve(0);
+}
+}
+
+void write_icache_profile(std::ostream &stream,
+    thumbulator::stack_distance_profiler const &profile,
+    cache_energy_model const &energy)
+{
+  auto const words = profile.get_block_size() >> 2;
+
+  write_curves(stream, profile,
+      [&](thumbulator::cache_profile_point const &point) {
+        return point.hits() * energy.icache_read_energy;
+      },
+      [&](thumbulator::cache_profile_point const &point) {
+        return point.misses() * (words * CORTEX_M0PLUS_ENERGY_FLASH + energy.icache_write_energy);
+      });
+}
+
+void write_dcache_profile(std::ostream &stream,
+    thumbulator::stack_distance_profiler const &profile,
+    cache_energy_model const &energy)
+{
+  auto const words = profile.get_block_size() >> 2;
+
+  write_curves(stream, profile,
+      [&](thumbulator::cache_profile_point const &point) {
+        return point.load_hits * (energy.dcache_read_energy + 2 * energy.lbf_access_energy)
+               + point.store_hits * (energy.dcache_write_energy + 2 * energy.lbf_access_energy);
+      },
+      [&](thumbulator::cache_profile_point const &point) {
+        // the line is filled from memory, the dirty victim written back
+        return point.misses() * (energy.dcache_write_energy + words * energy.lbf_access_energy
+                                    + words * CORTEX_M0PLUS_ENERGY_FLASH)
+               + point.writebacks * words * CORTEX_M0PLUS_ENERGY_FLASH;
+      });
+}
+}
@@ -0,0 +1,43 @@
+#ifndef EH_SIM_CACHE_PROFILE_HPP
+#define EH_SIM_CACHE_PROFILE_HPP
+
+#include <iosfwd>
+
+namespace thumbulator {
+class stack_distance_profiler;
+}
+
+namespace ehsim {
+
+/**
+ * The cache access energies of the mem_rename scheme (nJ), see its constructor.
+ */
+struct cache_energy_model {
+  double icache_read_energy = 0;
+  double icache_write_energy = 0;
+  double dcache_read_energy = 0;
+  double dcache_write_energy = 0;
+  double lbf_access_energy = 0;
+};
+
+/**
+ * Write the miss curves of an instruction cache profile as CSV, one line per cache geometry.
+ *
+ * Every geometry comes with the energy mem_rename would spend on its hits, and on its misses
+ * refilling lines from memory, so the caches worth a full simulation can be picked from one run.
+ */
+void write_icache_profile(std::ostream &stream,
+    thumbulator::stack_distance_profiler const &profile,
+    cache_energy_model const &energy);
+
+/**
+ * Write the miss curves of a data cache profile as CSV, one line per cache geometry.
+ *
+ * The miss energy includes refilling lines and writing back dirty ones, as mem_rename models it.
+ */
+void write_dcache_profile(std::ostream &stream,
+    thumbulator::stack_distance_profiler const &profile,
+    cache_energy_model const &energy);
+}
+
+#endif //EH_SIM_CACHE_PROFILE_HPP
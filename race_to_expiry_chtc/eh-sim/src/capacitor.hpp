@@ -64,19 +64,27 @@ public:
   }
 
   /**
+   * The voltage is only derived from the stored energy when it is asked for, since energy changes
+   * with every instruction but the voltage is rarely needed.
+   *
    * @return The voltage in volts (V).
    */
   double voltage() const
   {
+    if(!voltage_valid) {
+      update_voltage();
+    }
+
     return V;
   }
 
   /**
    * Updates the current voltage across capacitor based on current energy stored
    */
-  void update_voltage()
+  void update_voltage() const
   {
     V = sqrt(2 * energy * 1e-9 / C);
+    voltage_valid = true;
   }
 
   /**
@@ -106,7 +114,7 @@ public:
     assert(energy - energy_to_consume >= 0);
 
     energy -= energy_to_consume;
-    update_voltage();
+    voltage_valid = false;
   }
 
   /**
@@ -127,7 +135,7 @@ public:
 
     // clamp to maximum energy, avoiding floating point precision errors
     energy = std::min(energy + can_harvest, maximum_energy);
-    update_voltage();
+    voltage_valid = false;
 
     return can_harvest;
   }
@@ -141,8 +149,9 @@ private:
   double maxV;
   // maximum current
   double maxI;
-  // voltage across the capacitor
-  double V;
+  // voltage across the capacitor, valid only if voltage_valid is set
+  mutable double V;
+  mutable bool voltage_valid = true;
   // stored energy in nJ
   double energy;
 };
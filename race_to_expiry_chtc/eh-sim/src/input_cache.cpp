@@ -0,0 +1,96 @@
+#include "input_cache.hpp"
+
+#include <thumbulator/execution_trace.hpp>
+#include <thumbulator/program.hpp>
+
+#include "liveness_trace.hpp"
+#include "static_liveness.hpp"
+#include "spendthrift_model.hpp"
+#include "voltage_trace.hpp"
+
+namespace ehsim {
+
+template <typename T>
+std::shared_ptr<T> input_cache::get_or_load(entries<T> &cache,
+    std::string const &key,
+    std::function<std::shared_ptr<T>()> const &load)
+{
+  std::promise<std::shared_ptr<T>> loaded;
+  std::shared_future<std::shared_ptr<T>> pending;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto const existing = cache.find(key);
+    if(existing == cache.end()) {
+      cache.emplace(key, loaded.get_future().share());
+    } else {
+      pending = existing->second;
+    }
+  }
+
+  if(pending.valid()) {
+    // somebody else is loading or has loaded it
+    return pending.get();
+  }
+
+  // load outside the lock so different inputs load in parallel
+  try {
+    auto value = load();
+    loaded.set_value(value);
+    return value;
+  } catch(...) {
+    loaded.set_exception(std::current_exception());
+    throw;
+  }
+}
+
+std::shared_ptr<thumbulator::program_image const> input_cache::binary(
+    std::string const &path_to_binary)
+{
+  return get_or_load<thumbulator::program_image const>(binaries, path_to_binary, [&]() {
+    return std::make_shared<thumbulator::program_image const>(
+        thumbulator::load_program(path_to_binary));
+  });
+}
+
+std::shared_ptr<voltage_trace const> input_cache::voltages(std::string const &path_to_trace,
+    std::chrono::milliseconds const &sample_period)
+{
+  auto const key = path_to_trace + "@" + std::to_string(sample_period.count());
+  return get_or_load<voltage_trace const>(voltage_traces, key, [&]() {
+    return std::make_shared<voltage_trace const>(path_to_trace, sample_period);
+  });
+}
+
+std::shared_ptr<liveness_trace const> input_cache::liveness(bool use_liveness,
+    std::string const &path_to_trace)
+{
+  auto const key = use_liveness ? path_to_trace : std::string();
+  return get_or_load<liveness_trace const>(liveness_traces, key, [&]() {
+    return std::make_shared<liveness_trace const>(use_liveness, path_to_trace);
+  });
+}
+
+std::shared_ptr<static_liveness const> input_cache::static_register_liveness(
+    std::string const &path_to_binary)
+{
+  return get_or_load<static_liveness const>(static_liveness_tables, path_to_binary, [&]() {
+    return std::make_shared<static_liveness const>(*binary(path_to_binary));
+  });
+}
+
+std::shared_ptr<thumbulator::execution_trace const> input_cache::execution_trace(
+    std::string const &path_to_trace)
+{
+  return get_or_load<thumbulator::execution_trace const>(execution_traces, path_to_trace, [&]() {
+    return std::make_shared<thumbulator::execution_trace const>(path_to_trace);
+  });
+}
+
+std::shared_ptr<spendthrift_model> input_cache::spendthrift(std::string const &key,
+    std::function<std::unique_ptr<spendthrift_model>()> const &load)
+{
+  return get_or_load<spendthrift_model>(
+      spendthrift_models, key, [&]() { return std::shared_ptr<spendthrift_model>(load()); });
+}
+}
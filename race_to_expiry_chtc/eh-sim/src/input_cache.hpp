@@ -0,0 +1,83 @@
+#ifndef EH_SIM_INPUT_CACHE_HPP
+#define EH_SIM_INPUT_CACHE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace thumbulator {
+class execution_trace;
+struct program_image;
+}
+
+namespace ehsim {
+
+class voltage_trace;
+class liveness_trace;
+class static_liveness;
+class spendthrift_model;
+
+/**
+ * Loads the inputs of a simulation once and shares them read-only between simulations.
+ *
+ * All methods can be called from several threads. An input is loaded by the first thread that asks
+ * for it, other threads asking for the same input wait for that load instead of repeating it.
+ */
+class input_cache {
+public:
+  /**
+   * An application, an ELF executable or a flash image.
+   */
+  std::shared_ptr<thumbulator::program_image const> binary(std::string const &path_to_binary);
+
+  std::shared_ptr<voltage_trace const> voltages(std::string const &path_to_trace,
+      std::chrono::milliseconds const &sample_period);
+
+  std::shared_ptr<liveness_trace const> liveness(bool use_liveness, std::string const &path_to_trace);
+
+  /**
+   * The register liveness computed from an application binary.
+   */
+  std::shared_ptr<static_liveness const> static_register_liveness(std::string const &path_to_binary);
+
+  /**
+   * An execution trace recorded with record-trace, replayed by any number of simulations.
+   */
+  std::shared_ptr<thumbulator::execution_trace const> execution_trace(
+      std::string const &path_to_trace);
+
+  /**
+   * A spendthrift model, loaded with the given function the first time the key is seen.
+   *
+   * The key has to identify everything the loader depends on.
+   */
+  std::shared_ptr<spendthrift_model> spendthrift(std::string const &key,
+      std::function<std::unique_ptr<spendthrift_model>()> const &load);
+
+private:
+  template <typename T>
+  using entries = std::map<std::string, std::shared_future<std::shared_ptr<T>>>;
+
+  std::mutex mutex;
+
+  entries<thumbulator::program_image const> binaries;
+  entries<voltage_trace const> voltage_traces;
+  entries<liveness_trace const> liveness_traces;
+  entries<static_liveness const> static_liveness_tables;
+  entries<thumbulator::execution_trace const> execution_traces;
+  entries<spendthrift_model> spendthrift_models;
+
+  template <typename T>
+  std::shared_ptr<T> get_or_load(entries<T> &cache,
+      std::string const &key,
+      std::function<std::shared_ptr<T>()> const &load);
+};
+}
+
+#endif //EH_SIM_INPUT_CACHE_HPP
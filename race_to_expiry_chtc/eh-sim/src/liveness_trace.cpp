@@ -1,10 +1,22 @@
 #include "liveness_trace.hpp"
 
+#include <thumbulator/instrumentation.hpp>
+
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <sstream>
 
 namespace ehsim {
+
+namespace {
+std::set<uint64_t> const no_dead_items;
+
+// number of entries a cursor steps forward before it falls back to a binary search
+constexpr size_t MAX_LINEAR_STEPS = 8;
+}
+
 liveness_trace::liveness_trace(bool use_liveness, std::string const &path_to_trace)
 {
   if(use_liveness) {
@@ -14,6 +26,8 @@ liveness_trace::liveness_trace(bool use_liveness, std::string const &path_to_tra
 
     std::ifstream trace(path_to_trace);
 
+    // entries may be out of order, the first one for a cycle wins
+    std::map<uint64_t, std::set<uint64_t>> liveness;
     while(getline(trace, line)) {
       std::istringstream iss(line);
       if(iss >> cycle) {
@@ -29,22 +43,83 @@ liveness_trace::liveness_trace(bool use_liveness, std::string const &path_to_tra
         liveness.emplace(cycle, dead_item_set);
       } 
     }
+
+    cycles.reserve(liveness.size());
+    dead_items.reserve(liveness.size());
+    dead_registers.reserve(liveness.size());
+    for(auto &entry : liveness) {
+      uint16_t mask = 0;
+      for(auto const item : entry.second) {
+        if(item < 16) {
+          mask |= 1u << item;
+        }
+      }
+
+      cycles.push_back(entry.first);
+      dead_items.push_back(std::move(entry.second));
+      dead_registers.push_back(mask);
+    }
   }
 }
 
-const std::set<uint64_t> liveness_trace::get_liveness(uint64_t const cycle) const
+size_t liveness_trace::find(uint64_t const cycle, size_t hint) const
 {
-  // find the liveness count from the cycle provided or immediate lower cycle
-  if(liveness.find(cycle) != liveness.end()) {
-    return liveness.at(cycle);
+  auto found = cycles.size();
+
+  auto begin = cycles.begin();
+  if(hint < cycles.size() && cycles[hint] <= cycle) {
+    for(size_t step = 0; step < MAX_LINEAR_STEPS && found == cycles.size(); ++step, ++hint) {
+      if(hint + 1 == cycles.size() || cycles[hint + 1] > cycle) {
+        found = hint;
+      }
+    }
+
+    begin += hint;
   }
 
-  for(uint64_t i=cycle-1; i>0; i--) {
-    if(liveness.find(i) != liveness.end()) {
-      return liveness.at(i);
+  if(found == cycles.size()) {
+    auto const next = std::upper_bound(begin, cycles.end(), cycle);
+    if(next == cycles.begin()) {
+      return cycles.size();
     }
+
+    found = static_cast<size_t>(next - cycles.begin()) - 1;
+  }
+
+  // an entry at cycle 0 only applies to cycle 0
+  if(cycles[found] == 0 && cycle != 0) {
+    return cycles.size();
   }
 
-  return std::set<uint64_t>();
+  return found;
+}
+
+std::set<uint64_t> const &liveness_trace::get_liveness(uint64_t const cycle) const
+{
+  auto const entry = find(cycle, cycles.size());
+
+  return entry < cycles.size() ? dead_items[entry] : no_dead_items;
+}
+
+uint16_t liveness_trace::get_register_liveness(uint64_t const cycle) const
+{
+  auto const entry = find(cycle, cycles.size());
+
+  return entry < cycles.size() ? dead_registers[entry] : 0;
+}
+
+std::set<uint64_t> const &liveness_cursor::get_liveness(uint64_t const cycle)
+{
+  thumbulator::instrumentation::scoped_timer timer(thumbulator::instrumentation::stage::liveness);
+  entry = trace.find(cycle, entry);
+
+  return entry < trace.cycles.size() ? trace.dead_items[entry] : no_dead_items;
+}
+
+uint16_t liveness_cursor::get_register_liveness(uint64_t const cycle)
+{
+  entry = trace.find(cycle, entry);
+
+  return entry < trace.cycles.size() ? trace.dead_registers[entry] : 0;
 }
 }
@@ -2,9 +2,10 @@
 #define EH_SIM_LIVENESS_TRACE_HPP
 
 #include <chrono>
+#include <cstdint>
 #include <string>
-#include <map>
 #include <set>
+#include <vector>
 
 namespace ehsim {
 class liveness_trace {
@@ -17,17 +18,67 @@ public:
   liveness_trace(bool use_liveness, std::string const &path_to_trace);
 
   /**
-   * Get the liveness count at the specified cycle.
+   * Get the dead items at the specified cycle.
    *
    * @param cycle in number of cycles.
    *
-   * @return The liveness count.
+   * @return The dead items of the last entry at or before the cycle, owned by the trace.
    */
-  const std::set<uint64_t> get_liveness(uint64_t const cycle) const;
+  std::set<uint64_t> const &get_liveness(uint64_t const cycle) const;
+
+  /**
+   * Get the dead registers at the specified cycle.
+   *
+   * @param cycle in number of cycles.
+   *
+   * @return Bit i is set if register i is dead.
+   */
+  uint16_t get_register_liveness(uint64_t const cycle) const;
 
 private:
+  friend class liveness_cursor;
 
-  std::map<uint64_t, std::set<uint64_t>> liveness;
+  // entry i is in effect from cycles[i] until the next entry
+  std::vector<uint64_t> cycles;
+  std::vector<std::set<uint64_t>> dead_items;
+  std::vector<uint16_t> dead_registers;
+
+  /**
+   * Find the entry in effect at a cycle.
+   *
+   * @param cycle in number of cycles.
+   * @param hint An entry at or before the one searched for, or cycles.size() if unknown.
+   *
+   * @return The index of the entry, or cycles.size() if there is none.
+   */
+  size_t find(uint64_t const cycle, size_t hint) const;
+};
+
+/**
+ * Looks up a liveness trace at (mostly) increasing cycles.
+ *
+ * Remembers the last entry found, so queries moving forward in time take amortized constant time.
+ * The trace may be shared by several cursors, each simulation keeps its own.
+ */
+class liveness_cursor {
+public:
+  explicit liveness_cursor(liveness_trace const &trace) : trace(trace), entry(trace.cycles.size())
+  {
+  }
+
+  /**
+   * Get the dead items at the specified cycle, see liveness_trace::get_liveness.
+   */
+  std::set<uint64_t> const &get_liveness(uint64_t const cycle);
+
+  /**
+   * Get the dead registers at the specified cycle, see liveness_trace::get_register_liveness.
+   */
+  uint16_t get_register_liveness(uint64_t const cycle);
+
+private:
+  liveness_trace const &trace;
+  size_t entry;
 };
 }
 
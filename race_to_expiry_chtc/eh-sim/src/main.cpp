@@ -1,25 +1,46 @@
 #include <argagg/argagg.hpp>
+#include <thumbulator/benchmark.hpp>
+#include <thumbulator/execution_trace.hpp>
+#include <thumbulator/instrumentation.hpp>
+#include <thumbulator/program.hpp>
+#include <thumbulator/replacement.hpp>
+#include <thumbulator/stack_distance.hpp>
 
+#include <chrono>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
 
 #include "scheme/backup_every_cycle.hpp"
 #include "scheme/clank.hpp"
 #include "scheme/parametric.hpp"
 #include "scheme/mem_rename.hpp"
 
+#include "cache_profile.hpp"
+#include "input_cache.hpp"
+#include "profiler.hpp"
 #include "simulate.hpp"
+#include "simulation.hpp"
+#include "spendthrift_model.hpp"
+#include "sweep.hpp"
 #include "voltage_trace.hpp"
 #include "liveness_trace.hpp"
+#include "static_liveness.hpp"
 
 void print_usage(std::ostream &stream, argagg::parser const &arguments)
 {
   argagg::fmt_ostream help(stream);
 
   help << "Simulate an energy harvesting environment.\n\n";
-  help << "simulate [options] ARG [ARG...]\n\n";
+  help << "simulate [options] ARG [ARG...]\n";
+  help << "simulate sweep --manifest=FILE [--threads=N] [--fork]\n";
+  help << "simulate bench --manifest=FILE [--baseline=FILE] [--threshold=PERCENT] [--output=FILE]\n\n";
   help << arguments;
 }
 
@@ -47,10 +68,9 @@ void validate(argagg::parser_results const &options)
   auto const path_to_voltage_trace = options["voltages"].as<std::string>();
   ensure_file_exists(path_to_voltage_trace);
 
-  std::string path_to_reg_liveness_trace = "";
-  if(options["use_reg_lva"].as<int>(1) == 1) { 
-    path_to_reg_liveness_trace = options["reg_liveness"].as<std::string>();
-    ensure_file_exists(path_to_reg_liveness_trace);
+  // without a register liveness trace, liveness is computed from the binary
+  if(options["use_reg_lva"].as<int>(1) == 1 && options["reg_liveness"].count() > 0) {
+    ensure_file_exists(options["reg_liveness"].as<std::string>());
   }
 
   std::string path_to_mem_liveness_trace = "";
@@ -62,14 +82,31 @@ void validate(argagg::parser_results const &options)
   if(options["rate"].count() == 0) {
     throw std::runtime_error("No sampling rate provided for the voltage trace.");
   }
+
+  if(options["replay_trace"].count() > 0) {
+    ensure_file_exists(options["replay_trace"].as<std::string>());
+  }
+
+#ifndef EH_SIM_PROFILER
+  if(options["profile"].count() > 0) {
+    throw std::runtime_error("Profiling is not built in, configure with -DEH_SIM_PROFILER=ON.");
+  }
+#endif
+
+#ifndef THUMBULATOR_INSTRUMENT
+  if(options["instrumentation_json"].count() > 0) {
+    throw std::runtime_error(
+        "Instrumentation is not built in, configure with -DTHUMBULATOR_INSTRUMENT=ON.");
+  }
+#endif
 }
 
-int main(int argc, char *argv[])
+argagg::parser make_parser()
 {
-  argagg::parser arguments{{{"help", {"-h", "--help"}, "display help information", 0},
-      {"voltages", {"--voltage-trace"}, "path to voltage trace", 1},
+  return argagg::parser{{{"help", {"-h", "--help"}, "display help information", 0},
+      {"voltages", {"--voltage-trace"}, "path to voltage trace, text or converted with convert-voltage-trace", 1},
       {"use_reg_lva", {"--reg-lva"}, "use register liveness analysis", 1},
-      {"reg_liveness", {"--reg-liveness-trace"}, "path to register liveness trace", 1},
+      {"reg_liveness", {"--reg-liveness-trace"}, "path to register liveness trace, computed from the binary if omitted", 1},
       {"use_mem_lva", {"--mem-lva"}, "use memory liveness analysis", 1},
       {"mem_liveness", {"--mem-liveness-trace"}, "path to memory liveness trace", 1},
       {"rate", {"--voltage-rate"}, "sampling rate of voltage trace (microseconds)", 1},
@@ -77,6 +114,7 @@ int main(int argc, char *argv[])
       {"scheme", {"--scheme"}, "the checkpointing scheme to use", 1},
       {"tau_B", {"--tau-b"}, "the backup period for the parametric scheme", 1},
       {"binary", {"-b", "--binary"}, "path to application binary", 1},
+      {"replay_trace", {"--replay-trace"}, "replay this execution trace of the binary, recorded with record-trace, instead of emulating it", 1},
       {"rf_entries", {"--rf-entries"}, "size of read first buffer", 1},
       {"wf_entries", {"--wf-entries"}, "size of write first buffer", 1},
       {"wb_entries", {"--wb-entries"}, "size of write back buffer", 1},
@@ -85,9 +123,11 @@ int main(int argc, char *argv[])
       {"icache_assoc", {"--icache-assoc"}, " instruction cache associativity", 1},
       {"icache_block_size", {"--icache-block-size"}, " instruction cache block size", 1},
       {"icache_size", {"--icache-size"}, " instruction cache size", 1},
+      {"icache_policy", {"--icache-policy"}, " instruction cache replacement: counter (default), lru, plru, fifo, random, srrip", 1},
       {"dcache_assoc", {"--dcache-assoc"}, " data cache associativity", 1},
       {"dcache_block_size", {"--dcache-block-size"}, " data cache block size", 1},
       {"dcache_size", {"--dcache-size"}, " data cache size", 1},
+      {"dcache_policy", {"--dcache-policy"}, " data cache replacement: counter (default), lru, plru, fifo, random, srrip", 1},
       {"use_optimal_backup_scheme", {"--use-optimal-backup-scheme"}, "use optimal backup scheme for mem_rename", 1},
       {"add_renamer", {"--add-renamer"}, "add renamer to scheme", 1},
       {"reclaim_addr", {"--reclaim-addr"}, "reclaim original program address if available in free list", 1},
@@ -109,175 +149,896 @@ int main(int argc, char *argv[])
       {"map_table_leakage_power", {"--map-table-leakage-power"}, "map table leakage power", 1},
       {"free_list_read_energy", {"--free-list-read-energy"}, "free list read energy", 1},
       {"free_list_leakage_power", {"--free-list-leakage-power"}, "free list leakage power", 1},
+      {"spendthrift_backend", {"--spendthrift-backend"}, "spendthrift model backend (torch, native, compare, table)", 1},
+      {"spendthrift_model", {"--spendthrift-model"}, "path to traced spendthrift model", 1},
+      {"spendthrift_weights", {"--spendthrift-weights"}, "path to flat spendthrift weight file", 1},
+      {"table_voltages", {"--spendthrift-table-voltages"}, "number of voltages in the spendthrift decision table", 1},
+      {"table_energies", {"--spendthrift-table-energies"}, "number of energies sampled per voltage for the spendthrift decision table", 1},
+      {"export_weights", {"--export-spendthrift-weights"}, "write the spendthrift weights to a flat file and exit", 1},
+      {"cache_profile", {"--cache-profile"}, "profile every cache size at the cache block sizes in one run and write the miss curves to PREFIX.icache.csv and PREFIX.dcache.csv", 1},
+      {"cache_profile_max_size", {"--cache-profile-max-size"}, "largest cache size profiled in bytes (default 8192)", 1},
+      {"cache_profile_max_assoc", {"--cache-profile-max-assoc"}, "most cache ways profiled, 0 (default) for up to fully associative", 1},
+      {"profile", {"--profile"}, "profile the program by function and write PREFIX.cycles.folded, PREFIX.energy.folded and PREFIX.profile.txt", 1},
+      {"instrumentation_json", {"--instrumentation-json"}, "write the host time of each simulation stage to this JSON file, needs THUMBULATOR_INSTRUMENT", 1},
+      {"stdout", {"--stdout"}, "write the simulation output to this file instead of standard output", 1},
       {"output", {"-o", "--output"}, "output file", 1}}};
+}
 
-  try {
-    auto const options = arguments.parse(argc, argv);
-    if(options["help"]) {
-      print_usage(std::cout, arguments);
-      return EXIT_SUCCESS;
+std::string get_output_file_name(argagg::parser_results const &options)
+{
+  if(options["output"].count() > 0) {
+    return options["output"].as<std::string>();
+  }
+
+  return options["scheme"].as<std::string>("bec") + ".csv";
+}
+
+/**
+ * The file the simulation output of a sweep configuration goes to: --stdout, or the output file
+ * with .stdout instead of .csv.
+ */
+std::string get_console_file_name(argagg::parser_results const &options)
+{
+  if(options["stdout"].count() > 0) {
+    return options["stdout"].as<std::string>();
+  }
+
+  auto path_to_stdout = get_output_file_name(options);
+  auto const extension = path_to_stdout.rfind(".csv");
+  if(extension != std::string::npos && extension + 4 == path_to_stdout.size()) {
+    path_to_stdout.erase(extension);
+  }
+
+  return path_to_stdout + ".stdout";
+}
+
+ehsim::clank::parameters clank_parameters(argagg::parser_results const &options)
+{
+  return {options["rf_entries"].as<size_t>(8), options["wf_entries"].as<size_t>(8),
+      options["wb_entries"].as<size_t>(8), options["watchdog_period"].as<int>(8000)};
+}
+
+ehsim::parametric::parameters parametric_parameters(argagg::parser_results const &options)
+{
+  return {options["tau_B"].as<int>(1000)};
+}
+
+/**
+ * The run a sweep configuration can share with others, empty if it runs on its own.
+ *
+ * Configurations share a run if they only differ in where their output goes and in the parameters
+ * of a scheme that can retarget them, see shared_run.
+ */
+std::string shared_run_key(argagg::parser_results const &options)
+{
+  auto const scheme = options["scheme"].as<std::string>("bec");
+  if(scheme != "clank" && scheme != "parametric") {
+    return "";
+  }
+
+  static std::set<std::string> const own_options{
+      "tau_B", "rf_entries", "wf_entries", "wb_entries", "watchdog_period", "output", "stdout"};
+
+  // the parsed options are unordered
+  std::map<std::string, std::vector<std::string>> shared_options;
+  for(auto const &option : options.options) {
+    if(own_options.count(option.first) > 0) {
+      continue;
     }
+    for(auto const &result : option.second.all) {
+      shared_options[option.first].push_back(result.arg != nullptr ? result.arg : "");
+    }
+  }
 
-    validate(options);
+  std::string key;
+  for(auto const &option : shared_options) {
+    for(auto const &arg : option.second) {
+      key += option.first + "=" + arg + "\n";
+    }
+  }
+  for(auto const *arg : options.pos) {
+    key += std::string(arg) + "\n";
+  }
 
-    auto const path_to_binary = options["binary"];
-    bool always_harvest = options["harvest"].as<int>(1) == 1;
+  return key;
+}
 
-    auto const path_to_voltage_trace = options["voltages"];
+/**
+ * Configurations of a sweep that run as one until their schemes can first decide differently.
+ *
+ * The run starts as the first configuration. Where its scheme could decide differently under the
+ * parameters of any of the others, the process splits and each branch retargets the scheme to its
+ * own configuration, so everything simulated up to there is shared.
+ */
+struct shared_run {
+  /**
+   * The options of every configuration.
+   */
+  std::vector<argagg::parser_results const *> configurations;
 
-    bool  use_reg_lva = options["use_reg_lva"].as<int>(1) == 1;
+  /**
+   * Continue the calling process as one of the configurations, returning its index.
+   */
+  std::function<size_t()> split;
+};
 
-    std::string path_to_reg_liveness_trace = "";
-    if(use_reg_lva)
-      path_to_reg_liveness_trace = options["reg_liveness"].as<std::string>();
+/**
+ * The inputs of one configuration, shared with the other configurations through an input_cache.
+ */
+struct configuration_inputs {
+  std::shared_ptr<thumbulator::program_image const> program;
+  std::shared_ptr<ehsim::voltage_trace const> power;
+  std::shared_ptr<ehsim::liveness_trace const> reg_liveness;
 
-    bool  use_mem_lva = options["use_mem_lva"].as<int>(1) == 1;
+  /**
+   * The register liveness computed from the binary, nullptr if a trace is used instead.
+   */
+  std::shared_ptr<ehsim::static_liveness const> static_reg_liveness;
 
-    std::string path_to_mem_liveness_trace = "";
-    if(use_mem_lva)
-      path_to_mem_liveness_trace = options["mem_liveness"].as<std::string>();
+  std::shared_ptr<ehsim::liveness_trace const> mem_liveness;
 
-    std::chrono::milliseconds sampling_period(options["rate"]);
+  /**
+   * The execution trace to replay, nullptr to emulate the binary.
+   */
+  std::shared_ptr<thumbulator::execution_trace const> recorded_execution;
+};
 
-    std::unique_ptr<ehsim::eh_scheme> scheme = nullptr;
-    auto const scheme_select = options["scheme"].as<std::string>("bec");
-    if(scheme_select == "bec") {
-      scheme = std::unique_ptr<ehsim::backup_every_cycle>(new ehsim::backup_every_cycle());
-    } else if(scheme_select == "odab") {
-      throw std::runtime_error("ODAB is no longer supported.");
-    } else if(scheme_select == "magic") {
-      throw std::runtime_error("Magic is no longer supported.");
-    } else if(scheme_select == "clank") {
-      auto rf_entries = options["rf_entries"].as<size_t>(8);
-      auto wf_entries = options["wf_entries"].as<size_t>(8);
-      auto wb_entries = options["wb_entries"].as<size_t>(8);
-      auto watchdog_period = options["watchdog_period"]. as<int>(8000);
-      scheme = std::unique_ptr<ehsim::clank>(new ehsim::clank(rf_entries,
-		                                              wf_entries,
-					                      wb_entries,
-					                      watchdog_period));
-    } else if(scheme_select == "mem_rename") {
-      auto rf_entries = options["rf_entries"].as<size_t>(8);
-      auto lbf_size = options["lbf_size"].as<size_t>(16);
-      auto icache_assoc = options["icache_assoc"].as<size_t>(1);
-      auto icache_block_size = options["icache_block_size"].as<uint32_t>(0);
-      auto icache_size = options["icache_size"].as<uint32_t>(0);
-      auto dcache_assoc = options["dcache_assoc"].as<size_t>(1);
-      auto dcache_block_size = options["dcache_block_size"].as<uint32_t>(0);
-      auto dcache_size = options["dcache_size"].as<uint32_t>(0);
-      auto use_optimal_backup_scheme = options["use_optimal_backup_scheme"].as<int>(0) == 1;
-      auto add_renamer = options["add_renamer"].as<int>(0) == 1;
-      auto reclaim_addr = options["reclaim_addr"].as<int>(0) == 1;
-      auto map_table_entries = options["map_table_entries"].as<size_t>(4);
-      auto num_avail_rename_addrs = options["num_avail_rename_addrs"].as<uint32_t>(8);
-      auto watchdog_period = options["watchdog_period"]. as<int>(8000);
-      auto icache_read_energy = options["icache_read_energy"].as<double>(4.87e-13);
-      auto icache_write_energy = options["icache_write_energy"].as<double>(5.11e-13);
-      auto icache_leakage_power = options["icache_leakage_power"].as<double>(1.21e-3);
-      auto dcache_read_energy = options["dcache_read_energy"].as<double>(4.87e-13);
-      auto dcache_write_energy = options["dcache_write_energy"].as<double>(5.11e-13);
-      auto dcache_leakage_power = options["dcache_leakage_power"].as<double>(1.21e-3);
-      auto rf_access_energy = options["rf_access_energy"].as<double>(0.19e-13);
-      auto rf_leakage_power = options["rf_leakage_power"].as<double>(0.047e-3);
-      auto lbf_access_energy = options["lbf_access_energy"].as<double>(0);
-      auto lbf_leakage_power = options["lbf_leakage_power"].as<double>(0);
-      auto map_table_access_energy = options["map_table_access_energy"].as<double>(0);
-      auto map_table_read_energy = options["map_table_read_energy"].as<double>(0);
-      auto map_table_write_energy = options["map_table_write_energy"].as<double>(0);
-      auto map_table_leakage_power = options["map_table_leakage_power"].as<double>(0);
-      auto free_list_read_energy = options["free_list_read_energy"].as<double>(0);
-      auto free_list_leakage_power = options["free_list_leakage_power"].as<double>(0);
-
-      scheme = std::unique_ptr<ehsim::mem_rename>(new ehsim::mem_rename(rf_entries,
-                                                                        lbf_size,
-                                                                        watchdog_period,
-                                                                        icache_assoc,
-                                                                        icache_block_size,
-                                                                        icache_size,
-                                                                        dcache_assoc,
-                                                                        dcache_block_size,
-                                                                        dcache_size,
+configuration_inputs load_inputs(argagg::parser_results const &options, ehsim::input_cache &inputs)
+{
+  configuration_inputs loaded;
+
+  auto const path_to_binary = options["binary"].as<std::string>();
+  loaded.program = inputs.binary(path_to_binary);
+
+  std::chrono::milliseconds sampling_period(options["rate"]);
+  loaded.power = inputs.voltages(options["voltages"].as<std::string>(), sampling_period);
+
+  auto const use_reg_lva = options["use_reg_lva"].as<int>(1) == 1;
+  auto const path_to_reg_liveness_trace =
+      use_reg_lva ? options["reg_liveness"].as<std::string>("") : std::string();
+  auto const use_static_reg_lva = use_reg_lva && path_to_reg_liveness_trace.empty();
+  loaded.reg_liveness =
+      inputs.liveness(use_reg_lva && !use_static_reg_lva, path_to_reg_liveness_trace);
+  if(use_static_reg_lva) {
+    loaded.static_reg_liveness = inputs.static_register_liveness(path_to_binary);
+  }
+
+  auto const use_mem_lva = options["use_mem_lva"].as<int>(1) == 1;
+  loaded.mem_liveness = inputs.liveness(
+      use_mem_lva, use_mem_lva ? options["mem_liveness"].as<std::string>() : std::string());
+
+  if(options["replay_trace"].count() > 0) {
+    loaded.recorded_execution = inputs.execution_trace(options["replay_trace"].as<std::string>());
+  }
+
+  return loaded;
+}
+
+/**
+ * The input_cache key of the spendthrift model of a configuration, without the decision table.
+ */
+std::string spendthrift_key(argagg::parser_results const &options)
+{
+  return options["spendthrift_backend"].as<std::string>("torch") + "|" +
+         options["spendthrift_model"].as<std::string>("traced_spendthrift_model_updated.pt") + "|" +
+         options["spendthrift_weights"].as<std::string>("");
+}
+
+/**
+ * Load the inputs of a configuration before the sweep forks.
+ *
+ * The children inherit the loaded inputs copy-on-write, so each is read once for the whole sweep.
+ * Decision tables depend on the scheme and comparisons keep per-configuration counters, so those
+ * spendthrift models are still loaded by the children.
+ */
+void preload_inputs(argagg::parser_results const &options, ehsim::input_cache &inputs)
+{
+  load_inputs(options, inputs);
+
+  auto const spendthrift_backend = ehsim::parse_inference_backend(
+      options["spendthrift_backend"].as<std::string>("torch"));
+  if(spendthrift_backend == ehsim::inference_backend::table
+      || spendthrift_backend == ehsim::inference_backend::compare) {
+    return;
+  }
+
+  inputs.spendthrift(spendthrift_key(options), [&]() {
+    return std::unique_ptr<ehsim::spendthrift_model>(new ehsim::spendthrift_model(
+        spendthrift_backend,
+        options["spendthrift_model"].as<std::string>("traced_spendthrift_model_updated.pt"),
+        options["spendthrift_weights"].as<std::string>("")));
+  });
+}
+
+/**
+ * The cache energies of mem_rename, from the options or their defaults.
+ */
+ehsim::cache_energy_model cache_energy_options(argagg::parser_results const &options)
+{
+  ehsim::cache_energy_model energy;
+  energy.icache_read_energy = options["icache_read_energy"].as<double>(4.87e-13);
+  energy.icache_write_energy = options["icache_write_energy"].as<double>(5.11e-13);
+  energy.dcache_read_energy = options["dcache_read_energy"].as<double>(4.87e-13);
+  energy.dcache_write_energy = options["dcache_write_energy"].as<double>(5.11e-13);
+  energy.lbf_access_energy = options["lbf_access_energy"].as<double>(0);
+
+  return energy;
+}
+
+/**
+ * Run one configuration.
+ *
+ * @param options The parsed command-line options of the configuration.
+ * @param inputs Binaries, traces, and models shared with other configurations.
+ * @param console Where the simulation output and the summary go.
+ * @param measured If not nullptr, receives the startup and simulation time of the configuration.
+ * @param shared The configurations sharing the run, options being the first, or nullptr.
+ */
+void run_configuration(argagg::parser_results const &options,
+    ehsim::input_cache &inputs,
+    std::ostream &console,
+    thumbulator::benchmark::measurement *measured = nullptr,
+    shared_run *shared = nullptr)
+{
+  auto const start_time = std::chrono::steady_clock::now();
+
+  auto const spendthrift_backend = ehsim::parse_inference_backend(
+      options["spendthrift_backend"].as<std::string>("torch"));
+  auto const path_to_spendthrift_model =
+      options["spendthrift_model"].as<std::string>("traced_spendthrift_model_updated.pt");
+  auto const path_to_spendthrift_weights = options["spendthrift_weights"].as<std::string>("");
+
+  validate(options);
+
+  bool always_harvest = options["harvest"].as<int>(1) == 1;
+
+  auto const path_to_voltage_trace = options["voltages"].as<std::string>();
+
+  bool  use_reg_lva = options["use_reg_lva"].as<int>(1) == 1;
+
+  bool  use_mem_lva = options["use_mem_lva"].as<int>(1) == 1;
+
+  std::chrono::milliseconds sampling_period(options["rate"]);
+
+  // the scheme installs its hooks into the active simulation, so it has to exist first
+  ehsim::simulation context;
+  context.out = &console;
+  ehsim::simulation_scope active_context(context);
+
+  std::unique_ptr<ehsim::eh_scheme> scheme = nullptr;
+  auto const scheme_select = options["scheme"].as<std::string>("bec");
+  if(scheme_select == "bec") {
+    scheme = std::unique_ptr<ehsim::backup_every_cycle>(new ehsim::backup_every_cycle());
+  } else if(scheme_select == "odab") {
+    throw std::runtime_error("ODAB is no longer supported.");
+  } else if(scheme_select == "magic") {
+    throw std::runtime_error("Magic is no longer supported.");
+  } else if(scheme_select == "clank") {
+    auto const parameters = clank_parameters(options);
+    scheme = std::unique_ptr<ehsim::clank>(new ehsim::clank(parameters.rf_entries,
+		                                              parameters.wf_entries,
+					                      parameters.wb_entries,
+					                      parameters.watchdog_period));
+  } else if(scheme_select == "mem_rename") {
+    auto rf_entries = options["rf_entries"].as<size_t>(8);
+    auto lbf_size = options["lbf_size"].as<size_t>(16);
+    auto icache_assoc = options["icache_assoc"].as<size_t>(1);
+    auto icache_block_size = options["icache_block_size"].as<uint32_t>(0);
+    auto icache_size = options["icache_size"].as<uint32_t>(0);
+    auto dcache_assoc = options["dcache_assoc"].as<size_t>(1);
+    auto dcache_block_size = options["dcache_block_size"].as<uint32_t>(0);
+    auto dcache_size = options["dcache_size"].as<uint32_t>(0);
+    auto icache_policy = thumbulator::parse_replacement_policy(
+        options["icache_policy"].as<std::string>("counter"));
+    auto dcache_policy = thumbulator::parse_replacement_policy(
+        options["dcache_policy"].as<std::string>("counter"));
+    auto use_optimal_backup_scheme = options["use_optimal_backup_scheme"].as<int>(0) == 1;
+    auto add_renamer = options["add_renamer"].as<int>(0) == 1;
+    auto reclaim_addr = options["reclaim_addr"].as<int>(0) == 1;
+    auto map_table_entries = options["map_table_entries"].as<size_t>(4);
+    auto num_avail_rename_addrs = options["num_avail_rename_addrs"].as<uint32_t>(8);
+    auto watchdog_period = options["watchdog_period"]. as<int>(8000);
+    auto const cache_energy = cache_energy_options(options);
+    auto icache_read_energy = cache_energy.icache_read_energy;
+    auto icache_write_energy = cache_energy.icache_write_energy;
+    auto icache_leakage_power = options["icache_leakage_power"].as<double>(1.21e-3);
+    auto dcache_read_energy = cache_energy.dcache_read_energy;
+    auto dcache_write_energy = cache_energy.dcache_write_energy;
+    auto dcache_leakage_power = options["dcache_leakage_power"].as<double>(1.21e-3);
+    auto rf_access_energy = options["rf_access_energy"].as<double>(0.19e-13);
+    auto rf_leakage_power = options["rf_leakage_power"].as<double>(0.047e-3);
+    auto lbf_access_energy = cache_energy.lbf_access_energy;
+    auto lbf_leakage_power = options["lbf_leakage_power"].as<double>(0);
+    auto map_table_access_energy = options["map_table_access_energy"].as<double>(0);
+    auto map_table_read_energy = options["map_table_read_energy"].as<double>(0);
+    auto map_table_write_energy = options["map_table_write_energy"].as<double>(0);
+    auto map_table_leakage_power = options["map_table_leakage_power"].as<double>(0);
+    auto free_list_read_energy = options["free_list_read_energy"].as<double>(0);
+    auto free_list_leakage_power = options["free_list_leakage_power"].as<double>(0);
+
+    scheme = std::unique_ptr<ehsim::mem_rename>(new ehsim::mem_rename(rf_entries,
+                                                                      lbf_size,
+                                                                      watchdog_period,
+                                                                      icache_assoc,
+                                                                      icache_block_size,
+                                                                      icache_size,
+                                                                      dcache_assoc,
+                                                                      dcache_block_size,
+                                                                      dcache_size,
 						                        use_optimal_backup_scheme,
-                                                                        add_renamer,
+                                                                      add_renamer,
 						                        reclaim_addr,
-                                                                        map_table_entries,
-                                                                        num_avail_rename_addrs,
-                                                                        icache_read_energy,
-                                                                        icache_write_energy,
-                                                                        icache_leakage_power,
-                                                                        dcache_read_energy,
-                                                                        dcache_write_energy,
-                                                                        dcache_leakage_power,
-                                                                        rf_access_energy,
-                                                                        rf_leakage_power,
-                                                                        lbf_access_energy,
-                                                                        lbf_leakage_power,
+                                                                      map_table_entries,
+                                                                      num_avail_rename_addrs,
+                                                                      icache_read_energy,
+                                                                      icache_write_energy,
+                                                                      icache_leakage_power,
+                                                                      dcache_read_energy,
+                                                                      dcache_write_energy,
+                                                                      dcache_leakage_power,
+                                                                      rf_access_energy,
+                                                                      rf_leakage_power,
+                                                                      lbf_access_energy,
+                                                                      lbf_leakage_power,
 						                        map_table_access_energy,
 						                        map_table_read_energy,
 						                        map_table_write_energy,
 						                        map_table_leakage_power,
 						                        free_list_read_energy,
-						                        free_list_leakage_power));
+						                        free_list_leakage_power,
+                                                                      icache_policy,
+                                                                      dcache_policy));
+  } else if(scheme_select == "parametric") {
+    auto const parameters = parametric_parameters(options);
+    scheme = std::unique_ptr<ehsim::parametric>(new ehsim::parametric(parameters.backup_period));
+  } else {
+    throw std::runtime_error("Unknown scheme selected.");
+  }
+
+  auto const loaded = load_inputs(options, inputs);
+  auto const &program = loaded.program;
+  auto const &power = loaded.power;
+  auto const &reg_liveness = loaded.reg_liveness;
+  auto const &static_reg_liveness = loaded.static_reg_liveness;
+  auto const &mem_liveness = loaded.mem_liveness;
+  if(static_reg_liveness != nullptr) {
+    console << "Static register liveness: " << static_reg_liveness->num_instructions()
+            << " instructions analyzed\n";
+  }
+
+  auto const load_spendthrift = [&]() {
+    std::unique_ptr<ehsim::spendthrift_model> model(new ehsim::spendthrift_model(
+        spendthrift_backend, path_to_spendthrift_model, path_to_spendthrift_weights));
+    if(spendthrift_backend == ehsim::inference_backend::table) {
+      auto const table_voltages = options["table_voltages"].as<size_t>(256);
+      auto const table_energies = options["table_energies"].as<size_t>(1024);
+      model->build_table(power->minimum_voltage(), power->maximum_voltage(),
+          scheme->get_battery().maximum_energy_stored(), table_voltages, table_energies);
+    }
+    return model;
+  };
+
+  std::shared_ptr<ehsim::spendthrift_model> spendthrift = nullptr;
+  if(spendthrift_backend == ehsim::inference_backend::compare) {
+    // the comparison counters belong to this configuration alone
+    spendthrift = load_spendthrift();
+  } else {
+    auto key = spendthrift_key(options);
+    if(spendthrift_backend == ehsim::inference_backend::table) {
+      key += "|" + path_to_voltage_trace + "|" + std::to_string(sampling_period.count()) + "|" +
+             std::to_string(scheme->get_battery().maximum_energy_stored()) + "|" +
+             options["table_voltages"].as<std::string>("256") + "|" +
+             options["table_energies"].as<std::string>("1024");
+    }
+    spendthrift = inputs.spendthrift(key, load_spendthrift);
+  }
+  if(spendthrift_backend == ehsim::inference_backend::table) {
+    spendthrift->print_table_error(console);
+  }
+
+  std::unique_ptr<thumbulator::trace_reader> replay = nullptr;
+  if(loaded.recorded_execution != nullptr) {
+    replay.reset(new thumbulator::trace_reader(*loaded.recorded_execution));
+    console << "Replaying " << loaded.recorded_execution->num_records()
+            << " recorded instructions\n";
+  }
+
+  std::unique_ptr<ehsim::profiler> profile = nullptr;
+  if(options["profile"].count() > 0) {
+    profile.reset(new ehsim::profiler(*program));
+    context.profile = profile.get();
+  }
+
+  std::unique_ptr<thumbulator::stack_distance_profiler> icache_profile = nullptr;
+  std::unique_ptr<thumbulator::stack_distance_profiler> dcache_profile = nullptr;
+  if(options["cache_profile"].count() > 0) {
+    auto const max_size = options["cache_profile_max_size"].as<uint32_t>(8192);
+    auto const max_assoc = options["cache_profile_max_assoc"].as<size_t>(0);
+    // without caches to simulate, profile 16 byte lines
+    auto const icache_block_size = options["icache_block_size"].as<uint32_t>(0);
+    auto const dcache_block_size = options["dcache_block_size"].as<uint32_t>(0);
+    icache_profile.reset(new thumbulator::stack_distance_profiler(
+        icache_block_size > 0 ? icache_block_size : 16, max_size, max_assoc));
+    dcache_profile.reset(new thumbulator::stack_distance_profiler(
+        dcache_block_size > 0 ? dcache_block_size : 16, max_size, max_assoc));
+    context.machine.icache_profiler = icache_profile.get();
+    context.machine.dcache_profiler = dcache_profile.get();
+  }
+
+  // a shared run continues as one of its configurations where their schemes can first diverge
+  auto const *run_options = &options;
+  std::function<bool()> diverges;
+  std::function<void(argagg::parser_results const &)> retarget;
+  if(shared != nullptr) {
+    auto const share = [&](auto *selected_scheme, auto parameters_of) {
+      std::vector<decltype(parameters_of(options))> others;
+      for(auto const *configuration : shared->configurations) {
+        others.push_back(parameters_of(*configuration));
+      }
+
+      diverges = [selected_scheme, others]() {
+        for(auto const &other : others) {
+          if(selected_scheme->diverges(other)) {
+            return true;
+          }
+        }
+        return false;
+      };
+      retarget = [selected_scheme, parameters_of](argagg::parser_results const &configuration) {
+        selected_scheme->retarget(parameters_of(configuration));
+      };
+    };
+
+    if(scheme_select == "clank") {
+      share(static_cast<ehsim::clank *>(scheme.get()), clank_parameters);
     } else if(scheme_select == "parametric") {
-      auto const tau_b = options["tau_B"].as<int>(1000);
-      scheme = std::unique_ptr<ehsim::parametric>(new ehsim::parametric(tau_b));
+      share(static_cast<ehsim::parametric *>(scheme.get()), parametric_parameters);
     } else {
-      throw std::runtime_error("Unknown scheme selected.");
+      throw std::runtime_error("Only clank and parametric runs can be shared.");
     }
 
-    ehsim::voltage_trace power(path_to_voltage_trace, sampling_period);
+    context.split = [&](bool at_end) {
+      if(!at_end && !diverges()) {
+        return false;
+      }
 
-    ehsim::liveness_trace reg_liveness(use_reg_lva, path_to_reg_liveness_trace);
+      run_options = shared->configurations[shared->split()];
+      retarget(*run_options);
+      return true;
+    };
+  }
 
-    ehsim::liveness_trace mem_liveness(use_mem_lva, path_to_mem_liveness_trace);
+  // run the simulation loop instantiated for the selected scheme
+  auto const run = [&](auto *selected_scheme) {
+    return ehsim::simulate(*program, *power, use_reg_lva, *reg_liveness, static_reg_liveness.get(),
+        use_mem_lva, *mem_liveness, selected_scheme, *spendthrift, always_harvest, replay.get());
+  };
 
-    auto const stats = ehsim::simulate(path_to_binary, power, use_reg_lva, reg_liveness, use_mem_lva, mem_liveness, scheme.get(), always_harvest);
+#ifdef THUMBULATOR_INSTRUMENT
+  thumbulator::instrumentation::session host_time;
+#endif
 
-    std::cout << "CPU instructions executed: " << std::dec << stats.cpu.instruction_count << "\n";
-    std::cout << "CPU instructions executed towards forward progress: " << std::dec << stats.cpu.instruction_count_forward_progress << "\n";
-    if(scheme_select == "mem_rename") {
-      std::cout << "Number of true positives: " << std::dec << stats.system.true_positives << "\n";
-      std::cout << "Number of false positives: " << std::dec << stats.system.false_positives << "\n";
-      std::cout << "Number of times renamed: " << std::dec << stats.system.num_renamed_mappings << "\n";
-      std::cout << "Number of times reclaimed: " << std::dec << stats.system.num_reclaimed_mappings << "\n";
+  auto const run_time = std::chrono::steady_clock::now();
+  auto const stats = [&]() {
+    if(scheme_select == "bec") {
+      return run(static_cast<ehsim::backup_every_cycle *>(scheme.get()));
+    } else if(scheme_select == "clank") {
+      return run(static_cast<ehsim::clank *>(scheme.get()));
+    } else if(scheme_select == "mem_rename") {
+      return run(static_cast<ehsim::mem_rename *>(scheme.get()));
+    } else if(scheme_select == "parametric") {
+      return run(static_cast<ehsim::parametric *>(scheme.get()));
     }
-    std::cout << "CPU time (cycles): " << std::dec << stats.cpu.cycle_count << "\n";
-    std::cout << "Total time (ns): " << std::dec << stats.system.time.count() << "\n";
-    std::cout << "Energy harvested (J): " << std::dec << stats.system.energy_harvested * 1e-9 << "\n";
-    std::cout << "Energy remaining (J): " << std::dec << stats.system.energy_remaining * 1e-9 << "\n";
 
-    std::string output_file_name(scheme_select + ".csv");
+    return run(scheme.get());
+  }();
+
+#ifdef THUMBULATOR_INSTRUMENT
+  host_time.stop();
+#endif
+
+  if(measured != nullptr) {
+    using milliseconds = std::chrono::duration<double, std::milli>;
+    measured->startup_ms = milliseconds(run_time - start_time).count();
+    measured->run_ms = milliseconds(std::chrono::steady_clock::now() - run_time).count();
+    measured->instructions = stats.cpu.instruction_count;
+  }
+
+  console << "CPU instructions executed: " << std::dec << stats.cpu.instruction_count << "\n";
+  console << "CPU instructions executed towards forward progress: " << std::dec << stats.cpu.instruction_count_forward_progress << "\n";
+  if(scheme_select == "mem_rename") {
+    console << "Number of true positives: " << std::dec << stats.system.true_positives << "\n";
+    console << "Number of false positives: " << std::dec << stats.system.false_positives << "\n";
+    console << "Number of times renamed: " << std::dec << stats.system.num_renamed_mappings << "\n";
+    console << "Number of times reclaimed: " << std::dec << stats.system.num_reclaimed_mappings << "\n";
+  }
+  console << "CPU time (cycles): " << std::dec << stats.cpu.cycle_count << "\n";
+  console << "Total time (ns): " << std::dec << stats.system.time.count() << "\n";
+  console << "Energy harvested (J): " << std::dec << stats.system.energy_harvested * 1e-9 << "\n";
+  console << "Energy remaining (J): " << std::dec << stats.system.energy_remaining * 1e-9 << "\n";
+  if(spendthrift_backend == ehsim::inference_backend::compare) {
+    spendthrift->print_comparison(console);
+  }
+
+#ifdef THUMBULATOR_INSTRUMENT
+  host_time.report(console, stats.cpu.instruction_count);
+  if((*run_options)["instrumentation_json"].count() > 0) {
+    std::ofstream json((*run_options)["instrumentation_json"].as<std::string>());
+    host_time.write_json(json, stats.cpu.instruction_count);
+  }
+#endif
+
+  if(profile != nullptr) {
+    auto const prefix = (*run_options)["profile"].as<std::string>();
+    std::ofstream cycles(prefix + ".cycles.folded");
+    profile->write_folded_cycles(cycles);
+    std::ofstream energy(prefix + ".energy.folded");
+    profile->write_folded_energy(energy);
+    std::ofstream flat(prefix + ".profile.txt");
+    profile->write_flat_profile(flat);
+    console << "Profile written to " << prefix << ".profile.txt\n";
+  }
+
+  if(icache_profile != nullptr) {
+    auto const prefix = (*run_options)["cache_profile"].as<std::string>();
+    auto const cache_energy = cache_energy_options(*run_options);
+    std::ofstream icache_curves(prefix + ".icache.csv");
+    ehsim::write_icache_profile(icache_curves, *icache_profile, cache_energy);
+    std::ofstream dcache_curves(prefix + ".dcache.csv");
+    ehsim::write_dcache_profile(dcache_curves, *dcache_profile, cache_energy);
+    console << "Cache profile written to " << prefix << ".icache.csv and " << prefix
+            << ".dcache.csv\n";
+  }
+
+  std::ofstream out(get_output_file_name(*run_options));
+  out.setf(std::ios::fixed);
+  out << "id, E, epsilon, epsilon_C, tau_B, alpha_B, energy_consumed, n_B, tau_P, tau_D, e_P, e_B, "
+         "e_R, sim_p, eh_p, n_iB\n";
+
+  int id = 0;
+  for(auto const &model : stats.models) {
+    out << id++ << ", ";
+
+    auto const eh_parameters = ehsim::eh_model_parameters(model);
+    out << std::setprecision(3) << eh_parameters.E << ", ";
+    out << std::setprecision(3) << eh_parameters.epsilon << ", ";
+    out << std::setprecision(3) << eh_parameters.epsilon_C << ", ";
+    out << std::setprecision(2) << eh_parameters.tau_B << ", ";
+    out << std::setprecision(4) << eh_parameters.alpha_B << ", ";
+
+    auto const tau_D = model.time_for_instructions - model.time_forward_progress;
+    out << std::setprecision(3) << model.energy_consumed << ", ";
+    out << std::setprecision(0) << model.num_backups << ", ";
+    out << std::setprecision(0) << model.time_forward_progress << ", ";
+    out << std::setprecision(0) << tau_D << ", ";
+    out << std::setprecision(3) << model.energy_forward_progress << ", ";
+    out << std::setprecision(3) << model.energy_for_backups << ", ";
+    out << std::setprecision(3) << model.energy_for_restore << ", ";
+    out << std::setprecision(3) << model.progress << ", ";
+    out << std::setprecision(3) << model.eh_progress << ", ";
+    out << std::setprecision(0) << model.num_id_backups << "\n";
+  }
+}
+
+/**
+ * Run every configuration of a manifest, on threads of this process or in forked processes.
+ *
+ * Forked configurations also share their run while they can, see shared_run.
+ */
+int sweep(int argc, char *argv[])
+{
+  argagg::parser arguments{{{"help", {"-h", "--help"}, "display help information", 0},
+      {"manifest", {"-m", "--manifest"}, "file with the options of one configuration per line", 1},
+      {"threads", {"-j", "--threads"}, "number of threads, 0 for one per hardware thread", 1},
+      {"fork", {"--fork"}, "run the configurations in processes forked after loading the shared inputs, and after the shared start of their runs", 0}}};
+
+  try {
+    auto const options = arguments.parse(argc, argv);
+    if(options["help"]) {
+      print_usage(std::cout, arguments);
+      return EXIT_SUCCESS;
+    }
+
+    if(options["manifest"].count() == 0) {
+      throw std::runtime_error("Missing path to sweep manifest.");
+    }
+
+    auto const configurations = ehsim::read_manifest(options["manifest"].as<std::string>());
+    auto const num_threads = options["threads"].as<size_t>(0);
+
+    // parse everything up front, a mistake in any line stops the sweep before it starts
+    auto const parser = make_parser();
+    std::vector<argagg::parser_results> configuration_options;
+    for(auto const &words : configurations) {
+      std::vector<char const *> configuration_argv{"eh-sim"};
+      for(auto const &word : words) {
+        configuration_argv.push_back(word.c_str());
+      }
+      configuration_options.push_back(
+          parser.parse(static_cast<int>(configuration_argv.size()), configuration_argv.data()));
+      validate(configuration_options.back());
+    }
+
+    ehsim::input_cache inputs;
+    std::mutex console_mutex;
+    size_t num_failed = 0;
+
+    auto const report_error = [&](size_t i, std::ostream &console, std::string const &error) {
+      console << "Error: " << error << "\n";
+
+      std::lock_guard<std::mutex> lock(console_mutex);
+      std::cerr << "Error in configuration " << i + 1 << ": " << error << "\n";
+    };
+
+    auto const run_one = [&](size_t i) {
+      auto const &configuration = configuration_options[i];
+
+      std::ofstream console(get_console_file_name(configuration));
+      try {
+        run_configuration(configuration, inputs, console);
+      } catch(std::exception const &e) {
+        report_error(i, console, e.what());
+        return false;
+      }
+
+      return true;
+    };
+
+    if(options["fork"]) {
+      ehsim::process_pool processes(configuration_options.size(), num_threads);
+
+      // the shared fork point: every input is loaded once and inherited by the configurations
+      std::vector<std::vector<size_t>> shared_runs;
+      std::map<std::string, size_t> shared_run_index;
+      for(size_t i = 0; i < configuration_options.size(); i++) {
+        try {
+          preload_inputs(configuration_options[i], inputs);
+        } catch(std::exception const &e) {
+          // never reported as finished, so the configuration counts as failed
+          std::ofstream console(get_console_file_name(configuration_options[i]));
+          report_error(i, console, e.what());
+          continue;
+        }
+
+        auto const key = shared_run_key(configuration_options[i]);
+        auto const found = key.empty() ? shared_run_index.end() : shared_run_index.find(key);
+        if(found != shared_run_index.end()) {
+          shared_runs[found->second].push_back(i);
+        } else {
+          if(!key.empty()) {
+            shared_run_index[key] = shared_runs.size();
+          }
+          shared_runs.push_back({i});
+        }
+      }
+
+      auto const run_shared = [&](std::vector<size_t> const &members) {
+        if(members.size() == 1) {
+          processes.finish(members.front(), run_one(members.front()));
+          return;
+        }
+
+        // the output up to the split goes to the console of every configuration
+        std::stringstream shared_console;
+        std::ofstream own_console;
+        std::ostream console(shared_console.rdbuf());
+
+        shared_run run;
+        for(auto const i : members) {
+          run.configurations.push_back(&configuration_options[i]);
+        }
+
+        size_t member = 0;
+        auto split = false;
+        run.split = [&]() {
+          member = processes.branch(members.size());
+          split = true;
+
+          own_console.open(get_console_file_name(configuration_options[members[member]]));
+          own_console << shared_console.str();
+          console.rdbuf(own_console.rdbuf());
+          return member;
+        };
+
+        try {
+          run_configuration(configuration_options[members.front()], inputs, console, nullptr, &run);
+        } catch(std::exception const &e) {
+          if(split) {
+            report_error(members[member], console, e.what());
+            return;
+          }
+
+          // the shared part failed every configuration
+          for(auto const i : members) {
+            std::ofstream failed_console(get_console_file_name(configuration_options[i]));
+            failed_console << shared_console.str();
+            report_error(i, failed_console, e.what());
+          }
+          return;
+        }
+
+        processes.finish(members[member], true);
+      };
+
+      std::vector<std::function<void()>> tasks;
+      for(auto const &members : shared_runs) {
+        tasks.emplace_back([&, members]() { run_shared(members); });
+      }
+
+      processes.run(tasks);
+      num_failed = processes.num_failed();
+    } else {
+      std::vector<std::function<void()>> jobs;
+      for(size_t i = 0; i < configuration_options.size(); i++) {
+        jobs.emplace_back([&, i]() {
+          if(!run_one(i)) {
+            std::lock_guard<std::mutex> lock(console_mutex);
+            num_failed++;
+          }
+        });
+      }
+
+      ehsim::run_jobs(jobs, num_threads);
+    }
+
+    std::cout << "Configurations run: " << std::dec << configuration_options.size() << "\n";
+    std::cout << "Configurations failed: " << std::dec << num_failed << "\n";
+
+    return num_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch(std::exception const &e) {
+    std::cerr << "Error: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+}
+
+/**
+ * The name of a configuration in benchmark reports: benchmark/scheme/voltage trace.
+ *
+ * The benchmark is the directory of a MiBench-style BENCHMARK/main.bin, the file name otherwise.
+ */
+std::string benchmark_name(argagg::parser_results const &options)
+{
+  auto const file_name = [](std::string const &path) {
+    auto const slash = path.rfind('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+  };
+
+  auto const path_to_binary = options["binary"].as<std::string>();
+  auto binary = file_name(path_to_binary);
+  auto const slash = path_to_binary.rfind('/');
+  if(binary == "main.bin" && slash != std::string::npos && slash > 0) {
+    binary = file_name(path_to_binary.substr(0, slash));
+  }
+
+  auto voltages = file_name(options["voltages"].as<std::string>());
+  auto const extension = voltages.rfind('.');
+  if(extension != std::string::npos && extension > 0) {
+    voltages.erase(extension);
+  }
+
+  return binary + "/" + options["scheme"].as<std::string>("bec") + "/" + voltages;
+}
+
+/**
+ * Measure the host cost of every configuration of a manifest and check it against a baseline.
+ *
+ * Each configuration runs alone in a forked process, loading its own inputs, so its startup time and
+ * peak RSS are its own. The simulation output is discarded, the CSV is still written.
+ */
+int bench(int argc, char *argv[])
+{
+  argagg::parser arguments{{{"help", {"-h", "--help"}, "display help information", 0},
+      {"manifest", {"-m", "--manifest"}, "file with the options of one configuration per line", 1},
+      {"baseline", {"--baseline"}, "JSON results to compare against", 1},
+      {"threshold", {"--threshold"}, "allowed regression against the baseline in percent (default 10)", 1},
+      {"output", {"-o", "--output"}, "write the results as JSON, e.g. a new baseline", 1},
+      {"repeat", {"--repeat"}, "run every configuration N times and keep the best (default 1)", 1}}};
+
+  try {
+    auto const options = arguments.parse(argc, argv);
+    if(options["help"]) {
+      print_usage(std::cout, arguments);
+      return EXIT_SUCCESS;
+    }
+
+    if(options["manifest"].count() == 0) {
+      throw std::runtime_error("Missing path to benchmark manifest.");
+    }
+
+    auto const configurations = ehsim::read_manifest(options["manifest"].as<std::string>());
+    auto const threshold = options["threshold"].as<double>(10.0);
+    auto const repetitions = options["repeat"].as<unsigned>(1);
+
+    // a missing baseline fails before the benchmarks run
+    std::vector<thumbulator::benchmark::measurement> baseline;
+    if(options["baseline"].count() > 0) {
+      baseline = thumbulator::benchmark::read_json(options["baseline"].as<std::string>());
+    }
+
+    auto const parser = make_parser();
+    std::vector<argagg::parser_results> configuration_options;
+    for(auto const &words : configurations) {
+      std::vector<char const *> configuration_argv{"eh-sim"};
+      for(auto const &word : words) {
+        configuration_argv.push_back(word.c_str());
+      }
+      configuration_options.push_back(
+          parser.parse(static_cast<int>(configuration_argv.size()), configuration_argv.data()));
+      validate(configuration_options.back());
+    }
+
+    std::vector<thumbulator::benchmark::measurement> results;
+    for(auto const &configuration : configuration_options) {
+      auto const name = benchmark_name(configuration);
+      std::cout << "Running " << name << "\n";
+
+      results.push_back(thumbulator::benchmark::run_isolated(name,
+          [&](thumbulator::benchmark::measurement &measured) {
+            ehsim::input_cache inputs;
+            std::ostream discarded(nullptr);
+            run_configuration(configuration, inputs, discarded, &measured);
+          },
+          repetitions));
+    }
+
+    thumbulator::benchmark::print_table(std::cout, results);
+
     if(options["output"].count() > 0) {
-      output_file_name = options["output"].as<std::string>();
+      std::ofstream output(options["output"].as<std::string>());
+      thumbulator::benchmark::write_json(output, results);
+    }
+
+    if(options["baseline"].count() > 0) {
+      auto const regressed =
+          thumbulator::benchmark::compare(results, baseline, threshold, std::cout);
+      if(regressed > 0) {
+        std::cout << regressed << " configurations regressed by more than " << threshold
+                  << "% or did not run\n";
+        return EXIT_FAILURE;
+      }
+    } else {
+      std::cerr << "Warning: no --baseline, the results are not checked for regressions\n";
+    }
+  } catch(std::exception const &e) {
+    std::cerr << "Error: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+  if(argc > 1 && std::string(argv[1]) == "sweep") {
+    return sweep(argc - 1, argv + 1);
+  }
+  if(argc > 1 && std::string(argv[1]) == "bench") {
+    return bench(argc - 1, argv + 1);
+  }
+
+  auto const arguments = make_parser();
+
+  try {
+    auto const options = arguments.parse(argc, argv);
+    if(options["help"]) {
+      print_usage(std::cout, arguments);
+      return EXIT_SUCCESS;
     }
 
-    std::ofstream out(output_file_name);
-    out.setf(std::ios::fixed);
-    out << "id, E, epsilon, epsilon_C, tau_B, alpha_B, energy_consumed, n_B, tau_P, tau_D, e_P, e_B, "
-           "e_R, sim_p, eh_p, n_iB\n";
-
-    int id = 0;
-    for(auto const &model : stats.models) {
-      out << id++ << ", ";
-
-      auto const eh_parameters = ehsim::eh_model_parameters(model);
-      out << std::setprecision(3) << eh_parameters.E << ", ";
-      out << std::setprecision(3) << eh_parameters.epsilon << ", ";
-      out << std::setprecision(3) << eh_parameters.epsilon_C << ", ";
-      out << std::setprecision(2) << eh_parameters.tau_B << ", ";
-      out << std::setprecision(4) << eh_parameters.alpha_B << ", ";
-
-      auto const tau_D = model.time_for_instructions - model.time_forward_progress;
-      out << std::setprecision(3) << model.energy_consumed << ", ";
-      out << std::setprecision(0) << model.num_backups << ", ";
-      out << std::setprecision(0) << model.time_forward_progress << ", ";
-      out << std::setprecision(0) << tau_D << ", ";
-      out << std::setprecision(3) << model.energy_forward_progress << ", ";
-      out << std::setprecision(3) << model.energy_for_backups << ", ";
-      out << std::setprecision(3) << model.energy_for_restore << ", ";
-      out << std::setprecision(3) << model.progress << ", ";
-      out << std::setprecision(3) << model.eh_progress << ", ";
-      out << std::setprecision(0) << model.num_id_backups << "\n";
+    if(options["export_weights"].count() > 0) {
+      auto const path_to_spendthrift_model =
+          options["spendthrift_model"].as<std::string>("traced_spendthrift_model_updated.pt");
+      ehsim::spendthrift_model model(ehsim::inference_backend::torch, path_to_spendthrift_model, "");
+      model.export_weights(options["export_weights"].as<std::string>());
+      return EXIT_SUCCESS;
+    }
+
+    ehsim::input_cache inputs;
+    if(options["stdout"].count() > 0) {
+      std::ofstream console(options["stdout"].as<std::string>());
+      run_configuration(options, inputs, console);
+    } else {
+      run_configuration(options, inputs, std::cout);
     }
   } catch(std::exception const &e) {
     std::cerr << "Error: " << e.what() << "\n";
@@ -0,0 +1,339 @@
+#include "profiler.hpp"
+
+#include <thumbulator/program.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <ostream>
+
+namespace ehsim {
+
+namespace {
+
+uint16_t halfword(std::vector<uint32_t> const &flash, uint32_t address)
+{
+  auto const index = address >> 2;
+  if(index >= flash.size()) {
+    return 0;
+  }
+
+  return (address & 0x2) != 0 ? flash[index] >> 16 : flash[index] & 0xFFFF;
+}
+
+/**
+ * The totals of a function in the flat profile.
+ */
+struct function_totals {
+  uint32_t function = 0;
+  uint64_t instructions = 0;
+  uint64_t cycles = 0;
+  double energy = 0;
+  uint64_t icache_misses = 0;
+  uint64_t dcache_misses = 0;
+  uint64_t requested_backups = 0;
+  uint64_t backups = 0;
+  uint64_t re_executed = 0;
+};
+
+double percent(double part, double total)
+{
+  return total > 0 ? 100.0 * part / total : 0.0;
+}
+}
+
+profiler::profiler(thumbulator::program_image const &program)
+    : flash(program.flash)
+    , symbols(program.symbols)
+    , flash_sites(program.flash.size() * 2)
+    , nodes{{0, 0, 0, 0.0}}
+{
+}
+
+profiler::site &profiler::get_site(uint32_t address)
+{
+  site *found;
+  auto const index = address >> 1;
+  if(index < flash_sites.size()) {
+    found = &flash_sites[index];
+  } else {
+    found = &other_sites[address];
+  }
+
+  if(found->size != 0) {
+    return *found;
+  }
+
+  // first time at this instruction: classify its control flow once
+  auto &instruction = *found;
+  instruction.address = address;
+  instruction.size = 2;
+  auto const encoding = halfword(flash, address);
+  if((encoding & 0xF800) == 0xF000 && (halfword(flash, address + 2) & 0xD000) == 0xD000) {
+    // bl
+    instruction.flow = control::call;
+    instruction.size = 4;
+  } else if((encoding & 0xFF87) == 0x4780) {
+    // blx Rm
+    instruction.flow = control::call;
+  } else if(encoding == 0x4770 || encoding == 0x46F7 || (encoding & 0xFF00) == 0xBD00) {
+    // bx lr, mov pc, lr, pop {..., pc}
+    instruction.flow = control::return_from_call;
+  } else if((encoding & 0xFF87) == 0x4700 || (encoding & 0xFF87) == 0x4687) {
+    // bx Rm, mov pc, Rm
+    instruction.flow = control::indirect;
+  }
+
+  // without a function symbol, the instruction belongs to the function it was first reached in
+  auto const symbol = symbols.find(address);
+  if(symbol != nullptr && symbol->is_function) {
+    instruction.function = function_at(symbol->address);
+  } else if(!stack.empty()) {
+    instruction.function = nodes[stack.back().node].function;
+  } else {
+    instruction.function = function_at(address);
+  }
+
+  return instruction;
+}
+
+uint32_t profiler::function_at(uint32_t address)
+{
+  auto const symbol = symbols.find(address);
+  auto const entry = symbol != nullptr && symbol->is_function ? symbol->address : address;
+
+  auto const existing = functions.find(entry);
+  if(existing != functions.end()) {
+    return existing->second;
+  }
+
+  auto const function = static_cast<uint32_t>(function_names.size());
+  if(symbol != nullptr && symbol->is_function) {
+    function_names.push_back(symbol->name);
+  } else {
+    char name[16];
+    std::snprintf(name, sizeof(name), "0x%08X", address);
+    function_names.emplace_back(name);
+  }
+  functions.emplace(entry, function);
+
+  return function;
+}
+
+uint32_t profiler::child(uint32_t parent, uint32_t function)
+{
+  auto const key = (static_cast<uint64_t>(parent) << 32) | function;
+  auto const existing = children.find(key);
+  if(existing != children.end()) {
+    return existing->second;
+  }
+
+  auto const node = static_cast<uint32_t>(nodes.size());
+  nodes.push_back({parent, function, 0, 0.0});
+  children.emplace(key, node);
+
+  return node;
+}
+
+void profiler::execute(uint32_t address,
+    uint32_t next_address,
+    uint64_t cycles,
+    double energy,
+    uint64_t icache_misses,
+    uint64_t dcache_misses)
+{
+  if(stack.empty()) {
+    stack.push_back({0xFFFFFFFF, child(0, function_at(address))});
+  }
+
+  auto &instruction = get_site(address);
+  instruction.instructions++;
+  instruction.cycles += cycles;
+  instruction.energy += energy;
+  instruction.icache_misses += icache_misses;
+  instruction.dcache_misses += dcache_misses;
+  if(instruction.since_backup++ == 0) {
+    touched_since_backup.push_back(&instruction);
+  }
+
+  // code reached by a jump instead of a call is shown below the frame it was jumped to from
+  auto node = stack.back().node;
+  if(nodes[node].function != instruction.function) {
+    if(leaf_parent != node || leaf_function != instruction.function) {
+      leaf_parent = node;
+      leaf_function = instruction.function;
+      leaf_node = child(node, instruction.function);
+    }
+    node = leaf_node;
+  }
+  nodes[node].cycles += cycles;
+  nodes[node].energy += energy;
+
+  switch(instruction.flow) {
+  case control::none:
+    break;
+  case control::call:
+    if(next_address != address + instruction.size) {
+      stack.push_back({address + instruction.size, child(node, function_at(next_address))});
+    }
+    break;
+  case control::indirect:
+  case control::return_from_call: {
+    auto const caller = std::find_if(stack.rbegin(), stack.rend(),
+        [&](frame const &f) { return f.return_address == next_address; });
+    if(caller != stack.rend()) {
+      stack.erase(std::prev(caller.base()), stack.end());
+    } else if(instruction.flow == control::return_from_call) {
+      // returned to a caller we have not seen, e.g. from the reset handler: start over there
+      stack.clear();
+    }
+    break;
+  }
+  }
+}
+
+void profiler::backup(uint32_t address, bool requested)
+{
+  if(stack.empty()) {
+    stack.push_back({0xFFFFFFFF, child(0, function_at(address))});
+  }
+
+  auto &instruction = get_site(address);
+  instruction.backups++;
+  if(requested) {
+    instruction.requested_backups++;
+  }
+
+  for(auto const committed : touched_since_backup) {
+    committed->since_backup = 0;
+  }
+  touched_since_backup.clear();
+
+  saved_stack = stack;
+}
+
+void profiler::restore()
+{
+  for(auto const lost : touched_since_backup) {
+    lost->re_executed += lost->since_backup;
+    lost->since_backup = 0;
+  }
+  touched_since_backup.clear();
+
+  stack = saved_stack;
+}
+
+std::string profiler::stack_name(uint32_t node) const
+{
+  std::vector<uint32_t> path;
+  for(; node != 0; node = nodes[node].parent) {
+    path.push_back(nodes[node].function);
+  }
+
+  std::string name;
+  for(auto function = path.rbegin(); function != path.rend(); ++function) {
+    if(!name.empty()) {
+      name += ';';
+    }
+    name += function_names[*function];
+  }
+
+  return name;
+}
+
+void profiler::write_folded_cycles(std::ostream &stream) const
+{
+  for(uint32_t node = 1; node < nodes.size(); ++node) {
+    if(nodes[node].cycles > 0) {
+      stream << stack_name(node) << ' ' << nodes[node].cycles << '\n';
+    }
+  }
+}
+
+void profiler::write_folded_energy(std::ostream &stream) const
+{
+  for(uint32_t node = 1; node < nodes.size(); ++node) {
+    auto const picojoules = std::llround(nodes[node].energy * 1e3);
+    if(picojoules > 0) {
+      stream << stack_name(node) << ' ' << picojoules << '\n';
+    }
+  }
+}
+
+void profiler::write_flat_profile(std::ostream &stream, size_t hot_spots) const
+{
+  std::vector<function_totals> totals(function_names.size());
+  function_totals all;
+  std::vector<site const *> executed;
+  auto const add = [&](site const &instruction) {
+    if(instruction.instructions == 0 && instruction.backups == 0) {
+      return;
+    }
+    executed.push_back(&instruction);
+
+    for(auto totals_of : {&totals[instruction.function], &all}) {
+      totals_of->function = instruction.function;
+      totals_of->instructions += instruction.instructions;
+      totals_of->cycles += instruction.cycles;
+      totals_of->energy += instruction.energy;
+      totals_of->icache_misses += instruction.icache_misses;
+      totals_of->dcache_misses += instruction.dcache_misses;
+      totals_of->requested_backups += instruction.requested_backups;
+      totals_of->backups += instruction.backups;
+      totals_of->re_executed += instruction.re_executed;
+    }
+  };
+  for(auto const &instruction : flash_sites) {
+    add(instruction);
+  }
+  for(auto const &instruction : other_sites) {
+    add(instruction.second);
+  }
+
+  totals.erase(std::remove_if(totals.begin(), totals.end(),
+                   [](function_totals const &f) { return f.instructions == 0 && f.backups == 0; }),
+      totals.end());
+  std::sort(totals.begin(), totals.end(), [](function_totals const &a, function_totals const &b) {
+    return a.cycles != b.cycles ? a.cycles > b.cycles : a.energy > b.energy;
+  });
+
+  stream << "Flat profile (energy in nJ, requested backups include idempotency violations)\n";
+  stream << std::setw(7) << "cycles%" << std::setw(14) << "cycles" << std::setw(8) << "energy%"
+         << std::setw(14) << "energy" << std::setw(12) << "insns" << std::setw(12) << "re-exec"
+         << std::setw(10) << "i-misses" << std::setw(10) << "d-misses" << std::setw(10)
+         << "backups" << std::setw(10) << "requested"
+         << "  function\n";
+  auto const write_row = [&](function_totals const &f, std::string const &name) {
+    stream << std::fixed << std::setprecision(2) << std::setw(7) << percent(f.cycles, all.cycles)
+           << std::setw(14) << f.cycles << std::setw(8) << percent(f.energy, all.energy)
+           << std::setprecision(3) << std::setw(14) << f.energy << std::setw(12) << f.instructions
+           << std::setw(12) << f.re_executed << std::setw(10) << f.icache_misses << std::setw(10)
+           << f.dcache_misses << std::setw(10) << f.backups << std::setw(10) << f.requested_backups
+           << "  " << name << '\n';
+  };
+  for(auto const &f : totals) {
+    write_row(f, function_names[f.function]);
+  }
+  write_row(all, "(total)");
+
+  hot_spots = std::min(hot_spots, executed.size());
+  std::partial_sort(executed.begin(), executed.begin() + hot_spots, executed.end(),
+      [](site const *a, site const *b) {
+        return a->cycles != b->cycles ? a->cycles > b->cycles : a->address < b->address;
+      });
+
+  stream << "\nHot spots\n";
+  stream << std::setw(7) << "cycles%" << std::setw(14) << "cycles" << std::setw(14) << "energy"
+         << std::setw(12) << "insns" << std::setw(12) << "re-exec" << std::setw(10) << "backups"
+         << "  address\n";
+  for(size_t i = 0; i < hot_spots; ++i) {
+    auto const &instruction = *executed[i];
+    stream << std::fixed << std::setprecision(2) << std::setw(7)
+           << percent(instruction.cycles, all.cycles) << std::setw(14) << instruction.cycles
+           << std::setprecision(3) << std::setw(14) << instruction.energy << std::setw(12)
+           << instruction.instructions << std::setw(12) << instruction.re_executed << std::setw(10)
+           << instruction.backups << "  " << symbols.describe(instruction.address) << '\n';
+  }
+}
+}
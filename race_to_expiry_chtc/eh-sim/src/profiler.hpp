@@ -0,0 +1,168 @@
+#ifndef EH_SIM_PROFILER_HPP
+#define EH_SIM_PROFILER_HPP
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace thumbulator {
+struct program_image;
+class symbol_table;
+}
+
+namespace ehsim {
+
+/**
+ * Attributes the cost of a simulation to the instructions and functions of the program.
+ *
+ * The simulation loop reports every executed instruction with the cycles and modeled energy it
+ * took, including the backups and restores around it, and the cache misses it caused. Backups are
+ * reported where they happen, so the instructions lost to a power failure are known and counted as
+ * re-executed where they ran.
+ *
+ * The call stack is followed through bl and blx, and unwound by returns (bx lr, pop {pc}, or any
+ * indirect branch) to the return address of a frame. A backup saves the call stack and a restore
+ * returns to it, as it does for the registers. Frames are named by the function symbols of an ELF
+ * program, or by the address of the call target without symbols.
+ *
+ * Only built with EH_SIM_PROFILER, see the CMake option of the same name.
+ */
+class profiler {
+public:
+  /**
+   * Profile a program.
+   *
+   * @param program The application, it has to outlive the profiler.
+   */
+  explicit profiler(thumbulator::program_image const &program);
+
+  profiler(profiler const &) = delete;
+  profiler &operator=(profiler const &) = delete;
+
+  /**
+   * An instruction was executed.
+   *
+   * @param address The address of the instruction.
+   * @param next_address The address of the instruction executed next.
+   * @param cycles The cycles taken, including backups and restores.
+   * @param energy The energy consumed (nJ), including backups.
+   * @param icache_misses The instruction cache misses caused by the instruction.
+   * @param dcache_misses The data cache misses caused by the instruction.
+   */
+  void execute(uint32_t address,
+      uint32_t next_address,
+      uint64_t cycles,
+      double energy,
+      uint64_t icache_misses,
+      uint64_t dcache_misses);
+
+  /**
+   * The state was backed up at an instruction.
+   *
+   * @param address The address of the instruction the backup is attributed to.
+   * @param requested true if the scheme asked for the backup, e.g. for an idempotency violation.
+   */
+  void backup(uint32_t address, bool requested);
+
+  /**
+   * The state was restored after a power failure, everything executed since the last backup runs
+   * again.
+   */
+  void restore();
+
+  /**
+   * Write the call stacks in folded format, one line per stack with its cycles, for flame graphs.
+   */
+  void write_folded_cycles(std::ostream &stream) const;
+
+  /**
+   * Write the call stacks in folded format, one line per stack with its energy in pJ.
+   */
+  void write_folded_energy(std::ostream &stream) const;
+
+  /**
+   * Write the functions sorted by cycles, then the hottest instructions.
+   *
+   * @param hot_spots The number of instructions to list.
+   */
+  void write_flat_profile(std::ostream &stream, size_t hot_spots = 20) const;
+
+private:
+  enum class control : uint8_t { none, call, indirect, return_from_call };
+
+  /**
+   * The counters of one instruction.
+   */
+  struct site {
+    uint32_t address = 0;
+    uint32_t function = 0;
+    control flow = control::none;
+    // 0 until the instruction is classified
+    uint8_t size = 0;
+
+    uint64_t instructions = 0;
+    uint64_t cycles = 0;
+    double energy = 0;
+    uint64_t icache_misses = 0;
+    uint64_t dcache_misses = 0;
+    uint64_t requested_backups = 0;
+    uint64_t backups = 0;
+    uint64_t re_executed = 0;
+
+    // executions since the last backup, lost on a power failure
+    uint64_t since_backup = 0;
+  };
+
+  /**
+   * A call stack, the root node has no function.
+   */
+  struct stack_node {
+    uint32_t parent;
+    uint32_t function;
+    uint64_t cycles;
+    double energy;
+  };
+
+  struct frame {
+    uint32_t return_address;
+    uint32_t node;
+  };
+
+  std::vector<uint32_t> const &flash;
+  thumbulator::symbol_table const &symbols;
+
+  // indexed by address / 2 for instructions in flash
+  std::vector<site> flash_sites;
+  std::unordered_map<uint32_t, site> other_sites;
+  std::vector<site *> touched_since_backup;
+
+  std::vector<std::string> function_names;
+  std::unordered_map<uint32_t, uint32_t> functions;
+
+  std::vector<stack_node> nodes;
+  std::unordered_map<uint64_t, uint32_t> children;
+
+  std::vector<frame> stack;
+  std::vector<frame> saved_stack;
+
+  // the stack node of the last instruction whose function was not the one of its frame
+  uint32_t leaf_parent = 0;
+  uint32_t leaf_function = 0;
+  uint32_t leaf_node = 0;
+
+  site &get_site(uint32_t address);
+
+  /**
+   * The function a call to an address enters.
+   */
+  uint32_t function_at(uint32_t address);
+
+  uint32_t child(uint32_t parent, uint32_t function);
+
+  std::string stack_name(uint32_t node) const;
+};
+}
+
+#endif //EH_SIM_PROFILER_HPP
@@ -13,7 +13,7 @@ namespace ehsim {
  *
  * See the data relating to the BEC scheme.
  */
-class backup_every_cycle : public eh_scheme {
+class backup_every_cycle final : public eh_scheme {
 public:
   backup_every_cycle() : battery(NVP_CAPACITANCE, MEMENTOS_MAX_CAPACITOR_VOLTAGE, MEMENTOS_MAX_CURRENT)
   {}
@@ -46,7 +46,7 @@ public:
     stats->models.back().energy_for_instructions += NVP_INSTRUCTION_ENERGY;
   }
 
-  void calculate_backup_locs(bool use_reg_lva, const std::set<uint64_t> dead_regs) override
+  void calculate_backup_locs(bool use_reg_lva, uint16_t dead_regs) override
   {
   }
 
@@ -8,6 +8,9 @@
 
 #include <thumbulator/memory.hpp>
 #include <thumbulator/cpu.hpp>
+#include <thumbulator/machine.hpp>
+
+#include <algorithm>
 #include <unordered_map>
 
 namespace ehsim {
@@ -15,8 +18,18 @@ namespace ehsim {
 /**
  * Based on Clank: Architectural Support for Intermittent Computation.
  */
-class clank : public eh_scheme {
+class clank final : public eh_scheme {
 public:
+  /**
+   * The parameters that configurations of a sweep can differ in and still share a run.
+   */
+  struct parameters {
+    size_t rf_entries;
+    size_t wf_entries;
+    size_t wb_entries;
+    int watchdog_period;
+  };
+
   /**
    * Construct a default clank configuration.
    */
@@ -35,11 +48,11 @@ public:
     assert(READFIRST_ENTRIES >= 1);
     assert(WRITEFIRST_ENTRIES >= 0);
 
-    thumbulator::ram_load_hook = [this](
-        uint32_t address, uint32_t data) -> uint32_t { return this->process_read(address, data); };
-
-    thumbulator::ram_store_hook = [this](uint32_t address, uint32_t last_value,
-        uint32_t value, bool wb) -> uint32_t { return this->process_store(address, last_value, value, wb); };
+    // hooks go into the machine of the simulation this scheme is created for
+    auto &machine = thumbulator::active_machine();
+    machine.ram_load_hook = thumbulator::ram_load_function::bind<clank, &clank::process_read>(this);
+    machine.ram_store_hook =
+        thumbulator::ram_store_function::bind<clank, &clank::process_store>(this);
   }
 
   capacitor &get_battery() override
@@ -72,7 +85,7 @@ public:
     stats->models.back().energy_for_instructions += instruction_energy;
   }
 
-  void calculate_backup_locs(bool use_reg_lva, const std::set<uint64_t> dead_regs) override
+  void calculate_backup_locs(bool use_reg_lva, uint16_t dead_regs) override
   {
     num_backup_regs = 20;
 
@@ -80,7 +93,7 @@ public:
       num_backup_regs = 7;
 
       for (uint64_t reg = 0; reg < 13; reg++) {
-        if (dead_regs.find(reg) == dead_regs.end()) {
+        if ((dead_regs & (1u << reg)) == 0) {
           if (thumbulator::cpu_get_gpr_dbit(reg)) {
             //std::cout << "r" << reg << "(L)" << std::endl;
             num_backup_regs++;
@@ -151,7 +164,7 @@ public:
     thumbulator::cpu_clear_gpr_dbit();
 
     // save architectural state
-    architectural_state = thumbulator::cpu;
+    architectural_state = thumbulator::active_machine().cpu;
 
     return backup_time;
   }
@@ -163,7 +176,7 @@ public:
 
     // restore saved architectural state
     thumbulator::cpu_reset();
-    thumbulator::cpu = architectural_state;
+    thumbulator::active_machine().cpu = architectural_state;
 
     stats->models.back().energy_for_restore = CLANK_RESTORE_ENERGY;
     battery.consume_energy(CLANK_RESTORE_ENERGY);
@@ -197,7 +210,7 @@ public:
 
   void set_dead_addresses(const std::set<uint64_t>& dead_mem_addrs) override
   {
-    dead_mem_locs = dead_mem_addrs;
+    dead_mem_locs = &dead_mem_addrs;
   }
 
   void reset_stats() override
@@ -209,7 +222,47 @@ public:
   bool optimal_backup_scheme(uint64_t curr_insn_cycle, uint32_t address, size_t set, size_t way, bool memwr, bool memop, bool branch, bool branch_link, uint32_t num_mem_access) override
   { return false; }
 
+  /**
+   * Whether a run with other parameters from the same state can decide differently from this one
+   * before the next instruction completes.
+   *
+   * Call it after an instruction, before the backup decision.
+   */
+  bool diverges(parameters const &other) const
+  {
+    // buffers of different sizes hold the same addresses until an insert fails in the smaller one
+    auto const may_fill = [](size_t used, size_t entries, size_t other_entries) {
+      return entries != other_entries
+             && used + MAX_INSERTS_PER_INSTRUCTION > std::min(entries, other_entries);
+    };
+    // backups and restores restart both watchdogs, so they stay apart by the difference of periods
+    auto const other_watchdog = progress_watchdog + other.watchdog_period - WATCHDOG_PERIOD;
+
+    return may_fill(readfirst_buffer.size(), READFIRST_ENTRIES, other.rf_entries)
+           || may_fill(writefirst_buffer.size(), WRITEFIRST_ENTRIES, other.wf_entries)
+           || may_fill(writeback_buffer.size(), WRITEBACK_ENTRIES, other.wb_entries)
+           || (other.watchdog_period != WATCHDOG_PERIOD
+                  && std::min(progress_watchdog, other_watchdog) <= 0);
+  }
+
+  /**
+   * Continue the run as if it had used other parameters from the start.
+   *
+   * Only valid while the runs have not diverged, see diverges.
+   */
+  void retarget(parameters const &other)
+  {
+    progress_watchdog += other.watchdog_period - WATCHDOG_PERIOD;
+    WATCHDOG_PERIOD = other.watchdog_period;
+    READFIRST_ENTRIES = other.rf_entries;
+    WRITEFIRST_ENTRIES = other.wf_entries;
+    WRITEBACK_ENTRIES = other.wb_entries;
+  }
+
 private:
+  // push and pop access at most eight registers and lr or pc
+  static constexpr size_t MAX_INSERTS_PER_INSTRUCTION = 9;
+
   capacitor battery;
 
   uint64_t last_backup_cycle = 0u;
@@ -218,10 +271,11 @@ private:
   thumbulator::cpu_state architectural_state{};
   bool active = false;
 
-  int const WATCHDOG_PERIOD;
-  size_t const READFIRST_ENTRIES;
-  size_t const WRITEFIRST_ENTRIES;
-  size_t const WRITEBACK_ENTRIES;
+  // set once, or by retarget
+  int WATCHDOG_PERIOD;
+  size_t READFIRST_ENTRIES;
+  size_t WRITEFIRST_ENTRIES;
+  size_t WRITEBACK_ENTRIES;
 
   uint8_t  num_backup_regs = 0;
   uint32_t num_stores = 0;
@@ -254,7 +308,8 @@ private:
   std::set<uint32_t> readfirst_buffer;
   std::set<uint32_t> writefirst_buffer;
   std::unordered_map<uint32_t, wb_entry> writeback_buffer;
-  std::set<uint64_t> dead_mem_locs;
+  // owned by the memory liveness trace
+  std::set<uint64_t> const *dead_mem_locs = nullptr;
 
   enum class operation { read, write };
 
@@ -318,8 +373,8 @@ private:
     auto const writeback_it = writeback_buffer.find(address);
     auto const writeback_hit = writeback_it != writeback_buffer.end(); 
 
-    auto const dead_loc_it = dead_mem_locs.find(address);
-    auto const dead_loc_hit = dead_loc_it != dead_mem_locs.end();
+    auto const dead_loc_hit =
+        dead_mem_locs != nullptr && dead_mem_locs->find(address) != dead_mem_locs->end();
 
     //std::cout << "address=0x" << std::hex << address 
     //          << " readfirst_hit=" << readfirst_hit
@@ -2,6 +2,7 @@
 #ifndef EH_SIM_SCHEME_HPP
 #define EH_SIM_SCHEME_HPP
 
+#include <cstdint>
 #include <set>
 #include <unordered_map>
 
@@ -24,7 +25,7 @@ public:
 
   virtual void execute_instruction(stats_bundle *stats) = 0;
 
-  virtual void calculate_backup_locs(bool use_reg_lva, const std::set<uint64_t> dead_regs) = 0;
+  virtual void calculate_backup_locs(bool use_reg_lva, uint16_t dead_regs) = 0;
 
   virtual bool is_active(stats_bundle *stats) = 0;
 
@@ -36,6 +37,9 @@ public:
 
   virtual double estimate_progress(eh_model_parameters const &) const = 0;
 
+  /**
+   * The set is owned by the memory liveness trace and outlives the simulation.
+   */
   virtual void set_dead_addresses(const std::set<uint64_t>&) = 0;
 
   virtual const uint32_t get_wb_buffer_size() = 0;
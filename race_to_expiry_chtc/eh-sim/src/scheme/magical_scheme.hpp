@@ -35,7 +35,7 @@ public:
   {
   }
 
-  void calculate_backup_locs(bool use_reg_lva, const std::set<uint64_t> dead_regs) override
+  void calculate_backup_locs(bool use_reg_lva, uint16_t dead_regs) override
   {
   }
 
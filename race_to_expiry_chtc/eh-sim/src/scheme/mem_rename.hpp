@@ -4,11 +4,13 @@
 #include "scheme/eh_scheme.hpp"
 #include "scheme/data_sheet.hpp"
 #include "capacitor.hpp"
+#include "simulation.hpp"
 #include "stats.hpp"
 
 #include <unordered_set>
 #include <thumbulator/memory.hpp>
 #include <thumbulator/cpu.hpp>
+#include <thumbulator/machine.hpp>
 #include <bf/bloom_filter/basic.hpp>
 
 
@@ -19,7 +21,7 @@ namespace ehsim {
  *
  * Only implements the read- and write-first buffers.
  */
-class mem_rename : public eh_scheme {
+class mem_rename final : public eh_scheme {
 public:
   /**
    * Construct a default mem_rename configuration.
@@ -86,7 +88,9 @@ public:
       	     double   map_table_write_energy,
       	     double   map_table_leakage_power,
       	     double   free_list_read_energy,
-      	     double   free_list_leakage_power)
+      	     double   free_list_leakage_power,
+             thumbulator::replacement_policy icache_policy = thumbulator::replacement_policy::counter,
+             thumbulator::replacement_policy dcache_policy = thumbulator::replacement_policy::counter)
              : battery(BATTERYLESS_CAPACITANCE, BATTERYLESS_MAX_CAPACITOR_VOLTAGE, MEMENTOS_MAX_CURRENT)
              , WATCHDOG_PERIOD(watchdog_period)
              , READFIRST_ENTRIES(rf_entries)
@@ -118,32 +122,36 @@ public:
       readfirst_filter = std::unique_ptr<bf::basic_bloom_filter>(new bf::basic_bloom_filter(0.25, READFIRST_ENTRIES, 1, false, false));
     }
 
-    insn_cache = std::make_shared<thumbulator::cache>(icache_assoc, icache_block_size, icache_size, 0);
-    thumbulator::icache = insn_cache;
+    // caches and hooks go into the machine of the simulation this scheme is created for
+    auto &machine = thumbulator::active_machine();
 
-    data_cache = std::make_shared<thumbulator::cache>(dcache_assoc, dcache_block_size, dcache_size, lbf_size);
-    thumbulator::dcache = data_cache;
+    insn_cache = thumbulator::make_cache(icache_policy, icache_assoc, icache_block_size, icache_size, 0);
+    machine.icache = insn_cache;
+
+    data_cache = thumbulator::make_cache(dcache_policy, dcache_assoc, dcache_block_size, dcache_size, lbf_size);
+    machine.dcache = data_cache;
 
     // victim_data = new uint32_t[dcache_block_size];
 
-    thumbulator::OPTIMAL_BACKUP_POLICY = use_optimal_backup_scheme;
+    machine.optimal_backup_policy = use_optimal_backup_scheme;
 
     if(add_renamer) {
       mem_renamer = std::make_shared<thumbulator::rename>(map_table_entries, num_avail_rename_addrs, reclaim_addr);
-      thumbulator::renamer = mem_renamer;
+      machine.renamer = mem_renamer;
     }
 
-    thumbulator::cache_load_hook = [this](
-        thumbulator::cache_block& blk, uint32_t address, bool lbf, size_t set, size_t way) -> bool { return this->process_cache_read(blk, address, lbf, set, way); };
-
-    thumbulator::cache_store_hook = [this](
-        thumbulator::cache_block& blk, uint32_t address, bool lbf, size_t set, size_t way, bool& gbf_hit) -> bool { return this->process_cache_write(blk, address, lbf, set, way, gbf_hit); };
-
-    thumbulator::ram_load_hook = [this](
-        uint32_t address, uint32_t data) -> uint32_t { return this->process_ram_load(address, data); };
-
-    thumbulator::ram_store_hook = [this](uint32_t address, uint32_t last_value,
-        uint32_t value, bool backup) -> uint32_t { return this->process_ram_store(address, last_value, value, backup); };          
+    machine.cache_load_hook =
+        thumbulator::cache_load_function::bind<mem_rename, &mem_rename::process_cache_read>(this);
+    machine.cache_store_hook =
+        thumbulator::cache_store_function::bind<mem_rename, &mem_rename::process_cache_write>(this);
+    machine.ram_load_hook =
+        thumbulator::ram_load_function::bind<mem_rename, &mem_rename::process_ram_load>(this);
+    machine.ram_store_hook =
+        thumbulator::ram_store_function::bind<mem_rename, &mem_rename::process_ram_store>(this);
+    machine.ram_line_load_hook =
+        thumbulator::ram_line_load_function::bind<mem_rename, &mem_rename::process_ram_load_line>(this);
+    machine.ram_line_store_hook =
+        thumbulator::ram_line_store_function::bind<mem_rename, &mem_rename::process_ram_store_line>(this);
   }
 
   capacitor &get_battery() override
@@ -179,7 +187,7 @@ public:
     auto const insn_cycles = stats->cpu.cycle_count - last_tick;
     // mem_rename's instruction/cache leakage energy is in Energy-per-Cycle
     auto instruction_fetch_energy = 0;
-    if(thumbulator::icache_hit) {
+    if(thumbulator::active_machine().icache_hit) {
     	instruction_fetch_energy =  MEM_RENAME_ICACHE_READ_ENERGY;
     }
     else {
@@ -225,7 +233,7 @@ public:
     progress_watchdog -= elapsed_cycles;
   }
 
-  void calculate_backup_locs(bool use_reg_lva, const std::set<uint64_t> dead_regs) override
+  void calculate_backup_locs(bool use_reg_lva, uint16_t dead_regs) override
   {
     num_backup_regs = 20;
 
@@ -233,7 +241,7 @@ public:
       num_backup_regs = 7;
 
       for (uint64_t reg = 0; reg < 13; reg++) {
-        if (dead_regs.find(reg) == dead_regs.end()) {
+        if ((dead_regs & (1u << reg)) == 0) {
           if (thumbulator::cpu_get_gpr_dbit(reg)) {
             //std::cout << "r" << reg << "(L)" << std::endl;
             num_backup_regs++;
@@ -258,7 +266,7 @@ public:
     } else if(battery.energy_stored() < calculate_backup_energy()) {
       if(active)
       {
-        std::cout << "cycle " << std::dec << stats->cpu.cycle_count << ": POWER OFF - is_active()" << std::endl;
+        *active_simulation().out << "cycle " << std::dec << stats->cpu.cycle_count << ": POWER OFF - is_active()" << std::endl;
       }
       power_off();
     }
@@ -268,13 +276,13 @@ public:
 
   bool will_backup(stats_bundle *stats) override
   {
-    if(progress_watchdog <= 0 && !thumbulator::OPTIMAL_BACKUP_POLICY) {
+    if(progress_watchdog <= 0 && !thumbulator::active_machine().optimal_backup_policy) {
         
-      std::cout << "cycle " << std::dec << stats->cpu.cycle_count << ": progress watchdog timed off" << std::endl;
+      *active_simulation().out << "cycle " << std::dec << stats->cpu.cycle_count << ": progress watchdog timed off" << std::endl;
 	  return false;
     }
 
-    if(mem_renamer && thumbulator::OPTIMAL_BACKUP_POLICY) {
+    if(mem_renamer && thumbulator::active_machine().optimal_backup_policy) {
       return false;
     }
 
@@ -283,19 +291,19 @@ public:
     }
 
     if((battery.energy_stored() < calculate_backup_energy()) && idempotent_violation) {
-      std::cout << "cycle " << std::dec << stats->cpu.cycle_count << ": battery energy not enough for backup" << std::endl;
+      *active_simulation().out << "cycle " << std::dec << stats->cpu.cycle_count << ": battery energy not enough for backup" << std::endl;
       power_off();
       return false;
     }
 
     if(battery.energy_stored() == 0) {
-      std::cout << "cycle " << std::dec << stats->cpu.cycle_count << ": battery energy drained" << std::endl;
+      *active_simulation().out << "cycle " << std::dec << stats->cpu.cycle_count << ": battery energy drained" << std::endl;
       power_off();
       return false;
     }
 
     if(idempotent_violation) {
-      std::cout << "cycle " << std::dec << stats->cpu.cycle_count << ": backup (idempotent_violation)" << std::endl;
+      *active_simulation().out << "cycle " << std::dec << stats->cpu.cycle_count << ": backup (idempotent_violation)" << std::endl;
     }
     return idempotent_violation;
   }
@@ -306,7 +314,7 @@ public:
     // std::cout << "Cycle " << stats->cpu.cycle_count << ": end_backup_insn = " << std::dec << stats->cpu.end_backup_insn << std::endl;
     auto &active_stats = stats->models.back();
     active_stats.num_backups++;
-    if(!mem_renamer && thumbulator::OPTIMAL_BACKUP_POLICY && idempotent_violation) {
+    if(!mem_renamer && thumbulator::active_machine().optimal_backup_policy && idempotent_violation) {
       active_stats.num_id_backups++;
     }
 
@@ -353,7 +361,7 @@ public:
     thumbulator::cpu_clear_gpr_dbit();
 
     // save architectural state
-    architectural_state = thumbulator::cpu;
+    architectural_state = thumbulator::active_machine().cpu;
 
     return backup_time;
   }
@@ -371,7 +379,7 @@ public:
     thumbulator::cpu_reset();
 
     if(last_backup_cycle > 0) {
-      thumbulator::cpu = architectural_state;
+      thumbulator::active_machine().cpu = architectural_state;
     }
     else {
       thumbulator::cpu_set_pc(thumbulator::cpu_get_pc() + 0x4);
@@ -403,7 +411,7 @@ public:
 
   void set_dead_addresses(const std::set<uint64_t>& dead_mem_addrs) override
   {
-    dead_mem_locs = dead_mem_addrs;
+    dead_mem_locs = &dead_mem_addrs;
   }
 
   void reset_stats() override
@@ -449,7 +457,7 @@ public:
     // auto instruction_fetch_energy = 0;
     // auto need_renaming = false;
 
-    // if(thumbulator::icache_hit) {
+    // if(thumbulator::active_machine().icache_hit) {
     //   curr_insn_cycle += 1;
     //   instruction_fetch_energy = MEM_RENAME_ICACHE_READ_ENERGY;
     // }
@@ -462,7 +470,7 @@ public:
     // insn_cycles = 1;
 
     // if(memop) { // store/load instruction
-    //   if(thumbulator::dcache_hit) {
+    //   if(thumbulator::active_machine().dcache_hit) {
     //     insn_cycles = num_mem_access * 1;
     //     if(memwr) 
     //       cache_energy_per_insn = num_mem_access * (MEM_RENAME_DCACHE_WRITE_ENERGY + 2 * LOCAL_BLOOMFILTER_ACCESS_ENERGY);
@@ -613,7 +621,7 @@ private:
   std::shared_ptr<thumbulator::cache>  insn_cache = nullptr;
   std::shared_ptr<thumbulator::cache>  data_cache = nullptr;
   std::shared_ptr<thumbulator::rename> mem_renamer = nullptr;
-  std::set<uint64_t>                   dead_mem_locs;
+  std::set<uint64_t> const            *dead_mem_locs = nullptr; // owned by the memory liveness trace
 
   enum class operation { read, write };
 
@@ -716,8 +724,9 @@ private:
     else {
       if(!map_table_hit && mem_renamer->is_map_table_full()) {
         rename_overhead_energy += MAP_TABLE_ACCESS_ENERGY;
-        std::cout << "rename_addr: (backup) map table full" << std::endl;
+        *active_simulation().out << "rename_addr: (backup) map table full" << std::endl;
         idempotent_violation = true;
+        auto &stats = active_simulation().stats;
         if(will_backup(&stats)) {
         	stats.cpu.mr_backup_time = backup(&stats);
           stats.cpu.was_mr_backup =  true;
@@ -733,8 +742,9 @@ private:
         }
         else {
           rename_overhead_energy += MAP_TABLE_ACCESS_ENERGY;
-          std::cout << "rename_addr: (backup) no available rename addresses" << std::endl;
+          *active_simulation().out << "rename_addr: (backup) no available rename addresses" << std::endl;
           idempotent_violation = true;
+          auto &stats = active_simulation().stats;
           if(will_backup(&stats)) {
             stats.cpu.mr_backup_time = backup(&stats);
             stats.cpu.was_mr_backup = true;
@@ -748,7 +758,7 @@ private:
 
   bool process_cache_read(thumbulator::cache_block& blk, uint32_t address, bool lbf, size_t set, size_t way)
   {
-    if(thumbulator::dcache_hit) {
+    if(thumbulator::active_machine().dcache_hit) {
       cache_energy_per_insn += MEM_RENAME_DCACHE_READ_ENERGY + 2 * LOCAL_BLOOMFILTER_ACCESS_ENERGY;
     }
     else {
@@ -761,7 +771,7 @@ private:
 
   bool process_cache_write(thumbulator::cache_block& blk, uint32_t address, bool lbf, size_t set, size_t way, bool& gbf_hit)
   {
-    if(thumbulator::dcache_hit) {
+    if(thumbulator::active_machine().dcache_hit) {
       cache_energy_per_insn += MEM_RENAME_DCACHE_WRITE_ENERGY + 2 * LOCAL_BLOOMFILTER_ACCESS_ENERGY;
     }
     else {
@@ -779,8 +789,8 @@ private:
       return value;
     }
 
-    if(active && battery.energy_stored() < calculate_backup_energy() && !thumbulator::OPTIMAL_BACKUP_POLICY) {
-      std::cout << " POWER OFF: Not enough energy to load data from RAM: address=0x" << std::hex << address << std::endl;
+    if(active && battery.energy_stored() < calculate_backup_energy() && !thumbulator::active_machine().optimal_backup_policy) {
+      *active_simulation().out << " POWER OFF: Not enough energy to load data from RAM: address=0x" << std::hex << address << std::endl;
       power_off();
     }
     else {
@@ -797,8 +807,8 @@ private:
       return value;
     }
 
-    if(battery.energy_stored() < calculate_backup_energy() && !thumbulator::OPTIMAL_BACKUP_POLICY) {
-      std::cout << " POWER OFF: Not enough energy to store data into RAM: address=0x" << std::hex << address << std::endl;
+    if(battery.energy_stored() < calculate_backup_energy() && !thumbulator::active_machine().optimal_backup_policy) {
+      *active_simulation().out << " POWER OFF: Not enough energy to store data into RAM: address=0x" << std::hex << address << std::endl;
       power_off();
       return old_value;
     }
@@ -811,6 +821,54 @@ private:
     return value;
   }
   
+  /**
+   * process_ram_load for every word of a cache line, with the same energy and power failures.
+   */
+  void process_ram_load_line(uint32_t address, uint32_t * /*words*/, size_t count)
+  {
+    size_t charged = 0;
+    if(!continuous_power_supply && active && battery.energy_stored() < calculate_backup_energy() && !thumbulator::active_machine().optimal_backup_policy) {
+      *active_simulation().out << " POWER OFF: Not enough energy to load data from RAM: address=0x" << std::hex << address << std::endl;
+      power_off();
+      // the rest of the line loads powered off
+      charged = 1;
+    }
+
+    // word by word, so the sum rounds as it does for single loads
+    for(; charged < count; ++charged) {
+      mem_access_energy += CORTEX_M0PLUS_ENERGY_FLASH;
+    }
+  }
+
+  /**
+   * process_ram_store for every word of a cache line, with the same energy and power failures.
+   */
+  void process_ram_store_line(uint32_t address, uint32_t const *old_words, uint32_t *words, size_t count, bool backup)
+  {
+    if(continuous_power_supply) {
+      for(size_t i = 0; i < count; ++i) {
+        mem_access_energy += CORTEX_M0PLUS_ENERGY_FLASH;
+      }
+      return;
+    }
+
+    if(battery.energy_stored() < calculate_backup_energy() && !thumbulator::active_machine().optimal_backup_policy) {
+      // nothing a failed store does changes the outcome for the next word
+      for(size_t i = 0; i < count; ++i) {
+        *active_simulation().out << " POWER OFF: Not enough energy to store data into RAM: address=0x" << std::hex << address + (i << 2) << std::endl;
+        words[i] = old_words[i];
+      }
+      power_off();
+      return;
+    }
+
+    if(!backup) {
+      for(size_t i = 0; i < count; ++i) {
+        mem_access_energy += CORTEX_M0PLUS_ENERGY_FLASH;
+      }
+    }
+  }
+
   double calculate_backup_energy()
   {
     uint32_t map_table_backup_words = 0;
@@ -825,41 +883,41 @@ private:
 
   size_t write_back(bool backup)
   {
-    auto count = 0;
+    auto const count = data_cache->get_num_dirty();
     num_map_table_backup_hits = 0;
 
-    for(size_t i=0; i<data_cache->get_numset(); i++) {
-      for(size_t j=0; j<data_cache->get_numway(); j++) {
-
-        thumbulator::cache_block blk = data_cache->get_block(i, j);
-
-        if(blk.get_valid() && blk.get_dirty()) {
-          auto write_addr = blk.get_address();
-		
-      	  if(mem_renamer) {
-      	    uint32_t index = 0;
-          	auto tag = blk.get_address() >> data_cache->get_block_offset();
-      	    if(mem_renamer->lookup_map_table(tag, index)) {
-              write_addr = mem_renamer->read_map_table(index);
-      	      num_map_table_backup_hits++;
-            }
-      	  }
-
-          for(uint32_t beat=0; beat<(DBLOCK_SIZE >> 2); beat++) {
-            if(backup && active) {
-              // std::cout << "write_back: addr=0x" << std::hex << (write_addr + (beat << 2)) 
-              //  	        << " data=0x" << data_cache->get_data(i, j, beat) << std::endl; 
-              thumbulator::store(write_addr + (beat << 2), data_cache->get_data(i, j, beat), true);
-            }
-          }
+    if(!mem_renamer && !(backup && active)) {
+      // only the number of dirty blocks is needed
+      return count;
+    }
 
-          if(backup && active) {
-            data_cache->mark_clean(i, j);
-          }
-          count++;
+    data_cache->for_each_dirty([&](size_t i, size_t j) {
+      auto const &blk = data_cache->get_block(i, j);
+      auto write_addr = blk.get_address();
+
+      if(mem_renamer) {
+        uint32_t index = 0;
+        auto tag = blk.get_address() >> data_cache->get_block_offset();
+        if(mem_renamer->lookup_map_table(tag, index)) {
+          write_addr = mem_renamer->read_map_table(index);
+          num_map_table_backup_hits++;
         }
       }
-    }
+
+      if(backup && active) {
+        // a store can power the system off, the rest of the backup is lost
+        for(uint32_t beat=0; beat<(DBLOCK_SIZE >> 2) && active; beat++) {
+          // std::cout << "write_back: addr=0x" << std::hex << (write_addr + (beat << 2))
+          //  	        << " data=0x" << data_cache->get_data(i, j, beat) << std::endl;
+          thumbulator::store(write_addr + (beat << 2), data_cache->get_data(i, j, beat), true);
+        }
+
+        // only a block written back in full is clean
+        if(active) {
+          data_cache->mark_clean(i, j);
+        }
+      }
+    });
 
     return count;
   }
@@ -872,7 +930,7 @@ private:
     auto need_renaming = true;
     auto num_mem_access = 3;
 
-    // if(thumbulator::icache_hit) {
+    // if(thumbulator::active_machine().icache_hit) {
     //   elapsed_cycles = 1;
     //   instruction_fetch_energy = MEM_RENAME_ICACHE_READ_ENERGY;
     // }
@@ -885,7 +943,7 @@ private:
     // insn_cycles = 1;
 
     // if(memop) { // store/load instruction
-      // if(thumbulator::dcache_hit) {
+      // if(thumbulator::active_machine().dcache_hit) {
       //   insn_cycles = num_mem_access * 1;
       //   if(memwr) 
       //     cache_energy_per_insn = num_mem_access * (MEM_RENAME_DCACHE_WRITE_ENERGY + 2 * LOCAL_BLOOMFILTER_ACCESS_ENERGY);
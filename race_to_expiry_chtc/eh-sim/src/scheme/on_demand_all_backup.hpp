@@ -36,7 +36,7 @@ public:
     stats->models.back().energy_for_instructions += NVP_INSTRUCTION_ENERGY;
   }
 
-  void calculate_backup_locs(bool use_reg_lva, const std::set<uint64_t> dead_regs) override
+  void calculate_backup_locs(bool use_reg_lva, uint16_t dead_regs) override
   {
   }
 
@@ -6,22 +6,33 @@
 #include "capacitor.hpp"
 #include "stats.hpp"
 
+#include <thumbulator/machine.hpp>
 #include <thumbulator/memory.hpp>
 
+#include <algorithm>
+
 namespace ehsim {
 
-class parametric : public eh_scheme {
+class parametric final : public eh_scheme {
 public:
+  /**
+   * The parameters that configurations of a sweep can differ in and still share a run.
+   */
+  struct parameters {
+    int backup_period;
+  };
+
   explicit parametric(int backup_period)
       : battery(MEMENTOS_CAPACITANCE, MEMENTOS_MAX_CAPACITOR_VOLTAGE, MEMENTOS_MAX_CURRENT)
       , BACKUP_PERIOD(backup_period)
       , countdown_to_backup(BACKUP_PERIOD)
   {
-    thumbulator::ram_load_hook = [this](
-        uint32_t address, uint32_t data) -> uint32_t { return this->process_read(address, data); };
-
-    thumbulator::ram_store_hook = [this](uint32_t address, uint32_t last_value,
-        uint32_t value, bool wb) -> uint32_t { return this->process_store(address, last_value, value); };
+    // hooks go into the machine of the simulation this scheme is created for
+    auto &machine = thumbulator::active_machine();
+    machine.ram_load_hook =
+        thumbulator::ram_load_function::bind<parametric, &parametric::process_read>(this);
+    machine.ram_store_hook =
+        thumbulator::ram_store_function::bind<parametric, &parametric::process_store>(this);
   }
 
   capacitor &get_battery() override
@@ -48,7 +59,7 @@ public:
     last_tick = stats->cpu.cycle_count;
   }
 
-  void calculate_backup_locs(bool use_reg_lva, const std::set<uint64_t> dead_regs) override
+  void calculate_backup_locs(bool use_reg_lva, uint16_t dead_regs) override
   {
   }
 
@@ -94,7 +105,7 @@ public:
     // reset countdown
     countdown_to_backup = BACKUP_PERIOD;
     // save architectural state
-    architectural_state = thumbulator::cpu;
+    architectural_state = thumbulator::active_machine().cpu;
     // save application state
     auto const num_stores = write_back();
 
@@ -111,7 +122,7 @@ public:
 
     // restore saved architectural state
     thumbulator::cpu_reset();
-    thumbulator::cpu = architectural_state;
+    thumbulator::active_machine().cpu = architectural_state;
 
     stats->models.back().energy_for_restore = CLANK_RESTORE_ENERGY;
     battery.consume_energy(CLANK_RESTORE_ENERGY);
@@ -152,6 +163,32 @@ public:
   bool optimal_backup_scheme(uint64_t curr_insn_cycle, uint32_t address, size_t set, size_t way, bool memwr, bool memop, bool branch, bool branch_link, uint32_t num_mem_access) override
   { return false; }
 
+  /**
+   * Whether a run with other parameters from the same state can decide differently from this one
+   * before the next instruction completes.
+   *
+   * Call it after an instruction, before the backup decision.
+   */
+  bool diverges(parameters const &other) const
+  {
+    // backups and restores restart both countdowns, so they stay apart by the difference of periods
+    auto const other_countdown = countdown_to_backup + other.backup_period - BACKUP_PERIOD;
+
+    return other.backup_period != BACKUP_PERIOD
+           && std::min(countdown_to_backup, other_countdown) <= 0;
+  }
+
+  /**
+   * Continue the run as if it had used other parameters from the start.
+   *
+   * Only valid while the runs have not diverged, see diverges.
+   */
+  void retarget(parameters const &other)
+  {
+    countdown_to_backup += other.backup_period - BACKUP_PERIOD;
+    BACKUP_PERIOD = other.backup_period;
+  }
+
 private:
   capacitor battery;
   bool active = false;
@@ -159,7 +196,8 @@ private:
   uint64_t last_backup_cycle = 0u;
   uint64_t last_tick = 0u;
 
-  int const BACKUP_PERIOD;
+  // set once, or by retarget
+  int BACKUP_PERIOD;
   int countdown_to_backup;
 
   thumbulator::cpu_state architectural_state{};
@@ -186,7 +224,7 @@ private:
     auto const count = stores.size();
 
     for(auto const &store : stores) {
-      thumbulator::RAM[(store.first & RAM_ADDRESS_MASK) >> 2] = store.second;
+      thumbulator::active_machine().ram.write((store.first & RAM_ADDRESS_MASK) >> 2, store.second);
     }
     stores.clear();
 
@@ -203,7 +241,7 @@ private:
     return value;
   }
 
-  uint32_t process_store(uint32_t address, uint32_t old_value, uint32_t value)
+  uint32_t process_store(uint32_t address, uint32_t old_value, uint32_t value, bool)
   {
     auto it = stores.find(address);
     if(it != stores.end()) {
@@ -1,70 +1,56 @@
 #include "simulate.hpp"
 
 #include <thumbulator/cpu.hpp>
+#include <thumbulator/machine.hpp>
 #include <thumbulator/memory.hpp>
 #include <thumbulator/cache.hpp>
+#include <thumbulator/execution_trace.hpp>
+#include <thumbulator/instrumentation.hpp>
+#include <thumbulator/program.hpp>
 
+#include "scheme/backup_every_cycle.hpp"
+#include "scheme/clank.hpp"
 #include "scheme/eh_scheme.hpp"
+#include "scheme/mem_rename.hpp"
+#include "scheme/parametric.hpp"
 #include "capacitor.hpp"
+#include "simulation.hpp"
 #include "stats.hpp"
 #include "voltage_trace.hpp"
 #include "liveness_trace.hpp"
+#include "profiler.hpp"
+#include "static_liveness.hpp"
 
-#include <torch/script.h>
+#include "spendthrift_model.hpp"
+
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 
-
-#define MEAN_0 2.1731910037760214
-#define MEAN_1 76325.01716411403
-#define SD_0   1.1933448413265264
-#define SD_1   91963.38072192093
-
-
-//#define MEAN_0 2.617074395841535
-//#define MEAN_1 67213.58046138467
-//#define SD_0   1.3330418578555099
-//#define SD_1   89587.96387189817
-
-//#define MEAN_0 1.2287316313547834 //2.617074395841535
-//#define MEAN_1 76271.89987944828 //67213.58046138467
-//#define SD_0   1.3531843045335201 //1.3330418578555099
-//#define SD_1   91905.93661451967 //89587.96387189817
-
 namespace ehsim {
 
+using thumbulator::instrumentation::stage;
+using thumbulator::instrumentation::timed;
 
-// stats tracking
-stats_bundle stats{};
-double gl_env_volt = 0;
-double gl_batt_energy = 0;
-torch::jit::script::Module module;
+thread_local simulation *current_simulation = nullptr;
 
 int spendthrift_backup(int print)
 {
-    float array[2]; //1.5050, 277.0000};
+    thumbulator::instrumentation::scoped_timer timer(stage::inference);
+    auto &active = active_simulation();
+    auto const env_voltage = active.env_voltage;
+    auto const battery_energy = active.battery_energy;
     int b_nb = 0;
 
-    array[0] = (float)((gl_env_volt - MEAN_0)/SD_0);
-    array[1] = (float) ((gl_batt_energy - MEAN_1)/SD_1);
-
-
-    torch::Tensor tensor_in = torch::from_blob(array, {1, 2});
-    std::vector<torch::jit::IValue> inputs;
-    inputs.push_back(tensor_in);
-
-
-    // Execute the model and turn its output into a tensor.
-    at::Tensor output = module.forward(inputs).toTensor();
-    //std::cout << output.item<float>() << std::endl;
-    if(output.item<float>() >= 0.5 )
+    if(active.spendthrift->will_backup(env_voltage, battery_energy))
     {
         b_nb = 1;
     }
 
-     if(print && (gl_batt_energy < 1300))
+     if(print && (battery_energy < 1300))
     {
-        std::cout << gl_env_volt <<"   " << gl_batt_energy<<"   " << b_nb << "spendthrift : " << output.item<float>()<< std::endl;
+        auto const output = active.spendthrift->forward(env_voltage, battery_energy);
+        *active.out << env_voltage <<"   " << battery_energy<<"   " << b_nb << "spendthrift : " << output<< std::endl;
     }
 
     return b_nb;
@@ -72,27 +58,13 @@ int spendthrift_backup(int print)
 
 double get_env_voltage(void)
 {
-    return gl_env_volt;
+    return active_simulation().env_voltage;
 }
 
-void load_program(char const *file_name)
+void initialize_system(eh_scheme* scheme, thumbulator::program_image const &program)
 {
-  std::FILE *fd = std::fopen(file_name, "r");
-  if(fd == nullptr) {
-    throw std::runtime_error("Could not open binary file.\n");
-  }
-
-  std::fread(&thumbulator::FLASH_MEMORY, sizeof(uint32_t),
-      sizeof(thumbulator::FLASH_MEMORY) / sizeof(uint32_t), fd);
-  std::fclose(fd);
-}
-
-void initialize_system(eh_scheme* scheme, char const *binary_file)
-{
-  // Reset memory, then load program to memory
-  std::memset(thumbulator::RAM, 0, sizeof(thumbulator::RAM));
-  std::memset(thumbulator::FLASH_MEMORY, 0, sizeof(thumbulator::FLASH_MEMORY));
-  load_program(binary_file);
+  // Memory of a new machine is already zeroed, load program to memory
+  thumbulator::install_program(thumbulator::active_machine(), program);
 
   // Initialize CPU state
   thumbulator::cpu_reset();
@@ -102,38 +74,84 @@ void initialize_system(eh_scheme* scheme, char const *binary_file)
 }
 
 /**
- * Execute one instruction.
+ * Replay the data accesses of a recorded instruction and mark the registers it wrote.
+ *
+ * The accesses go through the memory system as they did when recording, so the caches and the
+ * scheme hooks see the same stream. Register values are not reproduced.
+ *
+ * @return Number of cycles the execute stage took to execute that instruction.
+ */
+uint32_t replay_instruction(thumbulator::trace_record const &record)
+{
+  thumbulator::instrumentation::scoped_timer timer(stage::execute);
+  for(auto const &access : record.accesses) {
+    if(access.type == thumbulator::trace_access::store) {
+      thumbulator::store(access.address, access.value);
+    } else {
+      uint32_t value;
+      thumbulator::load(access.address, &value, access.type == thumbulator::trace_access::false_load);
+    }
+  }
+
+  auto &cpu = thumbulator::active_machine().cpu;
+  for(int i = 0; i < 16; ++i) {
+    if((record.registers_written & (1u << i)) != 0) {
+      cpu.gpr[i][1] = 1;
+    }
+  }
+
+  return record.cycles;
+}
+
+/**
+ * Execute one instruction, or replay the next recorded instruction.
+ *
+ * @param replay The recorded execution to replay, nullptr to emulate the instruction.
  *
  * @return Number of cycles to execute that instruction.
  */
-uint32_t step_cpu(stats_bundle *stats, eh_scheme* scheme, uint64_t active_start, uint64_t& elapsed_cycles, bool& was_backup)
+template <typename Scheme>
+uint32_t step_cpu(stats_bundle *stats, Scheme* scheme, uint64_t active_start, uint64_t& elapsed_cycles, bool& was_backup, thumbulator::trace_reader *replay)
 {
-  thumbulator::BRANCH_WAS_TAKEN = false;
+  auto &machine = thumbulator::active_machine();
+  machine.branch_was_taken = false;
 
   if((thumbulator::cpu_get_pc() & 0x1) == 0) {
-    printf("Oh no! Current PC: 0x%08X\n", thumbulator::cpu.gpr[15][0]);
+    printf("Oh no! Current PC: 0x%08X\n", machine.cpu.gpr[15][0]);
     throw std::runtime_error("PC moved out of thumb mode.");
   }
 
-  // fetch
-  uint16_t instruction;
-  thumbulator::fetch_instruction(thumbulator::cpu_get_pc() - 0x4, &instruction);
-  // decode
+  // fetch and decode
   // std::cout << "Cycle " << stats->cpu.cycle_count << std::endl;
-  auto const decoded = thumbulator::decode(instruction);
+  thumbulator::predecoded_instruction const *predecoded = nullptr;
+  thumbulator::trace_record const *record = nullptr;
+  if(replay != nullptr) {
+    record = &replay->next();
+    thumbulator::fetch_replayed(record->pc, record->instruction);
+  } else {
+    predecoded = &thumbulator::fetch_predecoded(thumbulator::cpu_get_pc() - 0x4);
+  }
 
-  if(thumbulator::dcache && thumbulator::OPTIMAL_BACKUP_POLICY) {
+  if(machine.dcache && machine.optimal_backup_policy) {
     // scheme = memory renaming and optimal backup policy = ON --> mock execute, memory and write-back
-    bool is_memwr = false;
-    bool is_memop = false;
-    bool is_branch = false;
-    bool is_branch_link = false;
-    thumbulator::mock_exmemwb = true;
-    uint32_t num_mem_access = 0; // only for multiple load and store instructions like ldm/stm
-    uint32_t address = thumbulator::exmemwb_mock(instruction, &decoded, is_memwr, is_memop, is_branch, is_branch_link, num_mem_access);
+    uint32_t address;
+    if(record != nullptr) {
+      address = record->probe_address;
+    } else {
+      bool is_memwr = false;
+      bool is_memop = false;
+      bool is_branch = false;
+      bool is_branch_link = false;
+      machine.mock_exmemwb = true;
+      uint32_t num_mem_access = 0; // only for multiple load and store instructions like ldm/stm
+      address = timed(stage::execute, [&]() {
+        return thumbulator::exmemwb_mock(predecoded->instruction, &predecoded->decoded, is_memwr,
+            is_memop, is_branch, is_branch_link, num_mem_access);
+      });
+    }
 
     thumbulator::cache_attributes attr;
-    thumbulator::dcache_hit = thumbulator::dcache->is_hit(address, attr);
+    machine.dcache_hit = timed(stage::cache, [&]() { return machine.dcache->is_hit(address, attr); });
 
 //    if(scheme->optimal_backup_scheme((stats->cpu.cycle_count - active_start), address, attr.set, attr.way, is_memwr, is_memop, is_branch, is_branch_link, num_mem_access)) 
     
@@ -141,34 +159,41 @@ uint32_t step_cpu(stats_bundle *stats, eh_scheme* scheme, uint64_t active_start,
     {
 
       //std::cout << "Cycle " << std::dec << stats->cpu.cycle_count << ": backup (optimal backup scheme)" << std::endl;
-      std::cout << "Cycle " << std::dec << stats->cpu.cycle_count << ": backup (Spendthrift backup scheme): " <<gl_env_volt<< "   "<< gl_batt_energy<<std::endl;
-      auto const backup_time = scheme->backup(stats);
+      *active_simulation().out << "Cycle " << std::dec << stats->cpu.cycle_count << ": backup (Spendthrift backup scheme): " <<active_simulation().env_voltage<< "   "<< active_simulation().battery_energy<<std::endl;
+      auto const backup_time = timed(stage::scheme, [&]() { return scheme->backup(stats); });
 
 
       elapsed_cycles += backup_time;
 
       auto &active_stats = stats->models.back();
-      thumbulator::dcache_hit = false;
+      machine.dcache_hit = false;
       active_stats.time_for_backups += backup_time;
       active_stats.energy_forward_progress = active_stats.energy_for_instructions;
       active_stats.time_forward_progress = stats->cpu.cycle_count - active_start;
       was_backup = true;
     }
 
-    thumbulator::mock_exmemwb = false;
+    machine.mock_exmemwb = false;
   }
 
   // execute, memory, and write-back
-  uint32_t instruction_ticks = thumbulator::exmemwb(instruction, &decoded);
-  if(!thumbulator::icache_hit) {
-    instruction_ticks += ((thumbulator::dcache->get_block_size() >> 2) + 1);
+  uint32_t instruction_ticks =
+      record != nullptr ? replay_instruction(*record) : thumbulator::exmemwb(*predecoded);
+  if(!machine.icache_hit) {
+    instruction_ticks += ((machine.dcache->get_block_size() >> 2) + 1);
   }
   else {
     instruction_ticks++;
   }
 
   // advance to next PC
-  if(!thumbulator::BRANCH_WAS_TAKEN) {
+  if(replay != nullptr) {
+    if(replay->at_end()) {
+      machine.exit_instruction_encountered = true;
+    } else {
+      thumbulator::cpu_set_pc(replay->peek_pc() + 0x4);
+    }
+  } else if(!machine.branch_was_taken) {
     thumbulator::cpu_set_pc(thumbulator::cpu_get_pc() + 0x2);
   } else {
     thumbulator::cpu_set_pc(thumbulator::cpu_get_pc() + 0x4);
@@ -177,6 +202,29 @@ uint32_t step_cpu(stats_bundle *stats, eh_scheme* scheme, uint64_t active_start,
   return instruction_ticks;
 }
 
+#ifdef EH_SIM_PROFILER
+/**
+ * The counters the cost of an instruction is profiled by, taken before and after it.
+ */
+struct profile_counters {
+  uint32_t address;
+  double energy;
+  uint64_t icache_misses;
+  uint64_t dcache_misses;
+
+  static profile_counters take(stats_bundle const &stats)
+  {
+    auto &machine = thumbulator::active_machine();
+    auto const &active_period = stats.models.back();
+
+    return {thumbulator::cpu_get_pc() - 0x4,
+        active_period.energy_for_instructions + active_period.energy_for_backups,
+        machine.icache ? machine.icache->get_num_misses() : 0,
+        machine.dcache ? machine.dcache->get_num_misses() : 0};
+  }
+};
+#endif
+
 std::chrono::nanoseconds get_time(uint64_t const cycle_count, uint32_t const frequency)
 {
   double const CPU_PERIOD = 1.0 / frequency;
@@ -225,6 +273,8 @@ double update_energy_harvested(uint64_t elapsed_cycles,
     ehsim::voltage_trace const &power,
     capacitor &battery)
 {
+  thumbulator::instrumentation::scoped_timer timer(stage::energy);
+
   // execution can span over more than 1 voltage trace sample period
   // accumulate charge of each periods separately
   auto potential_harvested_energy = 0.0;
@@ -250,20 +300,112 @@ double update_energy_harvested(uint64_t elapsed_cycles,
   return actual_harvested_energy;
 }
 
-stats_bundle simulate(char const *binary_file,
+/**
+ * Charge the capacitor over whole voltage samples in one step while the system is off.
+ *
+ * Energy harvested over a sample is linear in the sample voltage, so the energy harvested over any
+ * run of samples follows from prefix sums of the trace, and the number of samples to skip is found
+ * by binary search instead of iterating the off period one sample at a time.
+ *
+ * Must be called at a sample boundary, i.e. when next_charge_time is one period away.
+ *
+ * @param energy_limit The capacitor stays below this energy (nJ) over the skipped samples.
+ *
+ * @return The energy harvested in nJ.
+ */
+double skip_charging_samples(double energy_limit,
+    std::chrono::nanoseconds &time,
+    double &charging_rate,
+    double &env_voltage,
+    std::chrono::nanoseconds &next_charge_time,
+    uint32_t clock_freq,
+    ehsim::voltage_trace const &power,
+    capacitor &battery)
+{
+  thumbulator::instrumentation::scoped_timer timer(stage::energy);
+
+  auto const energy = battery.energy_stored();
+  if(energy >= energy_limit) {
+    return 0.0;
+  }
+
+  // energy harvested per sample and volt, see calculate_charging_rate
+  auto const cycles_per_sample = time_to_cycles(power.sample_period(), clock_freq);
+  auto const energy_per_volt = cycles_per_sample * calculate_charging_rate(1.0, battery, clock_freq);
+
+  // the current sample charges with env_voltage, which is not the sample at next_charge_time
+  // before the first step, and the next ones with the samples after it, see update_energy_harvested
+  auto const current_voltage = env_voltage;
+  auto const next_sample = power.sample_index(to_milliseconds(next_charge_time)) + 1;
+  auto const harvested = [&](uint64_t samples) {
+    return energy_per_volt * (current_voltage + power.sum_voltages(next_sample, samples - 1));
+  };
+
+  // bound the search by enough passes over the trace to reach the limit
+  auto const energy_per_pass = harvested(power.num_samples());
+  uint64_t high = power.num_samples();
+  if(energy_per_pass > 0) {
+    // a weaker source is left to the next call rather than overflowing the bound
+    auto const passes = std::min((energy_limit - energy) / energy_per_pass + 1, 1e6);
+    high *= static_cast<uint64_t>(passes);
+  }
+
+  // find the most samples that keep the capacitor below the limit
+  uint64_t low = 0;
+  while(low < high) {
+    auto const middle = low + (high - low + 1) / 2;
+    if(energy + harvested(middle) < energy_limit) {
+      low = middle;
+    } else {
+      high = middle - 1;
+    }
+  }
+
+  if(low == 0) {
+    return 0.0;
+  }
+
+  time += low * power.sample_period();
+  next_charge_time += low * power.sample_period();
+  env_voltage = power.get_voltage(to_milliseconds(next_charge_time));
+  charging_rate = calculate_charging_rate(env_voltage, battery, clock_freq);
+
+  return battery.harvest_energy(harvested(low));
+}
+
+template <typename Scheme>
+stats_bundle simulate(thumbulator::program_image const &program,
     ehsim::voltage_trace const &power,
     bool const use_reg_lva,
     ehsim::liveness_trace const &reg_liveness,
+    ehsim::static_liveness const *static_reg_liveness,
     bool const use_mem_lva,
     ehsim::liveness_trace const &mem_liveness,
-    eh_scheme *scheme,
-    bool always_harvest)
+    Scheme *scheme,
+    spendthrift_model &model,
+    bool always_harvest,
+    thumbulator::trace_reader *replay)
 {
   // using namespace std::chrono_literals;
 
+  auto &active = active_simulation();
+  auto &machine = active.machine;
+  auto &stats = active.stats;
+  auto &out = *active.out;
+
   stats.system.time = std::chrono::nanoseconds(0);
 
-  initialize_system(scheme, binary_file);
+  initialize_system(scheme, program);
+
+  // the trace position execution resumes from after a power failure
+  thumbulator::trace_reader::position checkpoint{};
+  if(replay != nullptr) {
+    if(replay->at_end()) {
+      throw std::runtime_error("The execution trace has no instructions.");
+    }
+    checkpoint = replay->tell();
+    thumbulator::cpu_set_pc(replay->peek_pc() + 0x4);
+  }
 
   // energy harvesting
   auto &battery = scheme->get_battery();
@@ -274,7 +416,7 @@ stats_bundle simulate(char const *binary_file,
   auto cycles_per_sample = static_cast<uint64_t>(
       scheme->clock_frequency() * std::chrono::duration<double>(power.sample_period()).count());
 
-  std::cout.setf(std::ios::unitbuf);
+  out.setf(std::ios::unitbuf);
   //std::cout << "cycles per sample: " << cycles_per_sample << "\n";
 
   // get voltage based current time (includes active+sleep) -- this should be @ time 0
@@ -285,10 +427,12 @@ stats_bundle simulate(char const *binary_file,
   //std::cout << "next_charge_time: " << next_charge_time.count() << "ns\n";
 
   /* ABSO edit */
-  gl_env_volt = env_voltage;
-  gl_batt_energy = battery.energy_stored();
+  active.env_voltage = env_voltage;
+  active.battery_energy = battery.energy_stored();
   uint64_t active_start = 0u;
   int no_progress_counter = 0;
+  // end of the trace sample active.env_voltage was read from
+  auto sample_end_time = std::chrono::nanoseconds(0);
 
   // was there a backup previous iteration
   auto was_backup = false;
@@ -304,22 +448,41 @@ stats_bundle simulate(char const *binary_file,
     char buff[120];
 
     getcwd(buff, 120);
-    std::cout<<"Working dir : " << buff << std::endl;
+    out<<"Working dir : " << buff << std::endl;
+
+    active.spendthrift = &model;
+
+  // traces are queried at increasing cycles
+  liveness_cursor reg_liveness_cursor(reg_liveness);
+  liveness_cursor mem_liveness_cursor(mem_liveness);
+  auto const get_dead_registers = [&]() -> uint16_t {
+    thumbulator::instrumentation::scoped_timer timer(stage::liveness);
+    if(static_reg_liveness != nullptr) {
+      // the registers dead before the next instruction
+      return static_reg_liveness->get_register_liveness(thumbulator::cpu_get_pc() - 0x4);
+    }
+
+    return reg_liveness_cursor.get_register_liveness(stats.cpu.cycle_count);
+  };
 
-    module = torch::jit::load("traced_spendthrift_model_updated.pt");
+  // a run shared by sweep configurations splits before any of them can decide differently
+  auto shared = static_cast<bool>(active.split);
+  if(shared) {
+    shared = !active.split(false);
+  }
 
-  while(!thumbulator::EXIT_INSTRUCTION_ENCOUNTERED && stats.cpu.instruction_count_forward_progress < 10000000) {
+  while(!machine.exit_instruction_encountered && stats.cpu.instruction_count_forward_progress < 10000000) {
     uint64_t elapsed_cycles = 0;
-    std::set<uint64_t> dead_regs{};
+    uint16_t dead_regs = 0;
 
     if(use_mem_lva) {
-      auto const dead_mem_addrs = mem_liveness.get_liveness(stats.cpu.cycle_count);
+      auto const &dead_mem_addrs = mem_liveness_cursor.get_liveness(stats.cpu.cycle_count);
       if(!dead_mem_addrs.empty())
         scheme->set_dead_addresses(dead_mem_addrs);
     }
 
     if(use_reg_lva)
-      dead_regs = reg_liveness.get_liveness(stats.cpu.cycle_count);
+      dead_regs = get_dead_registers();
     // std::cout << "cycle: " << std::dec << stats.cpu.cycle_count << " number of dead regs: " << std::dec << dead_regs.size() << std::endl;
     // for(auto it=dead_regs.begin(); it !=dead_regs.end(); it++) {
     //   std::cout << *it << " ";
@@ -328,9 +491,9 @@ stats_bundle simulate(char const *binary_file,
     //   std::cout << std::endl;
     // }
 
-    scheme->calculate_backup_locs(use_reg_lva, dead_regs);
+    timed(stage::scheme, [&]() { scheme->calculate_backup_locs(use_reg_lva, dead_regs); });
 
-    if(scheme->is_active(&stats)) {
+    if(timed(stage::scheme, [&]() { return scheme->is_active(&stats); })) {
       if(!was_active) {
         //std::cout << "["
         //          << std::chrono::duration_cast<std::chrono::nanoseconds>(stats.system.time).count()
@@ -344,10 +507,22 @@ stats_bundle simulate(char const *binary_file,
 
         if(stats.cpu.instruction_count != 0) {
           // restore state
-          auto const restore_time = scheme->restore(&stats);
+          auto const restore_time = timed(stage::scheme, [&]() { return scheme->restore(&stats); });
           elapsed_cycles += restore_time;
 
           stats.models.back().time_for_restores += restore_time;
+
+#ifdef EH_SIM_PROFILER
+          if(active.profile != nullptr) {
+            active.profile->restore();
+          }
+#endif
+        }
+
+        if(replay != nullptr) {
+          // re-execute the instructions lost since the last backup
+          replay->seek(checkpoint);
+          thumbulator::cpu_set_pc(replay->peek_pc() + 0x4);
         }
       }
 
@@ -359,18 +534,39 @@ stats_bundle simulate(char const *binary_file,
       stats.cpu.was_mr_backup = false;
       stats.cpu.mr_backup_time = 0;
 
-      scheme->reset_stats();
+      timed(stage::scheme, [&]() { scheme->reset_stats(); });
 
-      thumbulator::icache_hit = false;
+      machine.icache_hit = false;
 
       if((stats.cpu.instruction_count_forward_progress % 100000) == 0) {
-      	std::cout << "Cycle " << stats.cpu.cycle_count << ": instructions towards forward progress=" << std::dec << stats.cpu.instruction_count_forward_progress << std::endl;
+      	out << "Cycle " << stats.cpu.cycle_count << ": instructions towards forward progress=" << std::dec << stats.cpu.instruction_count_forward_progress << std::endl;
       }
 
-      gl_env_volt = power.get_voltage(to_milliseconds(stats.system.time));
-      gl_batt_energy = battery.energy_stored();
+      if(stats.system.time >= sample_end_time) {
+        // the source voltage only changes when time crosses into the next trace sample
+        active.env_voltage = power.get_voltage(to_milliseconds(stats.system.time));
+        sample_end_time = (stats.system.time / power.sample_period() + 1) * power.sample_period();
+      }
+      active.battery_energy = battery.energy_stored();
 
-      auto const instruction_ticks = step_cpu(&stats, scheme, active_start, elapsed_cycles, was_backup);
+      auto const replay_position =
+          replay != nullptr ? replay->tell() : thumbulator::trace_reader::position{};
+#ifdef EH_SIM_PROFILER
+      auto const profiled =
+          active.profile != nullptr ? profile_counters::take(stats) : profile_counters{};
+#endif
+      auto const instruction_ticks =
+          step_cpu(&stats, scheme, active_start, elapsed_cycles, was_backup, replay);
+#ifdef EH_SIM_PROFILER
+      if(active.profile != nullptr && (was_backup || stats.cpu.was_mr_backup)) {
+        // a full map table asks for the backup, the spendthrift policy does not
+        active.profile->backup(profiled.address, stats.cpu.was_mr_backup);
+      }
+#endif
+      if(replay != nullptr && (was_backup || stats.cpu.was_mr_backup)) {
+        // backed up before the instruction completed, a restore executes it again
+        checkpoint = replay_position;
+      }
 
       if(stats.cpu.was_mr_backup) {
         elapsed_cycles += stats.cpu.mr_backup_time;
@@ -388,12 +584,12 @@ stats_bundle simulate(char const *binary_file,
       elapsed_cycles += instruction_ticks;
 
       // consume energy for execution
-      scheme->execute_instruction(&stats);
+      timed(stage::energy, [&]() { scheme->execute_instruction(&stats); });
 
       //uint64_t num_dead_addrs = 0;
 
       if(use_mem_lva) {
-        auto const dead_mem_addrs = mem_liveness.get_liveness(stats.cpu.cycle_count);
+        auto const &dead_mem_addrs = mem_liveness_cursor.get_liveness(stats.cpu.cycle_count);
         // num_dead_addrs = dead_mem_addrs.size();
         if(!dead_mem_addrs.empty())
           scheme->set_dead_addresses(dead_mem_addrs);
@@ -401,18 +597,18 @@ stats_bundle simulate(char const *binary_file,
 
       uint32_t num_dead_dirty_regs = 0;
       if(use_reg_lva) {
-        dead_regs = reg_liveness.get_liveness(stats.cpu.cycle_count);
+        dead_regs = get_dead_registers();
         // std::cout << "Cycle " << stats.cpu.cycle_count << ": (dead_dirty)";
-        for(auto it=dead_regs.begin(); it!=dead_regs.end(); it++) {
-          if(thumbulator::cpu_get_gpr_dbit(*it)) {
+        for(uint8_t reg = 0; reg < 16; reg++) {
+          if((dead_regs & (1u << reg)) != 0 && thumbulator::cpu_get_gpr_dbit(reg)) {
             num_dead_dirty_regs++;
-            // std::cout << " " << *it;
+            // std::cout << " " << reg;
           }
         }
         //std::cout << std::endl;
       }
 
-      scheme->calculate_backup_locs(use_reg_lva, dead_regs);
+      timed(stage::scheme, [&]() { scheme->calculate_backup_locs(use_reg_lva, dead_regs); });
 
       // auto num_dirty_mem_addrs = scheme->get_wb_buffer_size();
       uint32_t num_dirty_regs = 0;
@@ -436,22 +632,26 @@ stats_bundle simulate(char const *binary_file,
       assert(num_dirty_bytes >= 0);
       assert(num_dirty_live_bytes <= num_dirty_bytes);
 
-      int clank_b = scheme->will_backup(&stats);
+      if(shared) {
+        shared = !active.split(false);
+      }
+
+      int clank_b = timed(stage::scheme, [&]() { return scheme->will_backup(&stats); });
 
       int spendthrift_b = 0;
-      if(!(thumbulator::OPTIMAL_BACKUP_POLICY))
+      if(!(machine.optimal_backup_policy))
            spendthrift_b = spendthrift_backup(0);
 
       if(clank_b || spendthrift_b) 
       {
         if(clank_b)
-            std::cout << "Cycle " << stats.cpu.cycle_count << ": clank backup(Will Backup)" << std::endl;
+            out << "Cycle " << stats.cpu.cycle_count << ": clank backup(Will Backup)" << std::endl;
         else if(spendthrift_b)
-            std::cout << "Cycle " << stats.cpu.cycle_count << ": spendthrift backup(Will Backup)" << std::endl;
+            out << "Cycle " << stats.cpu.cycle_count << ": spendthrift backup(Will Backup)" << std::endl;
 
         auto num_backup_insn = stats.cpu.end_backup_insn - start_backup_insn;
         // std::cout << "backup: num_backup_insn=" << std::dec << num_backup_insn << std::endl;
-        auto const backup_time = scheme->backup(&stats);
+        auto const backup_time = timed(stage::scheme, [&]() { return scheme->backup(&stats); });
         elapsed_cycles += backup_time;
 
         auto &active_stats = stats.models.back();
@@ -459,14 +659,38 @@ stats_bundle simulate(char const *binary_file,
         active_stats.energy_forward_progress = active_stats.energy_for_instructions;
         active_stats.time_forward_progress = stats.cpu.cycle_count - active_start;
         was_backup = true;
+
+        if(replay != nullptr) {
+          checkpoint = replay->tell();
+        }
       }
 
+#ifdef EH_SIM_PROFILER
+      if(active.profile != nullptr) {
+        auto const after = profile_counters::take(stats);
+        active.profile->execute(profiled.address, after.address, elapsed_cycles,
+            after.energy - profiled.energy, after.icache_misses - profiled.icache_misses,
+            after.dcache_misses - profiled.dcache_misses);
+        if(clank_b || spendthrift_b) {
+          active.profile->backup(profiled.address, clank_b);
+        }
+      }
+#endif
+
       stats.system.time += get_time(elapsed_cycles, scheme->clock_frequency());
 
       if(always_harvest) {
-        // update energy harvested & voltage sample corresponding to current time
-        auto harvested_energy = update_energy_harvested(elapsed_cycles, stats.system.time, charging_rate, env_voltage,
-                next_charge_time, scheme->clock_frequency(), power, battery);
+        double harvested_energy;
+        if(stats.system.time < next_charge_time) {
+          // the charging rate is constant until the next voltage sample
+          harvested_energy = timed(
+              stage::energy, [&]() { return battery.harvest_energy(elapsed_cycles * charging_rate); });
+        } else {
+          // update energy harvested & voltage sample corresponding to current time
+          harvested_energy = update_energy_harvested(elapsed_cycles, stats.system.time,
+              charging_rate, env_voltage, next_charge_time, scheme->clock_frequency(), power,
+              battery);
+        }
         stats.system.energy_harvested += harvested_energy;
         stats.models.back().energy_charged += harvested_energy;
       } else {
@@ -478,11 +702,13 @@ stats_bundle simulate(char const *binary_file,
 
           env_voltage = power.get_voltage(to_milliseconds(stats.system.time));
           /* ABSO edit */
-          gl_env_volt = env_voltage;
+          active.env_voltage = env_voltage;
           charging_rate = calculate_charging_rate(env_voltage, battery, scheme->clock_frequency());
         }
       }
     } else { // powered off
+      thumbulator::instrumentation::scoped_timer charging(stage::energy);
+
       if(was_active) {
         //std::cout << std::chrono::duration_cast<std::chrono::nanoseconds>(stats.system.time).count()
         //          << "ns]\n";
@@ -514,6 +740,23 @@ stats_bundle simulate(char const *binary_file,
       // assume linear max dV/dt for now
       double const max_dV_dt = battery.max_current() / battery.capacitance();
       double const dV_dt_per_cycle = max_dV_dt / scheme->clock_frequency();
+
+      if(stats.system.time + power.sample_period() == next_charge_time) {
+        // skip the samples over which the system can neither power on nor finish charging within
+        // one sample, so the step below would charge for exactly one sample each
+        auto const cycles_per_sample =
+            time_to_cycles(power.sample_period(), scheme->clock_frequency());
+        auto const last_full_sample_voltage = min_voltage - cycles_per_sample * dV_dt_per_cycle;
+        if(last_full_sample_voltage > 0) {
+          auto const energy_limit = std::min(
+              min_energy, calculate_energy(last_full_sample_voltage, battery.capacitance()));
+          auto const harvested_energy = skip_charging_samples(energy_limit, stats.system.time,
+              charging_rate, env_voltage, next_charge_time, scheme->clock_frequency(), power,
+              battery);
+          stats.system.energy_harvested += harvested_energy;
+        }
+      }
+
       auto const min_cycles =
       static_cast<uint64_t>(ceil((min_voltage - battery.voltage()) / dV_dt_per_cycle));
 
@@ -537,7 +780,10 @@ stats_bundle simulate(char const *binary_file,
       stats.system.energy_harvested += harvested_energy;
     }
   }
-  std::cout << "done\n";
+  if(shared) {
+    active.split(true);
+  }
+  out << "done\n";
 
   // scheme->print_map_table();
 
@@ -565,4 +811,16 @@ stats_bundle simulate(char const *binary_file,
 
   return stats;
 }
+
+#define INSTANTIATE_SIMULATE(Scheme)                                                               \
+  template stats_bundle simulate<Scheme>(thumbulator::program_image const &,                       \
+      ehsim::voltage_trace const &, bool const, ehsim::liveness_trace const &,                     \
+      ehsim::static_liveness const *, bool const, ehsim::liveness_trace const &, Scheme *,         \
+      spendthrift_model &, bool, thumbulator::trace_reader *);
+
+INSTANTIATE_SIMULATE(eh_scheme)
+INSTANTIATE_SIMULATE(backup_every_cycle)
+INSTANTIATE_SIMULATE(clank)
+INSTANTIATE_SIMULATE(mem_rename)
+INSTANTIATE_SIMULATE(parametric)
 }
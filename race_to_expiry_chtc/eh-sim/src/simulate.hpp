@@ -4,31 +4,54 @@
 #include <chrono>
 #include <cstdint>
 
+namespace thumbulator {
+struct program_image;
+class trace_reader;
+}
+
 namespace ehsim {
 
 class eh_scheme;
 struct stats_bundle;
 class voltage_trace;
 class liveness_trace;
+class static_liveness;
+class spendthrift_model;
 
 /**
  * Simulate an energy harvesting device.
  *
- * @param binary_file The path to the application binary file.
+ * Runs on the simulation that is active on the calling thread, see simulation_scope.
+ *
+ * The loop is instantiated for each concrete scheme, which are final, so the scheme calls made for
+ * every instruction are bound at compile time. The eh_scheme instantiation dispatches virtually.
+ *
+ * @param program The application, see thumbulator::load_program.
  * @param power The power supply over time.
- * @param scheme The energy harvesting scheme to use.
+ * @param reg_liveness The register liveness trace, used if static_reg_liveness is nullptr.
+ * @param static_reg_liveness Register liveness computed from the program, or nullptr.
+ * @param scheme The energy harvesting scheme to use, one of the instantiated scheme types.
+ * @param model The spendthrift backup policy model.
  * @param always_harvest true to harvest always, false to harvest during off periods only.
+ * @param replay The recorded execution of the program to replay instead of emulating it, or nullptr.
+ * Replay feeds the recorded data accesses to the caches and the scheme, and rewinds to the last
+ * backup on a power failure, so it is only valid for schemes that do not alter the instructions
+ * executed between backups.
  *
  * @return The statistics tracked during the simulation.
  */
-stats_bundle simulate(char const *binary_file,
+template <typename Scheme>
+stats_bundle simulate(thumbulator::program_image const &program,
     ehsim::voltage_trace const &power,
     bool const use_reg_lva,
     ehsim::liveness_trace const &reg_liveness,
+    ehsim::static_liveness const *static_reg_liveness,
     bool const use_mem_lva,
     ehsim::liveness_trace const &mem_liveness,
-    eh_scheme *scheme,
-    bool always_harvest);
+    Scheme *scheme,
+    spendthrift_model &model,
+    bool always_harvest,
+    thumbulator::trace_reader *replay);
 }
 
 #endif //EH_SIM_SIMULATE_HPP
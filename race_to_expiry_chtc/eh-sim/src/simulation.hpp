@@ -0,0 +1,100 @@
+#ifndef EH_SIM_SIMULATION_HPP
+#define EH_SIM_SIMULATION_HPP
+
+#include <thumbulator/machine.hpp>
+
+#include <functional>
+#include <iostream>
+
+#include "stats.hpp"
+
+namespace ehsim {
+
+class profiler;
+class spendthrift_model;
+
+/**
+ * All the state of one energy harvesting simulation: the simulated machine, the statistics and the
+ * inputs of the spendthrift backup policy.
+ *
+ * simulate() and the schemes operate on the simulation that is active on the calling thread, see
+ * simulation_scope.
+ */
+struct simulation {
+  thumbulator::machine machine;
+
+  stats_bundle stats{};
+
+  /**
+   * The latest voltage of the energy harvesting source.
+   */
+  double env_voltage = 0;
+
+  /**
+   * The latest energy stored in the capacitor in nJ.
+   */
+  double battery_energy = 0;
+
+  spendthrift_model *spendthrift = nullptr;
+
+  /**
+   * Receives every executed instruction if the simulation is profiled, see profiler.
+   */
+  profiler *profile = nullptr;
+
+  /**
+   * Where the simulation and the schemes report progress.
+   */
+  std::ostream *out = &std::cout;
+
+  /**
+   * Splits a run shared by several sweep configurations, empty for a run of its own.
+   *
+   * Called before the first instruction and after every instruction, before the backup decision,
+   * with false, and with true at the end of the run. Returns true once the calling process
+   * continues as one of the configurations, after which it is not called again.
+   */
+  std::function<bool(bool)> split;
+};
+
+extern thread_local simulation *current_simulation;
+
+/**
+ * The simulation that is active on this thread.
+ */
+inline simulation &active_simulation()
+{
+  return *current_simulation;
+}
+
+/**
+ * Makes a simulation and its machine active on the calling thread for the lifetime of the scope.
+ *
+ * Schemes install their hooks into the active machine when they are constructed, so create them
+ * inside the scope of the simulation they belong to.
+ */
+class simulation_scope {
+public:
+  explicit simulation_scope(simulation &active)
+      : machine(active.machine)
+      , previous(current_simulation)
+  {
+    current_simulation = &active;
+  }
+
+  ~simulation_scope()
+  {
+    current_simulation = previous;
+  }
+
+  simulation_scope(simulation_scope const &) = delete;
+  simulation_scope &operator=(simulation_scope const &) = delete;
+
+private:
+  thumbulator::machine_scope machine;
+
+  simulation *previous;
+};
+}
+
+#endif //EH_SIM_SIMULATION_HPP
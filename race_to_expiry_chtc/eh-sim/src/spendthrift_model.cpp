@@ -0,0 +1,450 @@
+#include "spendthrift_model.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <new>
+#include <stdexcept>
+
+namespace ehsim {
+
+inference_backend parse_inference_backend(std::string const &name)
+{
+  if(name == "torch") {
+    return inference_backend::torch;
+  } else if(name == "native") {
+    return inference_backend::native;
+  } else if(name == "compare") {
+    return inference_backend::compare;
+  } else if(name == "table") {
+    return inference_backend::table;
+  }
+
+  throw std::runtime_error("Unknown spendthrift backend: " + name);
+}
+
+void *spendthrift_model::operator new(size_t size)
+{
+  void *pointer = nullptr;
+  if(posix_memalign(&pointer, alignof(spendthrift_model), size) != 0) {
+    throw std::bad_alloc();
+  }
+
+  return pointer;
+}
+
+void spendthrift_model::operator delete(void *pointer)
+{
+  free(pointer);
+}
+
+spendthrift_model::spendthrift_model(inference_backend backend,
+    std::string const &path_to_model,
+    std::string const &path_to_weights)
+    : selected_backend(backend)
+{
+  auto const torch_free = backend == inference_backend::native || backend == inference_backend::table;
+  if(!torch_free || path_to_weights.empty()) {
+    module = torch::jit::load(path_to_model);
+  }
+
+  if(path_to_weights.empty()) {
+    load_from_module();
+  } else {
+    load_from_file(path_to_weights);
+  }
+}
+
+float spendthrift_model::forward(double env_voltage, double battery_energy)
+{
+  auto const in_0 = (float)((env_voltage - MEAN_0) / SD_0);
+  auto const in_1 = (float)((battery_energy - MEAN_1) / SD_1);
+
+  if(selected_backend == inference_backend::native || selected_backend == inference_backend::table) {
+    return forward_native(in_0, in_1);
+  }
+
+  auto const reference = forward_torch(in_0, in_1);
+  if(selected_backend == inference_backend::compare) {
+    auto const native = forward_native(in_0, in_1);
+
+    num_compared++;
+    if(std::memcmp(&native, &reference, sizeof(float)) != 0) {
+      num_inexact++;
+      max_abs_difference = std::max(max_abs_difference, std::fabs((double)native - reference));
+    }
+    if((native >= 0.5) != (reference >= 0.5)) {
+      num_decision_mismatches++;
+    }
+  }
+
+  return reference;
+}
+
+bool spendthrift_model::will_backup(double env_voltage, double battery_energy)
+{
+  if(selected_backend == inference_backend::table) {
+    return table_decision(env_voltage, battery_energy);
+  }
+
+  return forward(env_voltage, battery_energy) >= 0.5;
+}
+
+void spendthrift_model::build_table(double min_voltage,
+    double max_voltage,
+    double max_energy,
+    size_t voltage_steps,
+    size_t energy_steps)
+{
+  if(voltage_steps < 2 || energy_steps < 2) {
+    throw std::runtime_error("The spendthrift table needs at least two voltages and two energies.");
+  }
+  if(max_voltage <= min_voltage) {
+    // constant trace, any width works since every lookup lands on the first entry
+    max_voltage = min_voltage + 1.0;
+  }
+
+  table_min_voltage = min_voltage;
+  table_voltage_scale = (voltage_steps - 1) / (max_voltage - min_voltage);
+  table_threshold.assign(voltage_steps, 0.0f);
+  table_slope.assign(voltage_steps, 0.0f);
+  table_backup_below.assign(voltage_steps, 0u);
+  table_constant.assign(voltage_steps, 0u);
+
+  for(size_t i = 0; i < voltage_steps; i++) {
+    auto const voltage = min_voltage + i / table_voltage_scale;
+
+    bool backup_below = false;
+    bool constant = false;
+    table_threshold[i] =
+        (float)find_threshold(voltage, max_energy, energy_steps, backup_below, constant);
+    table_backup_below[i] = backup_below;
+    table_constant[i] = constant;
+  }
+  for(size_t i = 0; i + 1 < voltage_steps; i++) {
+    table_slope[i] = table_threshold[i + 1] - table_threshold[i];
+  }
+
+  validate_table(max_energy, energy_steps);
+}
+
+bool spendthrift_model::native_decision(double env_voltage, double battery_energy) const
+{
+  auto const in_0 = (float)((env_voltage - MEAN_0) / SD_0);
+  auto const in_1 = (float)((battery_energy - MEAN_1) / SD_1);
+
+  return forward_native(in_0, in_1) >= 0.5;
+}
+
+bool spendthrift_model::table_decision(double env_voltage, double battery_energy) const
+{
+  double threshold = 0.0;
+  auto const entry = table_lookup(env_voltage, threshold);
+  if(table_constant[entry]) {
+    // the decision at zero energy holds at every energy
+    return table_backup_below[entry];
+  }
+
+  return table_backup_below[entry] ? battery_energy < threshold : battery_energy >= threshold;
+}
+
+size_t spendthrift_model::table_lookup(double env_voltage, double &threshold) const
+{
+  auto const last = table_threshold.size() - 1;
+
+  auto position = (env_voltage - table_min_voltage) * table_voltage_scale;
+  position = std::min(std::max(position, 0.0), (double)last);
+
+  auto index = static_cast<size_t>(position);
+  if(index == last) {
+    index--;
+  }
+  auto const fraction = position - index;
+  auto const nearest = fraction < 0.5 ? index : index + 1;
+
+  if(table_constant[index] || table_constant[index + 1]
+      || table_backup_below[index] != table_backup_below[index + 1]) {
+    threshold = table_threshold[nearest];
+  } else {
+    threshold = table_threshold[index] + table_slope[index] * fraction;
+  }
+
+  return nearest;
+}
+
+double spendthrift_model::find_threshold(double env_voltage,
+    double max_energy,
+    size_t energy_steps,
+    bool &backup_below,
+    bool &constant) const
+{
+  auto const step = max_energy / (energy_steps - 1);
+
+  // the decision at zero energy holds below the threshold
+  backup_below = native_decision(env_voltage, 0.0);
+  constant = false;
+
+  for(size_t k = 1; k < energy_steps; k++) {
+    if(native_decision(env_voltage, k * step) == backup_below) {
+      continue;
+    }
+
+    // refine the first flip, the coarse grid only has to find it
+    auto low = (k - 1) * step;
+    auto high = k * step;
+    for(int iteration = 0; iteration < 32; iteration++) {
+      auto const middle = 0.5 * (low + high);
+      if(native_decision(env_voltage, middle) == backup_below) {
+        low = middle;
+      } else {
+        high = middle;
+      }
+    }
+
+    return high;
+  }
+
+  // no flip in range: the decision is constant and there is no threshold to interpolate
+  constant = true;
+  return max_energy;
+}
+
+void spendthrift_model::validate_table(double max_energy, size_t energy_steps)
+{
+  table_num_validated = 0u;
+  table_num_mismatches = 0u;
+  table_max_threshold_error = 0.0;
+
+  // check on a grid twice as fine as the table, so half the samples fall between table entries
+  auto const voltage_steps = 2 * table_threshold.size() - 1;
+  auto const validation_energy_steps = 2 * energy_steps - 1;
+  auto const energy_step = max_energy / (validation_energy_steps - 1);
+
+  for(size_t i = 0; i < voltage_steps; i++) {
+    auto const voltage = table_min_voltage + 0.5 * i / table_voltage_scale;
+
+    bool backup_below = false;
+    bool constant = false;
+    auto const threshold =
+        find_threshold(voltage, max_energy, energy_steps, backup_below, constant);
+    double table_threshold_here = 0.0;
+    auto const entry = table_lookup(voltage, table_threshold_here);
+    // constant decisions have no threshold to be off by, the decisions below still check them
+    if(!constant && !table_constant[entry]) {
+      table_max_threshold_error =
+          std::max(table_max_threshold_error, std::fabs(threshold - table_threshold_here));
+    }
+
+    for(size_t k = 0; k < validation_energy_steps; k++) {
+      auto const energy = k * energy_step;
+
+      table_num_validated++;
+      if(table_decision(voltage, energy) != native_decision(voltage, energy)) {
+        table_num_mismatches++;
+      }
+    }
+  }
+}
+
+float spendthrift_model::forward_native(float in_0, float in_1) const
+{
+  // fixed-size buffers on the stack, no allocation per evaluation
+  alignas(32) float hidden_1[HIDDEN];
+  alignas(32) float hidden_2[HIDDEN];
+
+  // fc1: accumulate in the same order as input @ weight^T + bias
+  for(size_t i = 0; i < HIDDEN; i++) {
+    hidden_1[i] = in_0 * fc1_weight[0][i];
+  }
+  for(size_t i = 0; i < HIDDEN; i++) {
+    hidden_1[i] += in_1 * fc1_weight[1][i];
+  }
+  for(size_t i = 0; i < HIDDEN; i++) {
+    hidden_1[i] += fc1_bias[i];
+  }
+
+  // fc2: one broadcast multiply-add per input, these inner loops vectorize
+  for(size_t i = 0; i < HIDDEN; i++) {
+    hidden_2[i] = hidden_1[0] * fc2_weight[0][i];
+  }
+  for(size_t j = 1; j < HIDDEN; j++) {
+    auto const in = hidden_1[j];
+    for(size_t i = 0; i < HIDDEN; i++) {
+      hidden_2[i] += in * fc2_weight[j][i];
+    }
+  }
+  for(size_t i = 0; i < HIDDEN; i++) {
+    hidden_2[i] += fc2_bias[i];
+  }
+
+  // fc3
+  float output = 0.0f;
+  for(size_t j = 0; j < HIDDEN; j++) {
+    output += hidden_2[j] * fc3_weight[j];
+  }
+  output += fc3_bias;
+
+  if(use_sigmoid) {
+    output = 1.0f / (1.0f + std::exp(-output));
+  }
+
+  return output;
+}
+
+float spendthrift_model::forward_torch(float in_0, float in_1)
+{
+  float array[INPUTS] = {in_0, in_1};
+
+  torch::Tensor tensor_in = torch::from_blob(array, {1, INPUTS});
+  std::vector<torch::jit::IValue> inputs;
+  inputs.push_back(tensor_in);
+
+  // Execute the model and turn its output into a tensor.
+  at::Tensor output = module.forward(inputs).toTensor();
+
+  return output.item<float>();
+}
+
+void spendthrift_model::export_weights(std::string const &path_to_weights) const
+{
+  std::ofstream out(path_to_weights);
+  if(!out.good()) {
+    throw std::runtime_error("Could not open weight file: " + path_to_weights);
+  }
+
+  // enough digits to round-trip every float exactly
+  out << std::setprecision(9);
+  out << INPUTS << " " << HIDDEN << " " << use_sigmoid << "\n";
+
+  // same layout as the torch parameters: weight[out][in]
+  for(size_t i = 0; i < HIDDEN; i++) {
+    for(size_t j = 0; j < INPUTS; j++) {
+      out << fc1_weight[j][i] << (j + 1 < INPUTS ? " " : "\n");
+    }
+  }
+  for(size_t i = 0; i < HIDDEN; i++) {
+    out << fc1_bias[i] << (i + 1 < HIDDEN ? " " : "\n");
+  }
+  for(size_t i = 0; i < HIDDEN; i++) {
+    for(size_t j = 0; j < HIDDEN; j++) {
+      out << fc2_weight[j][i] << (j + 1 < HIDDEN ? " " : "\n");
+    }
+  }
+  for(size_t i = 0; i < HIDDEN; i++) {
+    out << fc2_bias[i] << (i + 1 < HIDDEN ? " " : "\n");
+  }
+  for(size_t j = 0; j < HIDDEN; j++) {
+    out << fc3_weight[j] << (j + 1 < HIDDEN ? " " : "\n");
+  }
+  out << fc3_bias << "\n";
+}
+
+void spendthrift_model::print_comparison(std::ostream &stream) const
+{
+  stream << "Spendthrift evaluations compared: " << std::dec << num_compared << "\n";
+  stream << "Spendthrift outputs not bit-exact: " << std::dec << num_inexact << "\n";
+  stream << "Spendthrift decision mismatches: " << std::dec << num_decision_mismatches << "\n";
+  stream << "Spendthrift max abs difference: " << max_abs_difference << "\n";
+}
+
+void spendthrift_model::print_table_error(std::ostream &stream) const
+{
+  stream << "Spendthrift table entries: " << std::dec << table_threshold.size() << "\n";
+  stream << "Spendthrift table decisions validated: " << std::dec << table_num_validated << "\n";
+  stream << "Spendthrift table decision mismatches: " << std::dec << table_num_mismatches << "\n";
+  stream << "Spendthrift table max threshold error (nJ): " << table_max_threshold_error << "\n";
+}
+
+void spendthrift_model::load_from_module()
+{
+  auto copy_parameter = [](at::Tensor const &tensor, float *destination, size_t rows,
+                            size_t columns, bool transpose) {
+    auto const values = tensor.contiguous();
+    if(static_cast<size_t>(values.numel()) != rows * columns) {
+      throw std::runtime_error("Unexpected spendthrift model layer size.");
+    }
+
+    auto const data = values.data_ptr<float>();
+    for(size_t r = 0; r < rows; r++) {
+      for(size_t c = 0; c < columns; c++) {
+        if(transpose) {
+          destination[c * rows + r] = data[r * columns + c];
+        } else {
+          destination[r * columns + c] = data[r * columns + c];
+        }
+      }
+    }
+  };
+
+  size_t num_loaded = 0;
+  for(auto const &parameter : module.named_parameters()) {
+    if(parameter.name == "fc1.weight") {
+      copy_parameter(parameter.value, &fc1_weight[0][0], HIDDEN, INPUTS, true);
+    } else if(parameter.name == "fc1.bias") {
+      copy_parameter(parameter.value, fc1_bias, 1, HIDDEN, false);
+    } else if(parameter.name == "fc2.weight") {
+      copy_parameter(parameter.value, &fc2_weight[0][0], HIDDEN, HIDDEN, true);
+    } else if(parameter.name == "fc2.bias") {
+      copy_parameter(parameter.value, fc2_bias, 1, HIDDEN, false);
+    } else if(parameter.name == "fc3.weight") {
+      copy_parameter(parameter.value, fc3_weight, 1, HIDDEN, false);
+    } else if(parameter.name == "fc3.bias") {
+      copy_parameter(parameter.value, &fc3_bias, 1, 1, false);
+    } else {
+      throw std::runtime_error("Unexpected spendthrift model parameter: " + parameter.name);
+    }
+    num_loaded++;
+  }
+
+  if(num_loaded != 6) {
+    throw std::runtime_error("Spendthrift model is missing parameters.");
+  }
+
+  // older traces return the logit, newer ones apply the sigmoid in forward()
+  auto const graph = module.get_method("forward").graph()->toString();
+  use_sigmoid = graph.find("aten::sigmoid") != std::string::npos;
+}
+
+void spendthrift_model::load_from_file(std::string const &path_to_weights)
+{
+  std::ifstream in(path_to_weights);
+  if(!in.good()) {
+    throw std::runtime_error("Could not open weight file: " + path_to_weights);
+  }
+
+  size_t inputs = 0;
+  size_t hidden = 0;
+  in >> inputs >> hidden >> use_sigmoid;
+  if(inputs != INPUTS || hidden != HIDDEN) {
+    throw std::runtime_error("Weight file does not match the spendthrift model: " + path_to_weights);
+  }
+
+  for(size_t i = 0; i < HIDDEN; i++) {
+    for(size_t j = 0; j < INPUTS; j++) {
+      in >> fc1_weight[j][i];
+    }
+  }
+  for(size_t i = 0; i < HIDDEN; i++) {
+    in >> fc1_bias[i];
+  }
+  for(size_t i = 0; i < HIDDEN; i++) {
+    for(size_t j = 0; j < HIDDEN; j++) {
+      in >> fc2_weight[j][i];
+    }
+  }
+  for(size_t i = 0; i < HIDDEN; i++) {
+    in >> fc2_bias[i];
+  }
+  for(size_t j = 0; j < HIDDEN; j++) {
+    in >> fc3_weight[j];
+  }
+  in >> fc3_bias;
+
+  if(in.fail()) {
+    throw std::runtime_error("Truncated weight file: " + path_to_weights);
+  }
+}
+}
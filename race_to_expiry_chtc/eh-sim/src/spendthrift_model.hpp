@@ -0,0 +1,186 @@
+#ifndef EH_SIM_SPENDTHRIFT_MODEL_HPP
+#define EH_SIM_SPENDTHRIFT_MODEL_HPP
+
+#include <torch/script.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define MEAN_0 2.1731910037760214
+#define MEAN_1 76325.01716411403
+#define SD_0   1.1933448413265264
+#define SD_1   91963.38072192093
+
+
+//#define MEAN_0 2.617074395841535
+//#define MEAN_1 67213.58046138467
+//#define SD_0   1.3330418578555099
+//#define SD_1   89587.96387189817
+
+//#define MEAN_0 1.2287316313547834 //2.617074395841535
+//#define MEAN_1 76271.89987944828 //67213.58046138467
+//#define SD_0   1.3531843045335201 //1.3330418578555099
+//#define SD_1   91905.93661451967 //89587.96387189817
+
+namespace ehsim {
+
+/**
+ * How the spendthrift model is evaluated.
+ *
+ * torch runs the traced module, native runs the built-in kernel on the extracted weights, and
+ * compare runs both, uses the torch result and records how far the native result is from it.
+ * table answers backup decisions from a precomputed decision surface, see build_table.
+ */
+enum class inference_backend { torch, native, compare, table };
+
+/**
+ * Parse the value given to --spendthrift-backend.
+ */
+inference_backend parse_inference_backend(std::string const &name);
+
+/**
+ * The spendthrift backup policy network: fc1 (2 -> 32), fc2 (32 -> 32), fc3 (32 -> 1) and an
+ * optional sigmoid on the output.
+ */
+class spendthrift_model {
+public:
+  static constexpr size_t INPUTS = 2;
+  static constexpr size_t HIDDEN = 32;
+
+  /**
+   * Load the model.
+   *
+   * @param backend The backend used to evaluate the model.
+   * @param path_to_model Path to a traced model, only needed for the torch and compare backends or
+   * when no weight file is given.
+   * @param path_to_weights Path to a flat weight file written by export_weights, or empty.
+   */
+  spendthrift_model(inference_backend backend,
+      std::string const &path_to_model,
+      std::string const &path_to_weights);
+
+  /**
+   * Allocate the model at the alignment of its weights, which new only guarantees from C++17.
+   */
+  static void *operator new(size_t size);
+
+  static void operator delete(void *pointer);
+
+  /**
+   * Evaluate the model on the raw (not normalized) inputs.
+   *
+   * @param env_voltage The voltage of the energy harvesting source.
+   * @param battery_energy The energy stored in the capacitor in nJ.
+   *
+   * @return The output of the network.
+   */
+  float forward(double env_voltage, double battery_energy);
+
+  /**
+   * Decide whether to back up, i.e. whether the model output is at least 0.5.
+   *
+   * @param env_voltage The voltage of the energy harvesting source.
+   * @param battery_energy The energy stored in the capacitor in nJ.
+   */
+  bool will_backup(double env_voltage, double battery_energy);
+
+  /**
+   * Sample the model over a voltage x energy grid and store, per voltage, the energy at which the
+   * decision flips. Must be called before will_backup when the table backend is selected.
+   *
+   * @param min_voltage The lowest voltage in the voltage trace.
+   * @param max_voltage The highest voltage in the voltage trace.
+   * @param max_energy The maximum energy the capacitor can store in nJ.
+   * @param voltage_steps The number of voltages in the table.
+   * @param energy_steps The number of energies sampled per voltage to find the threshold.
+   */
+  void build_table(double min_voltage,
+      double max_voltage,
+      double max_energy,
+      size_t voltage_steps,
+      size_t energy_steps);
+
+  /**
+   * Evaluate the built-in kernel on already normalized inputs.
+   */
+  float forward_native(float in_0, float in_1) const;
+
+  /**
+   * Write the weights as a flat text file that can be loaded without libtorch.
+   */
+  void export_weights(std::string const &path_to_weights) const;
+
+  inference_backend backend() const
+  {
+    return selected_backend;
+  }
+
+  /**
+   * Print the result of the compare backend.
+   */
+  void print_comparison(std::ostream &stream) const;
+
+  /**
+   * Print how far the decision table is from the model it was sampled from.
+   */
+  void print_table_error(std::ostream &stream) const;
+
+private:
+  inference_backend const selected_backend;
+
+  torch::jit::script::Module module;
+
+  // weights are stored input-major so every layer is a sequence of contiguous multiply-adds
+  alignas(32) float fc1_weight[INPUTS][HIDDEN];
+  alignas(32) float fc1_bias[HIDDEN];
+  alignas(32) float fc2_weight[HIDDEN][HIDDEN];
+  alignas(32) float fc2_bias[HIDDEN];
+  alignas(32) float fc3_weight[HIDDEN];
+  float fc3_bias = 0;
+  bool use_sigmoid = false;
+
+  // compare backend bookkeeping
+  uint64_t num_compared = 0u;
+  uint64_t num_inexact = 0u;
+  uint64_t num_decision_mismatches = 0u;
+  double max_abs_difference = 0.0;
+
+  // table backend: threshold(v) = threshold[i] + slope[i] * t between grid voltages i and i + 1
+  // that both flip the same way, the nearest entry elsewhere; a constant entry never flips
+  double table_min_voltage = 0.0;
+  double table_voltage_scale = 0.0;
+  std::vector<float> table_threshold;
+  std::vector<float> table_slope;
+  std::vector<uint8_t> table_backup_below;
+  std::vector<uint8_t> table_constant;
+
+  // table backend validation
+  uint64_t table_num_validated = 0u;
+  uint64_t table_num_mismatches = 0u;
+  double table_max_threshold_error = 0.0;
+
+  float forward_torch(float in_0, float in_1);
+
+  bool native_decision(double env_voltage, double battery_energy) const;
+
+  bool table_decision(double env_voltage, double battery_energy) const;
+
+  // the entry whose flags decide at a voltage, and the threshold there
+  size_t table_lookup(double env_voltage, double &threshold) const;
+
+  double find_threshold(double env_voltage,
+      double max_energy,
+      size_t energy_steps,
+      bool &backup_below,
+      bool &constant) const;
+
+  void validate_table(double max_energy, size_t energy_steps);
+
+  void load_from_module();
+
+  void load_from_file(std::string const &path_to_weights);
+};
+}
+
+#endif //EH_SIM_SPENDTHRIFT_MODEL_HPP
@@ -0,0 +1,479 @@
+#include "static_liveness.hpp"
+
+#include <thumbulator/program.hpp>
+
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ehsim {
+
+namespace {
+
+constexpr uint16_t SP = 1u << 13;
+constexpr uint16_t LR = 1u << 14;
+constexpr uint16_t ALL_REGISTERS = 0xFFFF;
+
+// registers a callee may read its arguments from
+constexpr uint16_t ARGUMENT_REGISTERS = 0x000F;
+
+// return values in r0-r3 and the values of the caller in r4-r11
+constexpr uint16_t LIVE_AT_RETURN = 0x0FFF | SP;
+
+// the registers reported by get_register_liveness, r0-r12
+constexpr uint16_t TRACKED_REGISTERS = 0x1FFF;
+
+/**
+ * How control leaves an instruction.
+ */
+enum class flow {
+  next,        // falls through
+  branch,      // jumps to the target
+  conditional, // jumps to the target or falls through
+  call,        // calls the target, then falls through if the callee returns normally
+  call_unknown, // calls a register, then falls through
+  ret,         // returns to the caller
+  exit,        // ends the simulation
+  unknown      // indirect jump or undecodable instruction
+};
+
+struct instruction_summary {
+  uint16_t use = 0;
+  uint16_t def = 0;
+  flow kind = flow::next;
+  uint32_t target = 0;
+  uint32_t size = 2;
+};
+
+constexpr uint16_t low_register(uint32_t index)
+{
+  return 1u << index;
+}
+
+int32_t sign_extend(uint32_t value, uint32_t bits)
+{
+  auto const sign = 1u << (bits - 1);
+
+  return static_cast<int32_t>((value ^ sign) - sign);
+}
+
+/**
+ * Registers read and written by an instruction and where control goes next.
+ *
+ * @param address The address of the instruction.
+ * @param insn The (first halfword of the) instruction.
+ * @param second_half The halfword after the instruction, for bl.
+ */
+instruction_summary summarize(uint32_t address, uint16_t insn, uint16_t second_half)
+{
+  instruction_summary summary;
+
+  auto const rd = insn & 0x7u;
+  auto const rn = (insn >> 3) & 0x7u;
+  auto const rm = (insn >> 6) & 0x7u;
+  auto const rhi = (insn >> 8) & 0x7u;
+
+  switch(insn >> 11) {
+  case 0x00:
+  case 0x01:
+  case 0x02: // lsls, lsrs, asrs (immediate)
+    summary.use = low_register(rn);
+    summary.def = low_register(rd);
+    break;
+  case 0x03: // adds, subs (register or 3-bit immediate)
+    summary.use = low_register(rn) | ((insn & 0x0400) != 0 ? 0 : low_register(rm));
+    summary.def = low_register(rd);
+    break;
+  case 0x04: // movs (immediate)
+    summary.def = low_register(rhi);
+    break;
+  case 0x05: // cmp (immediate)
+    summary.use = low_register(rhi);
+    break;
+  case 0x06:
+  case 0x07: // adds, subs (8-bit immediate)
+    summary.use = low_register(rhi);
+    summary.def = low_register(rhi);
+    break;
+  case 0x08:
+    if((insn & 0x0400) == 0) {
+      // data processing
+      switch((insn >> 6) & 0xF) {
+      case 0x8: // tst
+      case 0xA: // cmp
+      case 0xB: // cmn
+        summary.use = low_register(rd) | low_register(rn);
+        break;
+      case 0x9: // rsbs
+      case 0xF: // mvns
+        summary.use = low_register(rn);
+        summary.def = low_register(rd);
+        break;
+      default:
+        summary.use = low_register(rd) | low_register(rn);
+        summary.def = low_register(rd);
+        break;
+      }
+    } else {
+      // special data processing and branch exchange
+      auto const dn = (insn & 0x7u) | ((insn >> 4) & 0x8u);
+      auto const m = (insn >> 3) & 0xFu;
+      switch((insn >> 8) & 0x3) {
+      case 0: // add
+        summary.use = (1u << dn) | (1u << m);
+        summary.def = 1u << dn;
+        if(dn == 15) {
+          summary.kind = flow::unknown;
+        }
+        break;
+      case 1: // cmp
+        summary.use = (1u << dn) | (1u << m);
+        break;
+      case 2: // mov
+        summary.use = 1u << m;
+        summary.def = 1u << dn;
+        if(dn == 15) {
+          summary.kind = m == 14 ? flow::ret : flow::unknown;
+        }
+        break;
+      default:
+        if((insn & 0x0080) != 0) { // blx
+          summary.use = (1u << m) | ARGUMENT_REGISTERS;
+          summary.def = LR;
+          summary.kind = flow::call_unknown;
+        } else { // bx
+          summary.use = 1u << m;
+          summary.kind = m == 14 ? flow::ret : flow::unknown;
+        }
+        break;
+      }
+    }
+    break;
+  case 0x09: // ldr (literal)
+    summary.def = low_register(rhi);
+    break;
+  case 0x0A:
+  case 0x0B: // load and store (register offset)
+    summary.use = low_register(rn) | low_register(rm);
+    if(((insn >> 9) & 0x7) < 3) {
+      summary.use |= low_register(rd);
+    } else {
+      summary.def = low_register(rd);
+    }
+    break;
+  case 0x0C:
+  case 0x0D:
+  case 0x0E:
+  case 0x0F:
+  case 0x10:
+  case 0x11: // load and store (immediate offset)
+    if((insn & 0x0800) != 0) {
+      summary.use = low_register(rn);
+      summary.def = low_register(rd);
+    } else {
+      summary.use = low_register(rd) | low_register(rn);
+    }
+    break;
+  case 0x12: // str (sp relative)
+    summary.use = low_register(rhi) | SP;
+    break;
+  case 0x13: // ldr (sp relative)
+    summary.use = SP;
+    summary.def = low_register(rhi);
+    break;
+  case 0x14: // adr
+    summary.def = low_register(rhi);
+    break;
+  case 0x15: // add (sp plus immediate)
+    summary.use = SP;
+    summary.def = low_register(rhi);
+    break;
+  case 0x16:
+  case 0x17: // miscellaneous
+    switch((insn >> 8) & 0xF) {
+    case 0x0: // add, sub (sp)
+      summary.use = SP;
+      summary.def = SP;
+      break;
+    case 0x2: // sxth, sxtb, uxth, uxtb
+    case 0xA: // rev, rev16, revsh
+      summary.use = low_register(rn);
+      summary.def = low_register(rd);
+      break;
+    case 0x4:
+    case 0x5: // push
+      summary.use = (insn & 0xFF) | ((insn & 0x0100) != 0 ? LR : 0) | SP;
+      summary.def = SP;
+      break;
+    case 0xC:
+    case 0xD: // pop
+      summary.use = SP;
+      summary.def = (insn & 0xFF) | SP;
+      if((insn & 0x0100) != 0) {
+        summary.kind = flow::ret;
+      }
+      break;
+    case 0x6: // cps
+    case 0xE: // bkpt
+    case 0xF: // hints
+      break;
+    default:
+      summary.kind = flow::unknown;
+      break;
+    }
+    break;
+  case 0x18: // stm
+    summary.use = low_register(rhi) | (insn & 0xFF);
+    summary.def = low_register(rhi);
+    break;
+  case 0x19: // ldm, writes back the base unless it is loaded
+    summary.use = low_register(rhi);
+    summary.def = (insn & 0xFF) | ((insn & low_register(rhi)) != 0 ? 0 : low_register(rhi));
+    break;
+  case 0x1A:
+  case 0x1B: { // conditional branch, svc
+    auto const cond = (insn >> 8) & 0xF;
+    if(cond < 0xE) {
+      summary.kind = flow::conditional;
+      summary.target = address + 4 + sign_extend((insn & 0xFFu) << 1, 9);
+    } else if(insn == 0xDF01) {
+      summary.kind = flow::exit;
+    } else {
+      summary.kind = flow::unknown;
+    }
+    break;
+  }
+  case 0x1C: // b
+    summary.kind = flow::branch;
+    summary.target = address + 4 + sign_extend((insn & 0x7FFu) << 1, 12);
+    break;
+  case 0x1E: // bl
+    if((second_half & 0xD000) == 0xD000) {
+      uint32_t const S = (insn >> 10) & 0x1;
+      uint32_t const I1 = ~(((second_half >> 13) & 0x1) ^ S) & 0x1;
+      uint32_t const I2 = ~(((second_half >> 11) & 0x1) ^ S) & 0x1;
+      uint32_t const imm = (S << 23) | (I1 << 22) | (I2 << 21) | ((insn & 0x3FFu) << 11)
+                           | (second_half & 0x7FFu);
+
+      summary.use = ARGUMENT_REGISTERS;
+      summary.def = LR;
+      summary.kind = flow::call;
+      summary.target = address + 4 + sign_extend(imm << 1, 25);
+      summary.size = 4;
+    } else {
+      summary.kind = flow::unknown;
+    }
+    break;
+  default:
+    summary.kind = flow::unknown;
+    break;
+  }
+
+  return summary;
+}
+
+/**
+ * The instructions of a program, decoded on demand.
+ */
+class program_code {
+public:
+  explicit program_code(std::vector<uint32_t> const &program) : program(program)
+  {
+  }
+
+  size_t num_halfwords() const
+  {
+    return program.size() * 2;
+  }
+
+  bool contains(uint32_t address) const
+  {
+    return (address >> 1) < num_halfwords();
+  }
+
+  uint16_t halfword(uint32_t address) const
+  {
+    if(!contains(address)) {
+      return 0;
+    }
+
+    auto const word = program[address >> 2];
+    return (address & 0x2) != 0 ? static_cast<uint16_t>(word >> 16) : static_cast<uint16_t>(word);
+  }
+
+  instruction_summary summarize(uint32_t address) const
+  {
+    return ehsim::summarize(address, halfword(address), halfword(address + 2));
+  }
+
+  /**
+   * Whether a function returns to the instruction after its call.
+   *
+   * Helpers like __gnu_thumb1_case_uqi compute their return address from lr, the halfwords after
+   * a call to them are a jump table and not code.
+   */
+  bool returns_normally(uint32_t entry)
+  {
+    auto const memo = returns.find(entry);
+    if(memo != returns.end()) {
+      return memo->second;
+    }
+
+    auto normal = true;
+    std::unordered_set<uint32_t> visited;
+    std::vector<uint32_t> pending{entry};
+    while(!pending.empty() && normal) {
+      auto const address = pending.back();
+      pending.pop_back();
+      if(!contains(address) || !visited.insert(address).second) {
+        continue;
+      }
+
+      auto const summary = summarize(address);
+      auto const is_call = summary.kind == flow::call || summary.kind == flow::call_unknown;
+      if(!is_call && (summary.def & LR) != 0) {
+        normal = false;
+      }
+
+      if(summary.kind == flow::branch || summary.kind == flow::conditional) {
+        pending.push_back(summary.target);
+      }
+      if(summary.kind == flow::next || summary.kind == flow::conditional || is_call) {
+        pending.push_back(address + summary.size);
+      }
+    }
+
+    returns.emplace(entry, normal);
+    return normal;
+  }
+
+private:
+  std::vector<uint32_t> const &program;
+
+  std::unordered_map<uint32_t, bool> returns;
+};
+}
+
+static_liveness::static_liveness(thumbulator::program_image const &image)
+{
+  auto const &program = image.flash;
+  program_code code(program);
+  auto const n = code.num_halfwords();
+  dead_registers.assign(n, 0);
+  if(program.size() < 2) {
+    return;
+  }
+
+  // recover the control flow graph from the reset vector and the known functions, which also
+  // covers functions that are only called through pointers
+  std::vector<instruction_summary> summaries(n);
+  std::vector<uint8_t> discovered(n, 0);
+  std::vector<uint32_t> pending{program[1] & ~0x1u};
+  for(auto const &symbol : image.symbols.all()) {
+    if(symbol.is_function) {
+      pending.push_back(symbol.address);
+    }
+  }
+  std::vector<uint32_t> reached;
+  while(!pending.empty()) {
+    auto const address = pending.back();
+    pending.pop_back();
+    if(!code.contains(address) || discovered[address >> 1]) {
+      continue;
+    }
+
+    auto summary = code.summarize(address);
+    if(summary.kind == flow::call) {
+      pending.push_back(summary.target);
+      if(!code.returns_normally(summary.target)) {
+        summary.kind = flow::unknown;
+      }
+    }
+
+    if(summary.kind == flow::branch || summary.kind == flow::conditional) {
+      pending.push_back(summary.target);
+    }
+    if(summary.kind == flow::next || summary.kind == flow::conditional
+        || summary.kind == flow::call || summary.kind == flow::call_unknown) {
+      pending.push_back(address + summary.size);
+    }
+
+    discovered[address >> 1] = 1;
+    summaries[address >> 1] = summary;
+    reached.push_back(address);
+  }
+
+  // successors and predecessors within the analyzed code
+  std::unordered_map<uint32_t, std::vector<uint32_t>> predecessors;
+  std::vector<uint16_t> live_out_fixed(n, 0);
+  auto const successors = [&](uint32_t address, std::vector<uint32_t> &result) {
+    auto const &summary = summaries[address >> 1];
+    result.clear();
+    if(summary.kind == flow::branch || summary.kind == flow::conditional) {
+      result.push_back(summary.target);
+    }
+    if(summary.kind == flow::next || summary.kind == flow::conditional
+        || summary.kind == flow::call || summary.kind == flow::call_unknown) {
+      result.push_back(address + summary.size);
+    }
+  };
+
+  std::vector<uint32_t> next;
+  for(auto const address : reached) {
+    auto const &summary = summaries[address >> 1];
+    auto &fixed = live_out_fixed[address >> 1];
+    switch(summary.kind) {
+    case flow::ret: fixed = LIVE_AT_RETURN; break;
+    case flow::unknown: fixed = ALL_REGISTERS; break;
+    default: break;
+    }
+
+    successors(address, next);
+    for(auto const successor : next) {
+      if(code.contains(successor) && discovered[successor >> 1]) {
+        predecessors[successor].push_back(address);
+      } else {
+        fixed = ALL_REGISTERS;
+      }
+    }
+  }
+
+  // backward dataflow to the least fixpoint
+  std::vector<uint16_t> live_in(n, 0);
+  std::vector<uint8_t> queued(n, 0);
+  std::vector<uint32_t> worklist(reached.begin(), reached.end());
+  for(auto const address : reached) {
+    queued[address >> 1] = 1;
+  }
+
+  while(!worklist.empty()) {
+    auto const address = worklist.back();
+    worklist.pop_back();
+    queued[address >> 1] = 0;
+
+    auto const &summary = summaries[address >> 1];
+    uint16_t live_out = live_out_fixed[address >> 1];
+    successors(address, next);
+    for(auto const successor : next) {
+      if(code.contains(successor)) {
+        live_out |= live_in[successor >> 1];
+      }
+    }
+
+    uint16_t const live = summary.use | (live_out & ~summary.def);
+    if(live != live_in[address >> 1]) {
+      live_in[address >> 1] = live;
+      for(auto const predecessor : predecessors[address]) {
+        if(!queued[predecessor >> 1]) {
+          queued[predecessor >> 1] = 1;
+          worklist.push_back(predecessor);
+        }
+      }
+    }
+  }
+
+  for(auto const address : reached) {
+    dead_registers[address >> 1] = ~live_in[address >> 1] & TRACKED_REGISTERS;
+  }
+  instructions_analyzed = reached.size();
+}
+}
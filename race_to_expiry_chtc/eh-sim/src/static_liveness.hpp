@@ -0,0 +1,66 @@
+#ifndef EH_SIM_STATIC_LIVENESS_HPP
+#define EH_SIM_STATIC_LIVENESS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace thumbulator {
+struct program_image;
+}
+
+namespace ehsim {
+
+/**
+ * Register liveness computed from the program instead of read from a trace.
+ *
+ * The control flow graph is recovered by following the Thumb code from the reset vector, and from
+ * every function in the symbol table of an ELF program, through branches and calls, then a backward
+ * dataflow pass computes the registers live before every instruction. Calls are summarized by the
+ * calling convention: a callee reads r0-r3 and a return keeps r0-r11 live. Wherever the flow cannot
+ * be followed (indirect jumps, undecodable instructions, code never reached from a known entry) all
+ * registers are considered live.
+ *
+ * Since the result is indexed by the program counter, it does not depend on cache configuration or
+ * scheme timing the way a cycle-indexed trace does.
+ */
+class static_liveness {
+public:
+  /**
+   * Analyze a program.
+   *
+   * @param program The application, see thumbulator::load_program.
+   */
+  explicit static_liveness(thumbulator::program_image const &program);
+
+  /**
+   * Get the dead registers before the instruction at the specified address.
+   *
+   * @param address The address of the instruction, the Thumb bit is ignored.
+   *
+   * @return Bit i is set if register i (r0-r12) is dead.
+   */
+  uint16_t get_register_liveness(uint32_t const address) const
+  {
+    auto const index = address >> 1;
+
+    return index < dead_registers.size() ? dead_registers[index] : 0;
+  }
+
+  /**
+   * The number of instructions reached by the analysis.
+   */
+  size_t num_instructions() const
+  {
+    return instructions_analyzed;
+  }
+
+private:
+  // indexed by address / 2
+  std::vector<uint16_t> dead_registers;
+
+  size_t instructions_analyzed = 0;
+};
+}
+
+#endif //EH_SIM_STATIC_LIVENESS_HPP
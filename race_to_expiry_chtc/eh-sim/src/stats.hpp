@@ -214,9 +214,6 @@ struct stats_bundle {
    */
   std::deque<active_stats> models;
 };
-
-extern stats_bundle stats;
-
 }
 
 #endif //EH_SIM_STATS_HPP
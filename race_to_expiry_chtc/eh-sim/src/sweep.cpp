@@ -0,0 +1,354 @@
+#include "sweep.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace ehsim {
+
+std::vector<std::vector<std::string>> read_manifest(std::string const &path_to_manifest)
+{
+  std::ifstream manifest(path_to_manifest);
+  if(!manifest.good()) {
+    throw std::runtime_error("Could not open sweep manifest: " + path_to_manifest);
+  }
+
+  std::vector<std::vector<std::string>> configurations;
+
+  std::string line;
+  while(std::getline(manifest, line)) {
+    std::vector<std::string> words;
+    std::string word;
+    auto in_word = false;
+    auto in_quotes = false;
+
+    for(auto const c : line) {
+      if(c == '"') {
+        in_quotes = !in_quotes;
+        in_word = true;
+      } else if(!in_quotes && (c == ' ' || c == '\t' || c == '\r')) {
+        if(in_word) {
+          words.push_back(word);
+          word.clear();
+          in_word = false;
+        }
+      } else {
+        word += c;
+        in_word = true;
+      }
+    }
+    if(in_quotes) {
+      throw std::runtime_error("Unterminated quote in sweep manifest: " + line);
+    }
+    if(in_word) {
+      words.push_back(word);
+    }
+
+    if(words.empty() || words.front()[0] == '#') {
+      continue;
+    }
+
+    configurations.push_back(words);
+  }
+
+  return configurations;
+}
+
+namespace {
+struct job_queue {
+  std::mutex mutex;
+  std::deque<size_t> jobs;
+};
+}
+
+void run_jobs(std::vector<std::function<void()>> const &jobs, size_t num_threads)
+{
+  if(num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  num_threads = std::min(num_threads, std::max<size_t>(jobs.size(), 1));
+
+  std::vector<std::unique_ptr<job_queue>> queues;
+  for(size_t i = 0; i < num_threads; i++) {
+    queues.emplace_back(new job_queue());
+  }
+  for(size_t job = 0; job < jobs.size(); job++) {
+    queues[job % num_threads]->jobs.push_back(job);
+  }
+
+  std::mutex error_mutex;
+  std::exception_ptr first_error = nullptr;
+
+  auto const worker = [&](size_t self) {
+    while(true) {
+      auto found = false;
+      size_t job = 0;
+
+      // own queue from the front, then steal from the back of the others
+      for(size_t offset = 0; offset < num_threads && !found; offset++) {
+        auto &queue = *queues[(self + offset) % num_threads];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.jobs.empty()) {
+          continue;
+        }
+
+        if(offset == 0) {
+          job = queue.jobs.front();
+          queue.jobs.pop_front();
+        } else {
+          job = queue.jobs.back();
+          queue.jobs.pop_back();
+        }
+        found = true;
+      }
+
+      // no job is ever added, so empty queues mean all work is handed out
+      if(!found) {
+        return;
+      }
+
+      try {
+        jobs[job]();
+      } catch(...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if(first_error == nullptr) {
+          first_error = std::current_exception();
+        }
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for(size_t i = 1; i < num_threads; i++) {
+    threads.emplace_back(worker, i);
+  }
+  worker(0);
+  for(auto &thread : threads) {
+    thread.join();
+  }
+
+  if(first_error != nullptr) {
+    std::rethrow_exception(first_error);
+  }
+}
+
+struct process_pool::shared_state {
+  sem_t slots;
+
+  /**
+   * One entry per slot, the pid of the process holding it or 0.
+   */
+  std::atomic<pid_t> *holders()
+  {
+    return reinterpret_cast<std::atomic<pid_t> *>(this + 1);
+  }
+
+  /**
+   * One byte per configuration after the slot holders, 1 once it succeeded.
+   */
+  unsigned char *succeeded(size_t num_slots)
+  {
+    return reinterpret_cast<unsigned char *>(holders() + num_slots);
+  }
+};
+
+process_pool::process_pool(size_t num_configurations, size_t num_processes)
+    : NUM_CONFIGURATIONS(num_configurations)
+    , num_processes(num_processes)
+{
+  if(this->num_processes == 0) {
+    this->num_processes = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  // anonymous mappings are zeroed: no slot is held and no configuration succeeded yet
+  auto const mapping = mmap(nullptr, mapping_size(),
+      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if(mapping == MAP_FAILED) {
+    throw std::runtime_error("Could not map the state shared by the sweep processes.");
+  }
+  shared = static_cast<shared_state *>(mapping);
+
+  if(sem_init(&shared->slots, 1, static_cast<unsigned>(this->num_processes)) != 0) {
+    munmap(shared, mapping_size());
+    throw std::runtime_error("Could not create the process slots of the sweep.");
+  }
+}
+
+process_pool::~process_pool()
+{
+  sem_destroy(&shared->slots);
+  munmap(shared, mapping_size());
+}
+
+void process_pool::run(std::vector<std::function<void()>> const &tasks)
+{
+  // buffered output would be written again by every child
+  std::cout.flush();
+  std::cerr.flush();
+
+  size_t num_running = 0;
+  auto fork_failed = false;
+
+  for(size_t task = 0; task < tasks.size() && !fork_failed; task++) {
+    // children beyond the slots would only wait for one
+    if(num_running == num_processes) {
+      wait_for_children(1);
+      num_running--;
+    }
+
+    auto const child = fork();
+    if(child == 0) {
+      try {
+        acquire();
+        tasks[task]();
+      } catch(...) {
+      }
+
+      exit_child();
+    }
+
+    if(child < 0) {
+      // finish the running tasks before reporting
+      fork_failed = true;
+    } else {
+      num_running++;
+    }
+  }
+
+  wait_for_children(num_running);
+
+  if(fork_failed) {
+    throw std::runtime_error("Could not fork a sweep process.");
+  }
+}
+
+size_t process_pool::branch(size_t num_branches)
+{
+  std::cout.flush();
+  std::cerr.flush();
+
+  // the branches work in place of this process
+  release();
+
+  size_t num_children = 0;
+  for(size_t branch = 0; branch < num_branches; branch++) {
+    auto const child = fork();
+    if(child == 0) {
+      acquire();
+      return branch;
+    }
+
+    if(child < 0) {
+      // the configuration of the branch is never reported and fails
+      std::cerr << "Could not fork a sweep process.\n";
+    } else {
+      num_children++;
+    }
+  }
+
+  try {
+    wait_for_children(num_children);
+  } catch(std::exception const &e) {
+    std::cerr << e.what() << "\n";
+  }
+  exit_child();
+}
+
+void process_pool::finish(size_t configuration, bool succeeded)
+{
+  shared->succeeded(num_processes)[configuration] = succeeded ? 1 : 0;
+}
+
+size_t process_pool::num_failed() const
+{
+  auto const *succeeded = shared->succeeded(num_processes);
+
+  return static_cast<size_t>(std::count(succeeded, succeeded + NUM_CONFIGURATIONS, 0));
+}
+
+void process_pool::acquire()
+{
+  while(sem_wait(&shared->slots) != 0) {
+    if(errno != EINTR) {
+      throw std::runtime_error("Could not wait for a sweep process slot.");
+    }
+  }
+
+  // the semaphore leaves a free entry for every process past it
+  auto const self = getpid();
+  auto *holders = shared->holders();
+  for(size_t slot = 0;; slot = (slot + 1) % num_processes) {
+    pid_t unheld = 0;
+    if(holders[slot].compare_exchange_strong(unheld, self)) {
+      break;
+    }
+  }
+  working = true;
+}
+
+void process_pool::release()
+{
+  if(working) {
+    give_back(getpid());
+    working = false;
+  }
+}
+
+void process_pool::give_back(pid_t holder)
+{
+  auto *holders = shared->holders();
+  for(size_t slot = 0; slot < num_processes; slot++) {
+    auto expected = holder;
+    if(holders[slot].compare_exchange_strong(expected, 0)) {
+      sem_post(&shared->slots);
+      return;
+    }
+  }
+}
+
+size_t process_pool::mapping_size() const
+{
+  return sizeof(shared_state) + num_processes * sizeof(std::atomic<pid_t>) + NUM_CONFIGURATIONS;
+}
+
+void process_pool::wait_for_children(size_t num_children)
+{
+  while(num_children > 0) {
+    auto const child = waitpid(-1, nullptr, 0);
+    if(child < 0) {
+      if(errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error("Lost track of the sweep processes.");
+    }
+
+    num_children--;
+    // a child that died holding a slot never gave it back; its pid is not reused before this
+    give_back(child);
+  }
+}
+
+void process_pool::exit_child()
+{
+  release();
+
+  std::cout.flush();
+  std::cerr.flush();
+  // skip the destructors and exit handlers of the parent's state
+  _exit(EXIT_SUCCESS);
+}
+}
@@ -0,0 +1,111 @@
+#ifndef EH_SIM_SWEEP_HPP
+#define EH_SIM_SWEEP_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace ehsim {
+
+/**
+ * Read a sweep manifest.
+ *
+ * Every line holds one configuration, written as the options of a single eh-sim run. Empty lines
+ * and lines starting with # are skipped, double quotes group words that contain spaces.
+ *
+ * @param path_to_manifest Path to an existing manifest.
+ *
+ * @return The options of every configuration, in manifest order.
+ */
+std::vector<std::vector<std::string>> read_manifest(std::string const &path_to_manifest);
+
+/**
+ * Run jobs on a pool of threads.
+ *
+ * Jobs are dealt round-robin to the threads. A thread that runs out of jobs steals from the back of
+ * the other threads' queues, so long configurations do not leave threads idle at the end.
+ *
+ * @param jobs The jobs to run, each exactly once.
+ * @param num_threads The number of threads, 0 for one per hardware thread.
+ *
+ * If a job throws, the remaining jobs still run and the first exception is rethrown at the end.
+ */
+void run_jobs(std::vector<std::function<void()>> const &jobs, size_t num_threads);
+
+/**
+ * Child processes forked from this one, running the configurations of a sweep.
+ *
+ * Each child starts from a copy-on-write snapshot of the process that forks it, so everything loaded
+ * or simulated before the fork is shared instead of being done again. A task can split its process
+ * again with branch, so configurations that start out the same share that start as well.
+ *
+ * Processes hold one of num_processes slots while they work, across all the processes of the
+ * sweep. A configuration fails unless a process reports it with finish, so configurations that
+ * throw, are never run or whose process dies count as failed.
+ *
+ * Create and run it from a single-threaded process: only the calling thread is forked.
+ */
+class process_pool {
+public:
+  /**
+   * @param num_configurations The number of configurations reported with finish.
+   * @param num_processes The most processes working at a time, 0 for one per hardware thread.
+   */
+  process_pool(size_t num_configurations, size_t num_processes);
+
+  ~process_pool();
+
+  process_pool(process_pool const &) = delete;
+  process_pool &operator=(process_pool const &) = delete;
+
+  /**
+   * Run each task in its own child process and wait for them and their branches to exit.
+   */
+  void run(std::vector<std::function<void()>> const &tasks);
+
+  /**
+   * Split the process of a task into branches, each continuing from here in its own child.
+   *
+   * The calling process waits for the branches and exits instead of returning.
+   *
+   * @return The index of the branch the returning process continues as.
+   */
+  size_t branch(size_t num_branches);
+
+  /**
+   * Report the outcome of a configuration.
+   */
+  void finish(size_t configuration, bool succeeded);
+
+  /**
+   * The number of configurations not reported to have succeeded.
+   */
+  size_t num_failed() const;
+
+private:
+  struct shared_state;
+
+  shared_state *shared;
+  size_t const NUM_CONFIGURATIONS;
+  size_t num_processes;
+
+  // whether this process holds a slot
+  bool working = false;
+
+  void acquire();
+  void release();
+
+  /**
+   * Give back the slot held by a process, if it holds one.
+   */
+  void give_back(pid_t holder);
+
+  size_t mapping_size() const;
+  void wait_for_children(size_t num_children);
+  [[noreturn]] void exit_child();
+};
+}
+
+#endif //EH_SIM_SWEEP_HPP
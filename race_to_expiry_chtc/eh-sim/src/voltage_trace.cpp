@@ -1,25 +1,188 @@
 #include "voltage_trace.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace ehsim {
+
+constexpr char binary_trace_header::MAGIC[4];
+constexpr uint32_t binary_trace_header::VERSION;
+constexpr int binary_trace_header::SUM_FRACTION_BITS;
+
+namespace {
+
+bool is_binary_trace(std::string const &path_to_trace)
+{
+  std::ifstream trace(path_to_trace, std::ios::binary);
+
+  char magic[sizeof(binary_trace_header::MAGIC)];
+  return trace.read(magic, sizeof(magic))
+         && std::memcmp(magic, binary_trace_header::MAGIC, sizeof(magic)) == 0;
+}
+
+/**
+ * Sum samples in fixed point, entry i is the sum of the first i samples.
+ */
+template <typename Sample>
+std::vector<int64_t> sum_samples(Sample const *samples, uint64_t num_samples)
+{
+  std::vector<int64_t> sums(num_samples + 1);
+  sums[0] = 0;
+  for(uint64_t i = 0; i < num_samples; ++i) {
+    sums[i + 1] =
+        sums[i] + std::llround(std::ldexp(samples[i], binary_trace_header::SUM_FRACTION_BITS));
+  }
+
+  return sums;
+}
+
+/**
+ * Offset of the voltage sums, aligned for int64.
+ */
+uint64_t sums_offset(uint64_t num_samples)
+{
+  auto const end_of_samples = sizeof(binary_trace_header) + num_samples * sizeof(float);
+
+  return (end_of_samples + alignof(int64_t) - 1) / alignof(int64_t) * alignof(int64_t);
+}
+}
+
 voltage_trace::voltage_trace(std::string const &path_to_trace, std::chrono::milliseconds const &sample_period)
-  : maximum_time(0), period(sample_period)
+  : maximum_time(0), period(sample_period), sample_count(0), samples(nullptr), sums(nullptr),
+    mapping(nullptr), mapping_size(0), min_voltage(0.0), max_voltage(0.0)
 {
+  if(is_binary_trace(path_to_trace)) {
+    auto const fd = open(path_to_trace.c_str(), O_RDONLY);
+    if(fd < 0) {
+      throw std::runtime_error("Could not open voltage trace: " + path_to_trace);
+    }
+
+    struct stat file_status;
+    if(fstat(fd, &file_status) != 0) {
+      close(fd);
+      throw std::runtime_error("Could not read voltage trace: " + path_to_trace);
+    }
+
+    mapping_size = file_status.st_size;
+    if(mapping_size < sizeof(binary_trace_header)) {
+      close(fd);
+      throw std::runtime_error("Voltage trace is too small for its header: " + path_to_trace);
+    }
+
+    mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED) {
+      mapping = nullptr;
+      throw std::runtime_error("Could not map voltage trace: " + path_to_trace);
+    }
+
+    auto const base = static_cast<char const *>(mapping);
+    auto const &header = *reinterpret_cast<binary_trace_header const *>(base);
+    if(header.version != binary_trace_header::VERSION || header.num_samples == 0
+        || header.num_samples > (mapping_size - sizeof(header)) / sizeof(float)) {
+      munmap(mapping, mapping_size);
+      throw std::runtime_error("Unsupported or truncated voltage trace: " + path_to_trace);
+    }
+
+    auto const converted_period = header.sample_period;
+    if(converted_period != static_cast<uint64_t>(sample_period.count())) {
+      munmap(mapping, mapping_size);
+      throw std::runtime_error("Voltage trace " + path_to_trace + " was converted with a sample "
+                               "period of " + std::to_string(converted_period) + " ms");
+    }
+
+    sample_count = header.num_samples;
+    samples = reinterpret_cast<float const *>(base + sizeof(header));
+    min_voltage = header.min_voltage;
+    max_voltage = header.max_voltage;
+
+    if(header.sums_offset != 0 && header.sums_offset % alignof(int64_t) == 0
+        && header.sums_offset <= mapping_size
+        && (mapping_size - header.sums_offset) / sizeof(int64_t) >= sample_count + 1) {
+      sums = reinterpret_cast<int64_t const *>(base + header.sums_offset);
+    } else {
+      voltage_sums = sum_samples(samples, sample_count);
+      sums = voltage_sums.data();
+    }
+
+    maximum_time = std::chrono::milliseconds(sample_count);
+    return;
+  }
+
   std::ifstream trace(path_to_trace);
 
   uint64_t raw_time;
   double voltage;
-  if(trace >> raw_time >> voltage) {
+  while(trace >> raw_time >> voltage) {
     voltages.emplace_back(voltage);
+  }
 
-    while(trace >> raw_time >> voltage) {
-      voltages.emplace_back(voltage);
-    }
+  if(voltages.empty()) {
+    throw std::runtime_error("Voltage trace is empty or could not be read: " + path_to_trace);
+  }
+
+  sample_count = voltages.size();
+  maximum_time = std::chrono::milliseconds(voltages.size());
+  min_voltage = *std::min_element(voltages.begin(), voltages.end());
+  max_voltage = *std::max_element(voltages.begin(), voltages.end());
 
-    maximum_time = std::chrono::milliseconds(voltages.size());
-    // std::cout << "maximum_time: " << maximum_time.count() << "\n";
+  voltage_sums = sum_samples(voltages.data(), sample_count);
+  sums = voltage_sums.data();
+  // std::cout << "maximum_time: " << maximum_time.count() << "\n";
+}
+
+voltage_trace::~voltage_trace()
+{
+  if(mapping != nullptr) {
+    munmap(mapping, mapping_size);
+  }
+}
+
+void voltage_trace::write_binary(std::string const &path_to_binary, bool include_sums) const
+{
+  if(sample_count == 0) {
+    throw std::runtime_error("Voltage trace has no samples.");
+  }
+
+  std::vector<float> packed(sample_count);
+  for(uint64_t i = 0; i < sample_count; ++i) {
+    packed[i] = samples != nullptr ? samples[i] : static_cast<float>(voltages[i]);
+  }
+
+  binary_trace_header header;
+  std::memcpy(header.magic, binary_trace_header::MAGIC, sizeof(header.magic));
+  header.version = binary_trace_header::VERSION;
+  header.num_samples = sample_count;
+  header.sample_period = period.count();
+  header.min_voltage = *std::min_element(packed.begin(), packed.end());
+  header.max_voltage = *std::max_element(packed.begin(), packed.end());
+  header.sums_offset = include_sums ? sums_offset(sample_count) : 0;
+
+  std::ofstream binary(path_to_binary, std::ios::binary | std::ios::trunc);
+  binary.write(reinterpret_cast<char const *>(&header), sizeof(header));
+  binary.write(reinterpret_cast<char const *>(packed.data()), packed.size() * sizeof(float));
+
+  if(include_sums) {
+    // the sums of the stored samples, which is what a loaded trace sums
+    auto const packed_sums = sum_samples(packed.data(), sample_count);
+
+    auto const padding = header.sums_offset - sizeof(header) - packed.size() * sizeof(float);
+    binary.write("\0\0\0\0\0\0\0", padding);
+    binary.write(reinterpret_cast<char const *>(packed_sums.data()),
+        packed_sums.size() * sizeof(int64_t));
+  }
+
+  if(!binary) {
+    throw std::runtime_error("Could not write voltage trace: " + path_to_binary);
   }
 }
 
@@ -27,6 +190,26 @@ double voltage_trace::get_voltage(std::chrono::milliseconds const &time) const
 {
   // this wraps around the voltage trace
   auto const index = (time.count() / period.count()) % maximum_time.count();
-  return voltages[index];
+  return samples != nullptr ? samples[index] : voltages[index];
+}
+
+double voltage_trace::sum_voltages(uint64_t first, uint64_t count) const
+{
+  auto const num_samples = sample_count;
+  first %= num_samples;
+
+  // the remainder after whole passes over the trace, which may wrap once
+  int64_t remainder = 0;
+  auto const last = first + count % num_samples;
+  if(last <= num_samples) {
+    remainder = sums[last] - sums[first];
+  } else {
+    remainder = sums[num_samples] - sums[first] + sums[last - num_samples];
+  }
+
+  // the passes may not fit in 64 bits, so only they are scaled in floating point
+  auto const passes = static_cast<double>(count / num_samples) * sums[num_samples];
+
+  return std::ldexp(passes + remainder, -binary_trace_header::SUM_FRACTION_BITS);
 }
 }
@@ -2,20 +2,67 @@
 #define EH_SIM_VOLTAGE_TRACE_HPP
 
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
 namespace ehsim {
+
+/**
+ * Header of a binary voltage trace, see convert-voltage-trace.
+ *
+ * The header is followed by num_samples packed float voltages and, if sums_offset is not zero, by
+ * num_samples + 1 int64 at sums_offset where entry i is the sum of the first i voltages in units of
+ * 2^-SUM_FRACTION_BITS V. The charge harvested over a run of samples is proportional to that sum
+ * for every capacitor, so one table serves all capacitor models.
+ */
+struct binary_trace_header {
+  static constexpr char MAGIC[4] = {'E', 'H', 'V', 'T'};
+  static constexpr uint32_t VERSION = 2;
+
+  /**
+   * The voltage sums are fixed point, so summing any number of samples adds no rounding error.
+   */
+  static constexpr int SUM_FRACTION_BITS = 32;
+
+  char magic[4];
+  uint32_t version;
+  uint64_t num_samples;
+  // sample period in ms
+  uint64_t sample_period;
+  double min_voltage;
+  double max_voltage;
+  uint64_t sums_offset;
+};
+
 class voltage_trace {
 public:
   /**
    * Constructor.
    *
-   * @param path_to_trace Path to an existing and valid trace file.
+   * A binary trace is mapped into memory instead of being read, so concurrent simulations share
+   * the pages of the same trace.
+   *
+   * @param path_to_trace Path to an existing and valid trace file, either text or binary.
    * @param sample_period The time between samples in the trace.
    */
   voltage_trace(std::string const &path_to_trace, std::chrono::milliseconds const &sample_period);
 
+  ~voltage_trace();
+
+  voltage_trace(voltage_trace const &) = delete;
+
+  voltage_trace &operator=(voltage_trace const &) = delete;
+
+  /**
+   * Write the trace in the binary format.
+   *
+   * @param path_to_binary Path to the file to create.
+   * @param include_sums Whether to store the voltage sums instead of computing them when loading.
+   */
+  void write_binary(std::string const &path_to_binary, bool include_sums) const;
+
   /**
    * Get the voltage at the specified time.
    *
@@ -25,17 +72,71 @@ public:
    */
   double get_voltage(std::chrono::milliseconds const &time) const;
 
+  /**
+   * Get the sum of the voltages of consecutive samples.
+   *
+   * The sum is taken from fixed-point prefix sums, so it has one final rounding instead of an error
+   * accumulated per sample.
+   *
+   * @param first The index of the first sample, wraps around the voltage trace.
+   * @param count The number of samples to sum, may span the trace several times.
+   *
+   * @return The sum of the voltage readings.
+   */
+  double sum_voltages(uint64_t first, uint64_t count) const;
+
+  /**
+   * @return The index of the sample the specified time falls in, before wrapping.
+   */
+  uint64_t sample_index(std::chrono::milliseconds const &time) const
+  {
+    return time.count() / period.count();
+  }
+
+  uint64_t num_samples() const
+  {
+    return sample_count;
+  }
+
   std::chrono::milliseconds sample_period() const
   {
     return period;
   }
 
+  double minimum_voltage() const
+  {
+    return min_voltage;
+  }
+
+  double maximum_voltage() const
+  {
+    return max_voltage;
+  }
+
 private:
   std::chrono::milliseconds period;
 
   std::chrono::milliseconds maximum_time;
 
+  uint64_t sample_count;
+
+  // a text trace is parsed into voltages, a binary trace is read through samples
   std::vector<double> voltages;
+
+  float const *samples;
+
+  // sums[i] is the fixed-point sum of the first i voltages, points into voltage_sums or the mapping
+  std::vector<int64_t> voltage_sums;
+
+  int64_t const *sums;
+
+  void *mapping;
+
+  size_t mapping_size;
+
+  double min_voltage;
+
+  double max_voltage;
 };
 }
 
@@ -0,0 +1,46 @@
+#include <argagg/argagg.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "voltage_trace.hpp"
+
+/**
+ * Convert a text voltage trace to the binary format eh-sim maps into memory.
+ *
+ * convert-voltage-trace --voltage-rate=MS [--no-sums] TEXT BINARY
+ */
+int main(int argc, char *argv[])
+{
+  argagg::parser arguments{{{"help", {"-h", "--help"}, "display help information", 0},
+      {"rate", {"--voltage-rate"}, "sampling period of the voltage trace (ms), as given to eh-sim", 1},
+      {"no_sums", {"--no-sums"}, "do not store the voltage sums, eh-sim computes them when loading", 0}}};
+
+  try {
+    auto const options = arguments.parse(argc, argv);
+    if(options["help"] || options.pos.size() != 2) {
+      argagg::fmt_ostream help(options["help"] ? std::cout : std::cerr);
+      help << "Convert a text voltage trace to the binary format.\n\n";
+      help << "convert-voltage-trace [options] TEXT BINARY\n\n";
+      help << arguments;
+      return options["help"] ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if(options["rate"].count() == 0) {
+      throw std::runtime_error("No sampling rate provided for the voltage trace.");
+    }
+
+    std::chrono::milliseconds const sampling_period(options["rate"].as<int>());
+    ehsim::voltage_trace const trace(options.pos[0], sampling_period);
+    trace.write_binary(options.pos[1], !options["no_sums"]);
+
+    std::cout << options.pos[1] << ": " << trace.num_samples() << " samples\n";
+  } catch(std::exception const &e) {
+    std::cerr << "Error: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,98 @@
+#ifndef THUMBULATOR_BENCHMARK_H
+#define THUMBULATOR_BENCHMARK_H
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace thumbulator {
+namespace benchmark {
+
+/**
+ * The host cost of simulating one benchmark.
+ */
+struct measurement {
+  std::string name;
+
+  /**
+   * The number of instructions simulated.
+   */
+  uint64_t instructions = 0;
+
+  /**
+   * Loading the program and its inputs until the first instruction runs.
+   */
+  double startup_ms = 0;
+
+  /**
+   * Simulating the instructions.
+   */
+  double run_ms = 0;
+
+  /**
+   * The peak resident set size of the process that ran the benchmark.
+   */
+  long peak_rss_kb = 0;
+
+  /**
+   * Simulated instructions per host second, in millions.
+   */
+  double mips() const;
+
+  double ns_per_instruction() const;
+};
+
+/**
+ * Run a benchmark in a process of its own, so its peak RSS and startup are not shared with others.
+ *
+ * The job runs in a child forked from this process and fills in instructions, startup_ms and
+ * run_ms; the peak RSS is measured from outside. With repetitions, the fastest times and smallest
+ * RSS are kept, which is the least noisy estimate on a busy machine.
+ *
+ * Call it from a single-threaded process: only the calling thread is forked.
+ *
+ * @param name The name of the benchmark in reports and baselines.
+ * @param job Runs the benchmark, throws if it fails.
+ * @param repetitions How many times to run it.
+ */
+measurement run_isolated(std::string const &name,
+    std::function<void(measurement &)> const &job,
+    unsigned repetitions = 1);
+
+/**
+ * Print the measurements as a table.
+ */
+void print_table(std::ostream &stream, std::vector<measurement> const &results);
+
+/**
+ * Write measurements as a JSON baseline, one benchmark per line.
+ */
+void write_json(std::ostream &stream, std::vector<measurement> const &results);
+
+/**
+ * Read a baseline written by write_json, which has to hold at least one benchmark.
+ */
+std::vector<measurement> read_json(std::string const &path_to_baseline);
+
+/**
+ * Compare measurements against a baseline and report the differences.
+ *
+ * A benchmark regresses if its ns per instruction, startup time or peak RSS grows by more than the
+ * threshold, or if it simulates a different number of instructions than the baseline, which means
+ * the simulation itself changed. Benchmarks missing from the baseline are reported as new, and
+ * benchmarks of the baseline missing from the results count as regressed.
+ *
+ * @param threshold The allowed growth, in percent.
+ *
+ * @return The number of benchmarks that regressed.
+ */
+size_t compare(std::vector<measurement> const &results,
+    std::vector<measurement> const &baseline,
+    double threshold,
+    std::ostream &report);
+}
+}
+
+#endif //THUMBULATOR_BENCHMARK_H
@@ -4,8 +4,12 @@
 #include <cstdint>
 #include <cmath>
 #include <cassert>
+#include <algorithm>
+#include <memory>
+#include <vector>
 
 #include <thumbulator/cache_block.hpp>
+#include <thumbulator/replacement.hpp>
 #include "../../../external/hashmap/include/hashmap/hashmap.hpp"
 
 namespace thumbulator {
@@ -18,12 +22,21 @@ struct cache_attributes {
 
 typedef struct cache_attributes cache_attr;
 
+/*
+* A set-associative cache stored as flat arrays indexed by line = set * ASSOC + way
+*
+* Each line has a packed word of tag and state bits, so a set lookup is one scan over ASSOC
+* consecutive words. The data of all lines is one slab, as are the states of the local bloom
+* filters. Blocks are handed out by value as cache_block.
+*
+* Replacement is up to policy_cache, create caches with make_cache and reach the replacement
+* methods through with_policy.
+*/
 class cache {
 
-	public:
-	cache(): cache(1, 64, 2048, 16)
-	{}
-	cache(size_t assoc, uint32_t block_size, uint32_t cache_size, size_t lbf_size):
+	protected:
+	cache(replacement_policy policy, size_t assoc, uint32_t block_size, uint32_t cache_size, size_t lbf_size):
+	POLICY(policy),
 	ASSOC(assoc),
 	BLOCK_SIZE(block_size),
 	CACHE_SIZE(cache_size),
@@ -52,53 +65,21 @@ class cache {
 			set_mask = (set_mask << 1) | 1;
 		}
 
-		tag_array = new cache_block*[SET];
-		data_array = new uint32_t*[SET];
-		if(LBF_SIZE > 0)
-			lbf_array = new std::unique_ptr<hmap::hashmap>*[SET];
-
-		for(size_t set=0; set<SET; set++) {
-			tag_array[set] = new cache_block[ASSOC];
-			data_array[set] = new uint32_t[BLOCK_SIZE/sizeof(uint32_t) * ASSOC];
-			if(LBF_SIZE > 0) {
-				lbf_array[set] = new std::unique_ptr<hmap::hashmap>[ASSOC];
-
-				for(size_t way=0; way<ASSOC; way++) {
-					lbf_array[set][way] = std::unique_ptr<hmap::hashmap>(new hmap::hashmap(lbf_size));
-				}
-			}
-		}
+		WORDS = BLOCK_SIZE/sizeof(uint32_t);
 
-		for(size_t set=0; set<SET; set++) {
-			for(size_t idx=0; idx<BLOCK_SIZE/sizeof(uint32_t) * ASSOC; idx++) {
-				data_array[set][idx] = 0;
-			}
-		}
+		auto const lines = SET * ASSOC;
+		line_state.assign(lines, 0);
+		line_address.assign(lines, 0);
+		data.assign(lines * WORDS, 0);
+		lbf.assign(lines * LBF_SIZE, hmap::cUnknown);
 
+		dirty_bitmap.assign((lines + 63) / 64, 0);
 	}
 
-	~cache()
-	{
-	    for(size_t set=0; set<SET; set++) {
-	      delete[] tag_array[set];
-	      delete[] data_array[set];
-	      tag_array[set]  = nullptr;
-	      data_array[set] = nullptr;
-	      if(lbf_array[set]) {
-	      	delete[] lbf_array[set];
-	      	lbf_array[set]  = nullptr;
-	      }	
-	    }
-
-	    delete[] tag_array;
-	    delete[] data_array;
-	    tag_array  = nullptr;
-	    data_array = nullptr;
-	    if(lbf_array) {
-	      delete[] lbf_array;
-	      lbf_array  = nullptr;
-	    }
-	}
+	public:
+	cache(const cache&) = delete;
+	cache& operator=(const cache&) = delete;
+	virtual ~cache() = default;
 
 	/*
 	* Access methods for tag array
@@ -106,160 +87,181 @@ class cache {
 
 	bool is_hit(uint32_t addr, cache_attr& attr)
 	{
-		auto address = addr;
 		addr >>= block_offset;
-		attr.set = addr & set_mask;
-		auto tag = addr >> set_offset;
+		if(addr == memo_block) {
+			attr.set = memo_set;
+			attr.way = memo_way;
+			hits++;
+			return true;
+		}
 
-		for(size_t i=0; i<ASSOC; i++) {
-			if(tag_array[attr.set][i].get_valid() && tag_array[attr.set][i].get_tag() == tag) {
-				attr.way = i;
-				// fprintf(stdout, "CACHE HIT: address=0x%8.8x set=%zu way=%zu\n", address, attr.set, attr.way);
+		attr.set = addr & set_mask;
+		auto const key = (uint64_t(addr >> set_offset) << TAG_SHIFT) | VALID;
+		auto const *ways = &line_state[attr.set * ASSOC];
+
+		if(ASSOC <= 8) {
+			for(size_t i=0; i<ASSOC; i++) {
+				if((ways[i] & MATCH_MASK) == key) {
+					attr.way = i;
+					remember(addr, attr);
+					hits++;
+					return true;
+				}
+			}
+		}
+		else {
+			// a valid tag is in at most one way, so the scan has no early exit and vectorizes
+			size_t found = ASSOC;
+			for(size_t i=0; i<ASSOC; i++) {
+				found = (ways[i] & MATCH_MASK) == key ? i : found;
+			}
+			if(found != ASSOC) {
+				attr.way = found;
+				remember(addr, attr);
 				hits++;
 				return true;
 			}
 		}
 
-		// fprintf(stdout, "CACHE MISS: address=0x%8.8x set=%zu\n", address, attr.set);
 		misses++;
 		return false;
 	}
 
-	cache_block get_victim(cache_attr& attr)
+	void flush()
 	{
-		cache_block victim = tag_array[attr.set][0];
-		attr.way = 0;
-		for(size_t i=0; i<ASSOC; i++) {
-			if(!tag_array[attr.set][i].get_valid()) {
-				attr.way = i;
-				return tag_array[attr.set][i];
-			}
-			if(tag_array[attr.set][i].get_cnt() > victim.get_cnt()) {
-				victim = tag_array[attr.set][i];
-				attr.way = i;
-			}
+		for(auto &state : line_state) {
+			state &= ~(VALID | DIRTY);
 		}
+		std::fill(lbf.begin(), lbf.end(), hmap::cUnknown);
+
+		std::fill(dirty_bitmap.begin(), dirty_bitmap.end(), 0);
+		num_dirty = 0;
 
-		return victim;
+		memo_block = NO_BLOCK;
 	}
 
-	const cache_block& cache_read(const cache_attr& attr, const bool false_read)
+	void mark_clean(size_t set, size_t way)
 	{
-		if(!false_read) {
-		  update_cnt(attr);
-		}
-		return tag_array[attr.set][attr.way];
+		line_state[set * ASSOC + way] &= ~(DIRTY | WF);
+		update_dirty(set, way);
+
+		clear_state(set, way);
 	}
 
-	void cache_write(bool wf, const cache_attr& attr)
+	cache_block get_block(size_t set, size_t way) const
 	{
-		tag_array[attr.set][attr.way].set_dirty(1);
-		if(wf) {
-			tag_array[attr.set][attr.way].set_wf(1);
-		}
+		auto const line = set * ASSOC + way;
+		auto const state = line_state[line];
 
-		update_cnt(attr);
+		// the replacement state is the policy's, blocks carry no counter
+		return cache_block((state & VALID) != 0, (state & DIRTY) != 0, (state & WF) != 0,
+		    static_cast<uint32_t>(state >> TAG_SHIFT), line_address[line], 0);
 	}
 
-	void cache_insert(const cache_attr& attr, const cache_block& blk, const bool false_read)
+	/*
+	* Number of valid and dirty blocks, kept up to date on every write, insert, and clean
+	*/
+	size_t get_num_dirty() const
 	{
-		tag_array[attr.set][attr.way] = blk;
-		// fprintf(stdout, "cache_insert: v=%d, d=%d, set=%zu, way=%zu, tag=%X, address=0x%8.8X\n", 
-		//     tag_array[attr.set][attr.way].get_valid(), tag_array[attr.set][attr.way].get_dirty(), attr.set, attr.way, tag_array[attr.set][attr.way].get_tag(), tag_array[attr.set][attr.way].get_address());
-		if(!false_read) {
-		  update_cnt(attr);
-		}
+		return num_dirty;
 	}
 
-	void flush()
+	/*
+	* Call f(set, way) for every valid and dirty block in set and way order
+	*
+	* f may mark the block it is given clean.
+	*/
+	template <typename Function>
+	void for_each_dirty(Function f)
 	{
-		for(size_t i=0; i<SET; i++) {
-			for(size_t j=0; j<ASSOC; j++) {
-				tag_array[i][j].set_valid(0);
-				tag_array[i][j].set_dirty(0);
-				if(LBF_SIZE > 0)
-					lbf_array[i][j]->clear();
+		for(size_t word=0; word<dirty_bitmap.size(); word++) {
+			auto bits = dirty_bitmap[word];
+			while(bits != 0) {
+				auto const line = word * 64 + __builtin_ctzll(bits);
+				bits &= bits - 1;
+				f(line / ASSOC, line % ASSOC);
 			}
 		}
 	}
 
-	void mark_clean(size_t set, size_t way)
-	{
-		tag_array[set][way].set_dirty(0);
-		tag_array[set][way].set_wf(0);
+	/*
+	* Access methods for data array
+	*/
 
-		if(LBF_SIZE > 0)
-			lbf_array[set][way]->clear();
+	uint32_t get_data(size_t set, size_t way, uint32_t beat) const
+	{
+		return data[(set * ASSOC + way) * WORDS + beat];
 	}
 
-	const cache_block& get_block(size_t set, size_t way)
+	void set_data(size_t set, size_t way, uint32_t beat, uint32_t value)
 	{
-		return tag_array[set][way];
+		data[(set * ASSOC + way) * WORDS + beat] = value;
 	}
 
 	/*
-	* Access methods for data array
+	* The words of a line, to fill or write back a whole line at once
 	*/
 
-	uint32_t get_data(size_t set, size_t way, uint32_t beat)
+	uint32_t *line_data(size_t set, size_t way)
 	{
-		cache_attr attr;
-		attr.set = set;
-		attr.way = way;
-
-		// fprintf(stdout, "In get_data: beat=%d data=%d\n", beat, data_array[set][get_index(beat, attr)]);
-		return data_array[set][get_index(beat, attr)];
+		return &data[(set * ASSOC + way) * WORDS];
 	}
 
-	void set_data(size_t set, size_t way, uint32_t beat, uint32_t data)
+	const uint32_t *line_data(size_t set, size_t way) const
 	{
-		// fprintf(stdout, "In set_data: beat=%d data=%X\n", beat, data);
-		cache_attr attr;
-		attr.set = set;
-		attr.way = way;
-
-		data_array[set][get_index(beat, attr)] = data;
+		return &data[(set * ASSOC + way) * WORDS];
 	}
 
 	/*
 	* Access methods for local bloom filter array
 	*/
 
-	const hmap::lbf_states get_state(size_t set, size_t way, uint32_t key)
+	const hmap::lbf_states get_state(size_t set, size_t way, uint32_t key) const
 	{
-		// fprintf(stdout, "get_state: set=%zu way=%zu state=%d\n", set, way, word_state);
 		if(LBF_SIZE > 0)
-			return lbf_array[set][way]->get(key);
+			return static_cast<hmap::lbf_states>(lbf[(set * ASSOC + way) * LBF_SIZE + key % LBF_SIZE]);
 		return hmap::cReadFirst;
 	} 
 
 	void set_state(size_t set, size_t way, uint32_t key, const hmap::lbf_states& state)
 	{
-		// fprintf(stdout, "set_state: set=%zu way=%zu state=%d\n", set, way, value);
 		if(LBF_SIZE > 0)
-			lbf_array[set][way]->put(key, state);
+			lbf[(set * ASSOC + way) * LBF_SIZE + key % LBF_SIZE] = state;
 	}
 
-	const bool get_block_state(size_t set, size_t way)
+	const bool get_block_state(size_t set, size_t way) const
 	{
-		bool blk_state = true;
-		if(LBF_SIZE > 0)
-			blk_state = lbf_array[set][way]->get_all();
-		// fprintf(stdout, "get_block_state: set=%zu way=%zu state=%d\n", set, way, blk_state);
-		return blk_state;
+		if(LBF_SIZE == 0)
+			return true;
+
+		auto const *states = &lbf[(set * ASSOC + way) * LBF_SIZE];
+		return std::find(states, states + LBF_SIZE, hmap::cReadFirst) != states + LBF_SIZE;
+	}
+
+	/*
+	* Same as set_state for every word of the line
+	*/
+	void set_line_state(size_t set, size_t way, const hmap::lbf_states& state)
+	{
+		auto const first = lbf.begin() + (set * ASSOC + way) * LBF_SIZE;
+		std::fill(first, first + std::min(WORDS, LBF_SIZE), state);
 	}
 
 	void clear_state(size_t set, size_t way)
 	{
-		// fprintf(stdout, "clear_state: set=%zu way=%zu\n", set, way);
-		if(LBF_SIZE > 0)
-			lbf_array[set][way]->clear();
+		auto const first = lbf.begin() + (set * ASSOC + way) * LBF_SIZE;
+		std::fill(first, first + LBF_SIZE, hmap::cUnknown);
 	}
 
 	/*
 	* Helper methods for querying various parameters of the cache
 	*/
 
+	replacement_policy get_policy() const
+	{
+		return POLICY;
+	}
+
 	const size_t get_numset()
 	{
 		return SET;
@@ -300,12 +302,22 @@ class cache {
 		return misses;
 	}
 
-	private:
+	protected:
+	// state bits below the tag in line_state
+	static constexpr uint64_t VALID = 1;
+	static constexpr uint64_t DIRTY = 2;
+	static constexpr uint64_t WF = 4;
+	static constexpr uint32_t TAG_SHIFT = 3;
+	// a lookup compares the tag and valid bit
+	static constexpr uint64_t MATCH_MASK = ~(DIRTY | WF);
+
+	const replacement_policy POLICY;
 	size_t ASSOC = 0;
 	size_t SET = 0;
 	const uint32_t BLOCK_SIZE;
 	const uint32_t CACHE_SIZE;
 	const size_t   LBF_SIZE;
+	size_t WORDS = 0;
 
 	uint32_t block_offset = 0;
 	uint32_t set_offset = 0;
@@ -314,25 +326,166 @@ class cache {
 	uint64_t hits = 0u;
 	uint64_t misses = 0u;
 
-	cache_block** tag_array = nullptr;
-	uint32_t** data_array = nullptr;
-	std::unique_ptr<hmap::hashmap>** lbf_array = nullptr; // lbf = local bloom filter
+	// per line: tag << TAG_SHIFT | WF | DIRTY | VALID
+	std::vector<uint64_t> line_state;
+	std::vector<uint32_t> line_address;
+	// WORDS words per line
+	std::vector<uint32_t> data;
+	// LBF_SIZE local bloom filter states per line, an hmap::lbf_states each
+	std::vector<uint8_t> lbf;
+
+	// the block number (address >> block_offset) of the line last hit or filled, NO_BLOCK if none,
+	// so runs of accesses to one line skip the tag scan; only inserts and flushes change lines
+	static constexpr uint64_t NO_BLOCK = UINT64_MAX;
+	uint64_t memo_block = NO_BLOCK;
+	size_t memo_set = 0;
+	size_t memo_way = 0;
+
+	void remember(uint32_t block, const cache_attr& attr)
+	{
+		memo_block = block;
+		memo_set = attr.set;
+		memo_way = attr.way;
+	}
+
+	// one bit per block (set * ASSOC + way) that is valid and dirty
+	std::vector<uint64_t> dirty_bitmap;
+	size_t num_dirty = 0;
 
-	uint32_t get_index(uint32_t beat, const cache_attr& attr)
+	void update_dirty(size_t set, size_t way)
 	{
-		return (BLOCK_SIZE >> 2) * attr.way + beat;
+		auto const line = set * ASSOC + way;
+		auto const mask = uint64_t(1) << (line % 64);
+		auto &word = dirty_bitmap[line / 64];
+
+		auto const was_dirty = (word & mask) != 0;
+		auto const is_dirty = (line_state[line] & (VALID | DIRTY)) == (VALID | DIRTY);
+		if(is_dirty && !was_dirty) {
+			word |= mask;
+			num_dirty++;
+		}
+		else if(!is_dirty && was_dirty) {
+			word &= ~mask;
+			num_dirty--;
+		}
 	}
+};
+
+/*
+* A cache with the replacement policy Policy, see replacement.hpp
+*/
+template <typename Policy>
+class policy_cache : public cache {
+
+	public:
+	policy_cache(replacement_policy policy, size_t assoc, uint32_t block_size, uint32_t cache_size, size_t lbf_size):
+	cache(policy, assoc, block_size, cache_size, lbf_size),
+	replacement(SET, ASSOC)
+	{}
 
-	void update_cnt(const cache_attr& attr)
+	cache_block get_victim(cache_attr& attr)
 	{
-		for(uint32_t i=0; i<ASSOC; i++) {
-			if(i != attr.way && tag_array[attr.set][i].get_valid() && (tag_array[attr.set][i].get_cnt() < ASSOC)) {
-				tag_array[attr.set][i].set_cnt(tag_array[attr.set][i].get_cnt() + 1);
+		auto const first = attr.set * ASSOC;
+		for(size_t i=0; i<ASSOC; i++) {
+			if((line_state[first + i] & VALID) == 0) {
+				attr.way = i;
+				return get_block(attr.set, attr.way);
 			}
 		}
-		tag_array[attr.set][attr.way].set_cnt(0);
+
+		attr.way = replacement.victim(attr.set);
+		return get_block(attr.set, attr.way);
 	}
+
+	cache_block cache_read(const cache_attr& attr, const bool false_read)
+	{
+		if(!false_read) {
+		  replacement.touch(attr.set, attr.way);
+		}
+		return get_block(attr.set, attr.way);
+	}
+
+	void cache_write(bool wf, const cache_attr& attr)
+	{
+		auto &state = line_state[attr.set * ASSOC + attr.way];
+		state |= DIRTY;
+		if(wf) {
+			state |= WF;
+		}
+		update_dirty(attr.set, attr.way);
+
+		replacement.touch(attr.set, attr.way);
+	}
+
+	void cache_insert(const cache_attr& attr, const cache_block& blk, const bool false_read)
+	{
+		auto const line = attr.set * ASSOC + attr.way;
+		line_state[line] = (uint64_t(blk.get_tag()) << TAG_SHIFT) | (blk.get_valid() ? VALID : 0)
+		                   | (blk.get_dirty() ? DIRTY : 0) | (blk.get_wf() ? WF : 0);
+		line_address[line] = blk.get_address();
+		update_dirty(attr.set, attr.way);
+		replacement.insert(attr.set, attr.way, !false_read);
+
+		if(blk.get_valid()) {
+			remember((blk.get_tag() << set_offset) | attr.set, attr);
+		}
+		else if(memo_set == attr.set && memo_way == attr.way) {
+			memo_block = NO_BLOCK;
+		}
+	}
+
+	private:
+	Policy replacement;
 };
+
+/*
+* Create a cache with a replacement policy
+*/
+inline std::shared_ptr<cache> make_cache(replacement_policy policy, size_t assoc, uint32_t block_size, uint32_t cache_size, size_t lbf_size)
+{
+	switch(policy) {
+	case replacement_policy::counter:
+		return std::make_shared<policy_cache<counter_policy>>(policy, assoc, block_size, cache_size, lbf_size);
+	case replacement_policy::lru:
+		return std::make_shared<policy_cache<lru_policy>>(policy, assoc, block_size, cache_size, lbf_size);
+	case replacement_policy::plru:
+		return std::make_shared<policy_cache<plru_policy>>(policy, assoc, block_size, cache_size, lbf_size);
+	case replacement_policy::fifo:
+		return std::make_shared<policy_cache<fifo_policy>>(policy, assoc, block_size, cache_size, lbf_size);
+	case replacement_policy::random:
+		return std::make_shared<policy_cache<random_policy>>(policy, assoc, block_size, cache_size, lbf_size);
+	case replacement_policy::srrip:
+		return std::make_shared<policy_cache<srrip_policy>>(policy, assoc, block_size, cache_size, lbf_size);
+	}
+
+	return nullptr;
+}
+
+/*
+* Call f with the cache as the policy_cache it was made as
+*
+* The switch is taken once per call, everything f does with the cache is compiled for its policy.
+*/
+template <typename Function>
+auto with_policy(cache& c, Function f) -> decltype(f(std::declval<policy_cache<counter_policy>&>()))
+{
+	switch(c.get_policy()) {
+	case replacement_policy::lru:
+		return f(static_cast<policy_cache<lru_policy>&>(c));
+	case replacement_policy::plru:
+		return f(static_cast<policy_cache<plru_policy>&>(c));
+	case replacement_policy::fifo:
+		return f(static_cast<policy_cache<fifo_policy>&>(c));
+	case replacement_policy::random:
+		return f(static_cast<policy_cache<random_policy>&>(c));
+	case replacement_policy::srrip:
+		return f(static_cast<policy_cache<srrip_policy>&>(c));
+	case replacement_policy::counter:
+		break;
+	}
+
+	return f(static_cast<policy_cache<counter_policy>&>(c));
+}
 }
 
 #endif // THUMBULATOR_CACHE_HPP
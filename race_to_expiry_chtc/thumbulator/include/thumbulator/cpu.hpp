@@ -49,33 +49,11 @@ struct cpu_state {
   uint32_t exceptmask;
 };
 
-/**
- * Informs fetch that previous instruction caused a control flow change
- */
-extern bool BRANCH_WAS_TAKEN;
-
-/**
- * Whether or not the exit instruction has been executed.
- */
-extern bool EXIT_INSTRUCTION_ENCOUNTERED;
-
-/**
- * If oracle backup policy is set for memory renaming
- */
-extern bool OPTIMAL_BACKUP_POLICY;
-
-/**
- * Enable mock execute, memory and write-back for optimal backup policy
- */
-extern bool mock_exmemwb; 
-
 /**
  * Resets the CPU according to the specification.
  */
 void cpu_reset();
 
-extern cpu_state cpu;
-
 /**
  * Get a general-purpose register.
  */
@@ -112,8 +90,6 @@ struct system_tick {
   uint32_t calib;
 };
 
-extern system_tick SYSTICK;
-
 /**
  * Cycles taken for branch instructions.
  */
@@ -144,6 +120,42 @@ extern system_tick SYSTICK;
  */
 uint32_t exmemwb(uint16_t instruction, decode_result const *decoded);
 
+/**
+ * Perform the execute, mem, and write-back stages of a predecoded instruction.
+ *
+ * Uses exmemwb_threaded when built with THUMBULATOR_THREADED_DISPATCH, exmemwb_table otherwise.
+ *
+ * @param predecoded The instruction returned by fetch_predecoded.
+ *
+ * @return The number of cycles taken.
+ */
+uint32_t exmemwb(predecoded_instruction const &predecoded);
+
+/**
+ * Execute a predecoded instruction by calling its resolved handler through a function pointer.
+ */
+uint32_t exmemwb_table(predecoded_instruction const &predecoded);
+
+/**
+ * Execute a predecoded instruction by jumping on its handler number, with computed goto where the
+ * compiler supports it (unless THUMBULATOR_PORTABLE_DISPATCH is defined) and a switch otherwise.
+ */
+uint32_t exmemwb_threaded(predecoded_instruction const &predecoded);
+
+/**
+ * Find the function executing an instruction, looking through all levels of the jump tables.
+ *
+ * @param instruction The instruction to execute.
+ */
+execute_function resolve_execute(uint16_t instruction);
+
+/**
+ * The number of the handler resolve_execute returns, looked up in a table over all encodings.
+ *
+ * @param instruction The instruction to execute.
+ */
+uint8_t resolve_handler(uint16_t instruction);
+
 /**
  * Perform a mock execute, mem and write-back (no change to cpu state and memory)
  *
@@ -42,6 +42,36 @@ struct decode_result {
   uint32_t register_list;
 };
 
+/**
+ * A function performing the execute, memory access, and write-back stage of one instruction.
+ */
+using execute_function = uint32_t (*)(decode_result const *);
+
+/**
+ * An instruction with its decode stage already done.
+ */
+struct predecoded_instruction {
+  /**
+   * The decode stage registers, for bl including the immediate from the second halfword.
+   */
+  decode_result decoded;
+
+  /**
+   * The handler resolved through all levels of the jump tables, nullptr if not decoded yet.
+   */
+  execute_function execute;
+
+  /**
+   * The number of the handler, used by the threaded core.
+   */
+  uint8_t handler;
+
+  /**
+   * The encoding of the (first halfword of the) instruction.
+   */
+  uint16_t instruction;
+};
+
 /**
  * Interface to the decode stage.
  *
@@ -49,6 +79,35 @@ struct decode_result {
  * @return The decode stage registers based upon the passed instruction.
  */
 decode_result decode(uint16_t instruction);
+
+/**
+ * Fetch and decode the instruction at an address.
+ *
+ * Instructions in flash are decoded on their first execution and served from the predecoded table
+ * afterwards. The instruction cache, if any, is accessed exactly as fetch and decode would.
+ *
+ * @param address The address of the instruction.
+ * @return The predecoded instruction, valid until the next call.
+ */
+predecoded_instruction const &fetch_predecoded(uint32_t address);
+
+/**
+ * Fetch an instruction replayed from an execution trace.
+ *
+ * Nothing is decoded, but the instruction cache, if any, is accessed exactly as fetch_predecoded
+ * would, so a replay sees the same instruction cache hits and misses as a live run.
+ *
+ * @param address The address of the instruction.
+ * @param instruction The recorded instruction.
+ */
+void fetch_replayed(uint32_t address, uint16_t instruction);
+
+/**
+ * Drop the predecoded instructions that depend on a word of flash.
+ *
+ * @param address The address of the word that changed.
+ */
+void invalidate_predecoded(uint32_t address);
 }
 
 #endif
@@ -0,0 +1,181 @@
+#ifndef THUMBULATOR_EXECUTION_TRACE_H
+#define THUMBULATOR_EXECUTION_TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace thumbulator {
+
+/**
+ * A data memory access made by an instruction, through load or store.
+ */
+struct trace_access {
+  enum kind : uint8_t {
+    load = 0,
+    // a load that does not reach the RAM hooks, e.g. the read of a byte store
+    false_load = 1,
+    store = 2
+  };
+
+  uint32_t address;
+
+  /**
+   * The value stored, zero for loads.
+   */
+  uint32_t value;
+
+  kind type;
+};
+
+/**
+ * One executed instruction.
+ */
+struct trace_record {
+  /**
+   * The address of the instruction.
+   */
+  uint32_t pc;
+
+  uint16_t instruction;
+
+  /**
+   * Bit i is set if the instruction wrote register i.
+   */
+  uint16_t registers_written;
+
+  /**
+   * The cycles returned by the execute stage.
+   */
+  uint32_t cycles;
+
+  /**
+   * The address exmemwb_mock reports for the instruction, 0xFFFFFFFF if it accesses no memory.
+   */
+  uint32_t probe_address;
+
+  std::vector<trace_access> accesses;
+};
+
+/**
+ * Writes the instructions a machine executes to a file.
+ *
+ * Each record is delta and varint encoded: the PC relative to the next sequential instruction, the
+ * addresses relative to the previous access, so straight-line code takes a few bytes per
+ * instruction.
+ */
+class trace_writer {
+public:
+  explicit trace_writer(std::string const &path_to_trace);
+
+  ~trace_writer();
+
+  trace_writer(trace_writer const &) = delete;
+  trace_writer &operator=(trace_writer const &) = delete;
+
+  /**
+   * Record a data access of the instruction being executed, see machine::trace_recorder.
+   */
+  void record_access(uint32_t address, uint32_t value, trace_access::kind type);
+
+  /**
+   * Record an executed instruction with the accesses recorded since the previous instruction.
+   */
+  void record_instruction(uint32_t pc,
+      uint16_t instruction,
+      uint16_t registers_written,
+      uint32_t cycles,
+      uint32_t probe_address);
+
+  /**
+   * Write the remaining records and the record count.
+   */
+  void close();
+
+  uint64_t num_records() const
+  {
+    return record_count;
+  }
+
+private:
+  std::FILE *file;
+  std::vector<uint8_t> buffer;
+  std::vector<trace_access> pending;
+  uint64_t record_count = 0;
+  uint32_t next_pc = 0;
+  uint32_t last_address = 0;
+
+  void put(uint64_t value);
+};
+
+/**
+ * The recorded instructions of one run, shared by any number of readers.
+ */
+class execution_trace {
+public:
+  explicit execution_trace(std::string const &path_to_trace);
+
+  uint64_t num_records() const
+  {
+    return record_count;
+  }
+
+private:
+  friend class trace_reader;
+
+  std::vector<uint8_t> data;
+  uint64_t record_count = 0;
+};
+
+/**
+ * Reads the records of a trace in order.
+ *
+ * The position can be saved and restored, to execute again from a checkpoint.
+ */
+class trace_reader {
+public:
+  struct position {
+    size_t offset;
+    uint32_t next_pc;
+    uint32_t last_address;
+  };
+
+  explicit trace_reader(execution_trace const &trace);
+
+  bool at_end() const
+  {
+    return current.offset >= trace.data.size();
+  }
+
+  /**
+   * Decode the next record, the reference is valid until the next call.
+   */
+  trace_record const &next();
+
+  /**
+   * The address of the next record, without consuming it.
+   */
+  uint32_t peek_pc() const;
+
+  position tell() const
+  {
+    return current;
+  }
+
+  void seek(position const &saved)
+  {
+    current = saved;
+  }
+
+private:
+  execution_trace const &trace;
+  position current;
+  trace_record record;
+
+  uint64_t get(size_t &offset) const;
+};
+}
+
+#endif //THUMBULATOR_EXECUTION_TRACE_H
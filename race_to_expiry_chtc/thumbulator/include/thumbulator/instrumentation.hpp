@@ -0,0 +1,172 @@
+#ifndef THUMBULATOR_INSTRUMENTATION_H
+#define THUMBULATOR_INSTRUMENTATION_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace thumbulator {
+namespace instrumentation {
+
+/**
+ * The stages of simulating an instruction that host time is attributed to.
+ */
+enum class stage : uint8_t {
+  // the simulation loop itself and everything not in another stage
+  loop,
+  fetch,
+  decode,
+  execute,
+  // the cache models, of instruction fetch and of data accesses
+  cache,
+  // the memory hooks a scheme installs into the machine
+  scheme_hooks,
+  // the scheme calls of the simulation loop besides energy: backup decisions, backup, restore
+  scheme,
+  liveness,
+  // the spendthrift backup policy
+  inference,
+  // consuming energy for instructions and harvesting it
+  energy,
+  count
+};
+
+constexpr auto NUM_STAGES = static_cast<size_t>(stage::count);
+
+char const *stage_name(stage timed);
+
+/**
+ * The host time spent in each stage on the calling thread, in ticks of read_tick.
+ */
+struct stage_counters {
+  uint64_t ticks[NUM_STAGES];
+
+  /**
+   * The number of times each stage was entered.
+   */
+  uint64_t calls[NUM_STAGES];
+
+  stage current;
+
+  /**
+   * When the time since was last attributed to the current stage.
+   */
+  uint64_t last_tick;
+};
+
+extern thread_local stage_counters counters;
+
+/**
+ * A cheap timestamp: the time stamp counter on x86, nanoseconds elsewhere.
+ */
+inline uint64_t read_tick()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+/**
+ * Attributes the host time of its scope to a stage.
+ *
+ * Time is exclusive: a scope nested in another stops the time of the outer stage until it ends,
+ * so the stages add up to the total. Without THUMBULATOR_INSTRUMENT the timer compiles to nothing.
+ */
+class scoped_timer {
+public:
+#ifdef THUMBULATOR_INSTRUMENT
+  explicit scoped_timer(stage timed)
+  {
+    auto const now = read_tick();
+    counters.ticks[static_cast<size_t>(counters.current)] += now - counters.last_tick;
+    counters.calls[static_cast<size_t>(timed)]++;
+    counters.last_tick = now;
+
+    previous = counters.current;
+    counters.current = timed;
+  }
+
+  ~scoped_timer()
+  {
+    auto const now = read_tick();
+    counters.ticks[static_cast<size_t>(counters.current)] += now - counters.last_tick;
+    counters.last_tick = now;
+
+    counters.current = previous;
+  }
+#else
+  explicit scoped_timer(stage)
+  {
+  }
+#endif
+
+  scoped_timer(scoped_timer const &) = delete;
+  scoped_timer &operator=(scoped_timer const &) = delete;
+
+private:
+#ifdef THUMBULATOR_INSTRUMENT
+  stage previous;
+#endif
+};
+
+/**
+ * Call a function and attribute its host time to a stage.
+ */
+template <typename Function>
+auto timed(stage timed_stage, Function function) -> decltype(function())
+{
+  scoped_timer timer(timed_stage);
+
+  return function();
+}
+
+/**
+ * Measures the stages of the calling thread over a part of the program, e.g. one simulation.
+ *
+ * Starting a session resets the counters of the thread; time outside of any timed scope is
+ * attributed to stage::loop.
+ */
+class session {
+public:
+  session();
+
+  /**
+   * Stop measuring, report and write_json describe the time until now.
+   */
+  void stop();
+
+  /**
+   * Print the host time per simulated instruction of each stage, after stop.
+   *
+   * @param instructions The number of instructions simulated during the session.
+   */
+  void report(std::ostream &stream, uint64_t instructions) const;
+
+  /**
+   * Write the breakdown as a JSON object, after stop.
+   */
+  void write_json(std::ostream &stream, uint64_t instructions) const;
+
+private:
+  std::chrono::steady_clock::time_point start_time;
+  uint64_t start_tick;
+
+  std::chrono::nanoseconds elapsed{0};
+  double ns_per_tick = 0;
+  stage_counters totals{};
+
+  double stage_ns(size_t index) const;
+};
+}
+}
+
+#endif //THUMBULATOR_INSTRUMENTATION_H
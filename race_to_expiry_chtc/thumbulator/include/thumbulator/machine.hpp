@@ -0,0 +1,285 @@
+#ifndef THUMBULATOR_MACHINE_H
+#define THUMBULATOR_MACHINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+
+#include "thumbulator/cpu.hpp"
+#include "thumbulator/memory.hpp"
+#include "thumbulator/paged_memory.hpp"
+
+namespace thumbulator {
+
+class stack_distance_profiler;
+class symbol_table;
+class trace_writer;
+
+/**
+ * Releases memory obtained with calloc.
+ */
+struct memory_deleter {
+  template <typename T>
+  void operator()(T *memory) const
+  {
+    std::free(memory);
+  }
+};
+
+using predecoded_array = std::unique_ptr<predecoded_instruction[], memory_deleter>;
+
+template <typename Signature>
+class memory_hook;
+
+/**
+ * A hook into the memory system, bound to a member function of an object.
+ *
+ * The member function is a template argument, so it is inlined into the thunk the hook calls and
+ * a hooked access costs one indirect call, instead of a std::function calling into a lambda calling
+ * into the object.
+ */
+template <typename Result, typename... Args>
+class memory_hook<Result(Args...)> {
+public:
+  memory_hook() = default;
+
+  memory_hook(std::nullptr_t)
+  {
+  }
+
+  /**
+   * Create a hook calling policy->*Method.
+   */
+  template <typename Policy, Result (Policy::*Method)(Args...)>
+  static memory_hook bind(Policy *policy)
+  {
+    memory_hook hook;
+    hook.object = policy;
+    hook.thunk = [](void *object, Args... args) -> Result {
+      return (static_cast<Policy *>(object)->*Method)(args...);
+    };
+
+    return hook;
+  }
+
+  Result operator()(Args... args) const
+  {
+    return thunk(object, args...);
+  }
+
+  bool operator==(std::nullptr_t) const
+  {
+    return thunk == nullptr;
+  }
+
+  bool operator!=(std::nullptr_t) const
+  {
+    return thunk != nullptr;
+  }
+
+private:
+  void *object = nullptr;
+  Result (*thunk)(void *, Args...) = nullptr;
+};
+
+using ram_load_function = memory_hook<uint32_t(uint32_t, uint32_t)>;
+
+using ram_store_function = memory_hook<uint32_t(uint32_t, uint32_t, uint32_t, bool)>;
+
+using ram_line_load_function = memory_hook<void(uint32_t, uint32_t *, size_t)>;
+
+using ram_line_store_function =
+    memory_hook<void(uint32_t, uint32_t const *, uint32_t *, size_t, bool)>;
+
+using cache_load_function = memory_hook<bool(cache_block &, uint32_t, bool, size_t, size_t)>;
+
+using cache_store_function =
+    memory_hook<bool(cache_block &, uint32_t, bool, size_t, size_t, bool &)>;
+
+/**
+ * All the state of one simulated machine.
+ *
+ * The free functions in cpu.hpp and memory.hpp operate on the machine that is active on the calling
+ * thread, see machine_scope. Independent machines can run on different threads at the same time.
+ */
+struct machine {
+  /**
+   * Create a machine with zeroed memories.
+   *
+   * RAM and flash are allocated by page on first write, so untouched memory costs nothing.
+   */
+  machine();
+
+  machine(machine const &) = delete;
+  machine &operator=(machine const &) = delete;
+
+  cpu_state cpu{};
+
+  system_tick systick{};
+
+  /**
+   * Informs fetch that previous instruction caused a control flow change
+   */
+  bool branch_was_taken = false;
+
+  /**
+   * Whether or not the exit instruction has been executed.
+   */
+  bool exit_instruction_encountered = false;
+
+  /**
+   * If oracle backup policy is set for memory renaming
+   */
+  bool optimal_backup_policy = false;
+
+  /**
+   * Enable mock execute, memory and write-back for optimal backup policy
+   */
+  bool mock_exmemwb = false;
+
+  /**
+   * The instruction currently being executed, used by the second-level jump tables.
+   */
+  uint16_t insn = 0;
+
+  /**
+   * Random-Access Memory, like SRAM, RAM_SIZE_ELEMENTS words.
+   */
+  paged_memory ram;
+
+  /**
+   * Read-Only Memory holding the application code, FLASH_SIZE_ELEMENTS words.
+   */
+  paged_memory flash;
+
+  /**
+   * The decoded instructions in flash, indexed by address / 2, filled on first execution.
+   */
+  predecoded_array predecoded;
+
+  /**
+   * The last decoded instruction that does not reside in flash.
+   */
+  predecoded_instruction uncached_instruction{};
+
+  /**
+   * Instruction Cache (SRAM)
+   */
+  std::shared_ptr<cache> icache;
+
+  /**
+   * Data Cache (SRAM)
+   */
+  std::shared_ptr<cache> dcache;
+
+  /**
+   * Renamer (Controller for map table and free list)
+   */
+  std::shared_ptr<rename> renamer;
+
+  bool icache_hit = false;
+  bool dcache_hit = false;
+
+  /**
+   * Hook into loads to RAM.
+   *
+   * The first parameter is the address.
+   * The second parameter is the data that would be loaded.
+   *
+   * The function returns the data that will be loaded, potentially different than the second parameter.
+   */
+  ram_load_function ram_load_hook;
+
+  /**
+   * Hook into stores to RAM.
+   *
+   * The first parameter is the address.
+   * The second parameter is the value at the address before the store.
+   * The third parameter is the desired value to store at the address.
+   * The fourth parameter distinguishes between a normal store and a backup store
+   *
+   * The function returns the data that will be stored, potentially different from the third parameter.
+   */
+  ram_store_function ram_store_hook;
+
+  /**
+   * Hook into cache lines filled from RAM, called once per line instead of ram_load_hook per word.
+   *
+   * The first parameter is the address of the line.
+   * The second parameter is the data that would be loaded, which the function may change.
+   * The third parameter is the number of words in the line.
+   *
+   * Without it, lines are filled word by word through ram_load_hook, if that is set.
+   */
+  ram_line_load_function ram_line_load_hook;
+
+  /**
+   * Hook into cache lines written back to RAM, called once per line instead of ram_store_hook per
+   * word.
+   *
+   * The first parameter is the address of the line.
+   * The second parameter is the data in RAM before the store.
+   * The third parameter is the data to store, which the function may change.
+   * The fourth parameter is the number of words in the line.
+   * The fifth parameter distinguishes between a normal store and a backup store.
+   *
+   * Without it, lines are written back word by word through ram_store_hook, if that is set.
+   */
+  ram_line_store_function ram_line_store_hook;
+
+  cache_load_function cache_load_hook;
+  cache_store_function cache_store_hook;
+
+  /**
+   * Receives the data accesses of executed instructions when recording an execution trace.
+   */
+  trace_writer *trace_recorder = nullptr;
+
+  /**
+   * Receive the instruction fetches and the RAM data accesses of the program, to profile every cache
+   * geometry in one run. They do not need a cache to be modeled.
+   */
+  stack_distance_profiler *icache_profiler = nullptr;
+  stack_distance_profiler *dcache_profiler = nullptr;
+
+  /**
+   * The symbols of the program, nullptr if unknown, see install_program.
+   */
+  symbol_table const *symbols = nullptr;
+};
+
+extern thread_local machine *current_machine;
+
+/**
+ * The machine the free functions operate on in this thread.
+ */
+inline machine &active_machine()
+{
+  return *current_machine;
+}
+
+/**
+ * Makes a machine active on the calling thread for the lifetime of the scope.
+ */
+class machine_scope {
+public:
+  explicit machine_scope(machine &active) : previous(current_machine)
+  {
+    current_machine = &active;
+  }
+
+  ~machine_scope()
+  {
+    current_machine = previous;
+  }
+
+  machine_scope(machine_scope const &) = delete;
+  machine_scope &operator=(machine_scope const &) = delete;
+
+private:
+  machine *previous;
+};
+}
+
+#endif //THUMBULATOR_MACHINE_H
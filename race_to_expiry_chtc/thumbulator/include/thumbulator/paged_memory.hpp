@@ -0,0 +1,139 @@
+#ifndef THUMBULATOR_PAGED_MEMORY_H
+#define THUMBULATOR_PAGED_MEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace thumbulator {
+
+/**
+ * A word-addressed memory whose pages are allocated on their first write.
+ *
+ * Unwritten pages read as zero and cost one null pointer in the page table, so a machine only holds
+ * the pages the program touches. The last page read and the last page written are kept as direct
+ * pointers, so accesses that stay within a page skip the page table.
+ *
+ * Written pages are tracked as dirty until clear_dirty, for checkpoints that only save what changed.
+ */
+class paged_memory {
+public:
+  static constexpr size_t PAGE_SIZE_BYTES = 4096;
+  static constexpr size_t PAGE_SIZE_WORDS = PAGE_SIZE_BYTES >> 2;
+
+  /**
+   * Create a zeroed memory.
+   *
+   * @param size_words The size of the memory in 32-bit words.
+   */
+  explicit paged_memory(size_t size_words);
+
+  paged_memory(paged_memory const &) = delete;
+  paged_memory &operator=(paged_memory const &) = delete;
+
+  /**
+   * Read the word at an index, which must be within the memory.
+   */
+  uint32_t read(size_t index) const
+  {
+    auto const page = index / PAGE_SIZE_WORDS;
+    if(page != last_read_page) {
+      auto const words = pages[page].get();
+      if(words == nullptr) {
+        return 0;
+      }
+
+      last_read_page = page;
+      last_read_words = words;
+    }
+
+    return last_read_words[index % PAGE_SIZE_WORDS];
+  }
+
+  /**
+   * Read consecutive words, e.g. a cache line.
+   */
+  void read(size_t first, uint32_t *words, size_t count) const;
+
+  /**
+   * Write the word at an index, which must be within the memory.
+   */
+  void write(size_t index, uint32_t value)
+  {
+    auto const page = index / PAGE_SIZE_WORDS;
+    if(page != last_written_page) {
+      last_written_words = dirty_page(page);
+      last_written_page = page;
+    }
+
+    last_written_words[index % PAGE_SIZE_WORDS] = value;
+  }
+
+  /**
+   * Write consecutive words, e.g. a program image.
+   */
+  void write(size_t first, uint32_t const *words, size_t count);
+
+  /**
+   * The pages written since the memory was created or clear_dirty was last called.
+   *
+   * Page i holds the words [i * PAGE_SIZE_WORDS, (i + 1) * PAGE_SIZE_WORDS), listed in the order they
+   * were first written.
+   */
+  std::vector<size_t> const &dirty_pages() const
+  {
+    return dirty_list;
+  }
+
+  /**
+   * The words of a page, nullptr if it was never written.
+   */
+  uint32_t const *page_words(size_t page) const
+  {
+    return pages[page].get();
+  }
+
+  /**
+   * Start tracking dirty pages anew, at a checkpoint.
+   */
+  void clear_dirty();
+
+  /**
+   * Zero the memory, releasing every allocated page.
+   *
+   * Takes time proportional to the allocated pages, not to the size of the memory.
+   */
+  void reset();
+
+  size_t num_allocated_pages() const
+  {
+    return allocated.size();
+  }
+
+private:
+  static constexpr size_t NO_PAGE = SIZE_MAX;
+
+  std::vector<std::unique_ptr<uint32_t[]>> pages;
+
+  // the allocated pages, so a reset does not walk the page table
+  std::vector<size_t> allocated;
+
+  std::vector<bool> dirty;
+  std::vector<size_t> dirty_list;
+
+  mutable size_t last_read_page = NO_PAGE;
+  mutable uint32_t const *last_read_words = nullptr;
+
+  // always a dirty page, so writes to it need no bookkeeping
+  size_t last_written_page = NO_PAGE;
+  uint32_t *last_written_words = nullptr;
+
+  /**
+   * Allocate a page if needed and mark it dirty.
+   */
+  uint32_t *dirty_page(size_t page);
+};
+}
+
+#endif //THUMBULATOR_PAGED_MEMORY_H
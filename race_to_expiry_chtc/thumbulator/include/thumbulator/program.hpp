@@ -0,0 +1,110 @@
+#ifndef THUMBULATOR_PROGRAM_H
+#define THUMBULATOR_PROGRAM_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace thumbulator {
+
+struct machine;
+
+/**
+ * A function or data object of a program.
+ */
+struct program_symbol {
+  /**
+   * The first address, without the Thumb bit for functions.
+   */
+  uint32_t address;
+
+  /**
+   * The size in bytes, 0 if unknown.
+   */
+  uint32_t size;
+
+  bool is_function;
+
+  std::string name;
+};
+
+/**
+ * The symbols of a program, to name the code and data at an address.
+ */
+class symbol_table {
+public:
+  void add(program_symbol symbol);
+
+  /**
+   * The symbol whose extent contains an address, nullptr if there is none.
+   */
+  program_symbol const *find(uint32_t address) const;
+
+  /**
+   * Name an address as symbol+offset, or give it in hex if no symbol contains it.
+   */
+  std::string describe(uint32_t address) const;
+
+  /**
+   * All symbols, sorted by address.
+   */
+  std::vector<program_symbol> const &all() const
+  {
+    return symbols;
+  }
+
+  bool empty() const
+  {
+    return symbols.empty();
+  }
+
+private:
+  std::vector<program_symbol> symbols;
+};
+
+/**
+ * The contents of a program as placed in the memories of a machine.
+ */
+struct program_image {
+  /**
+   * Data to place in RAM before the program starts.
+   */
+  struct ram_segment {
+    uint32_t address;
+    std::vector<uint8_t> bytes;
+  };
+
+  /**
+   * The flash from address 0 up to the end of the last segment placed in flash.
+   */
+  std::vector<uint32_t> flash;
+
+  std::vector<ram_segment> ram;
+
+  /**
+   * Empty for raw flash images.
+   */
+  symbol_table symbols;
+};
+
+/**
+ * Load an application, either an ARM ELF executable or a raw flash image.
+ *
+ * Of an ELF file only the PT_LOAD segments are loaded, at their physical (load) address, which is
+ * what programming the file into the device would do. The zero-initialized remainder of a segment
+ * is not stored, memories of a new machine read as zero. The symbol table is kept.
+ *
+ * @param path_to_binary The path to the application.
+ */
+program_image load_program(std::string const &path_to_binary);
+
+/**
+ * Place a program in the memories of a new machine.
+ *
+ * The machine refers to the symbols of the image for error messages, so the image has to outlive
+ * the simulation.
+ */
+void install_program(machine &target, program_image const &program);
+}
+
+#endif //THUMBULATOR_PROGRAM_H
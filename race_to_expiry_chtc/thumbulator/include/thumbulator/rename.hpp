@@ -1,6 +1,7 @@
 #ifndef THUMBULATOR_RENAME_HPP
 #define THUMBULATOR_RENAME_HPP
 
+#include <cstdio>
 #include <deque>
 
 namespace thumbulator {
@@ -0,0 +1,395 @@
+#ifndef THUMBULATOR_REPLACEMENT_HPP
+#define THUMBULATOR_REPLACEMENT_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace thumbulator {
+
+/**
+ * The replacement policies a cache can be built with, see make_cache.
+ */
+enum class replacement_policy : uint8_t {
+  // saturating age counters, the policy of the original cache model
+  counter,
+  lru,
+  plru,
+  fifo,
+  random,
+  srrip
+};
+
+inline replacement_policy parse_replacement_policy(std::string const &name)
+{
+  if(name == "counter") {
+    return replacement_policy::counter;
+  } else if(name == "lru") {
+    return replacement_policy::lru;
+  } else if(name == "plru") {
+    return replacement_policy::plru;
+  } else if(name == "fifo") {
+    return replacement_policy::fifo;
+  } else if(name == "random") {
+    return replacement_policy::random;
+  } else if(name == "srrip") {
+    return replacement_policy::srrip;
+  }
+
+  throw std::runtime_error(
+      "Unknown cache replacement policy: " + name + " (counter, lru, plru, fifo, random, srrip)");
+}
+
+/*
+ * Every policy keeps the replacement state of all sets and implements:
+ *
+ *   void touch(size_t set, size_t way)
+ *     A valid line was read or written by the program.
+ *   void insert(size_t set, size_t way, bool touched)
+ *     A line was filled, touched is false for fills by reads other than the program's.
+ *   size_t victim(size_t set)
+ *     The way to evict when every way of the set is valid; the cache itself prefers invalid ways.
+ *
+ * None of them scans the ways on a hit.
+ */
+
+/**
+ * Saturating age counters: a way ages by one on every access to another way of its set, up to the
+ * associativity, and the oldest way is evicted, the lowest on a tie.
+ *
+ * Ages are kept as the access count of the set when a way was last used, so a hit is O(1) and
+ * eviction decisions match the original per-way counters exactly.
+ */
+class counter_policy {
+public:
+  counter_policy(size_t sets, size_t ways)
+      : WAYS(ways)
+      , clock(sets, 0)
+      , last_use(sets * ways, 0)
+  {
+  }
+
+  void touch(size_t set, size_t way)
+  {
+    last_use[set * WAYS + way] = ++clock[set];
+  }
+
+  void insert(size_t set, size_t way, bool touched)
+  {
+    if(touched) {
+      touch(set, way);
+    } else {
+      // age 0 without aging the other ways
+      last_use[set * WAYS + way] = clock[set];
+    }
+  }
+
+  size_t victim(size_t set) const
+  {
+    auto const *ways = &last_use[set * WAYS];
+    size_t oldest = 0;
+    uint64_t oldest_age = 0;
+    for(size_t way = 0; way < WAYS; ++way) {
+      auto const age = std::min<uint64_t>(clock[set] - ways[way], WAYS);
+      if(age > oldest_age) {
+        oldest = way;
+        oldest_age = age;
+      }
+    }
+
+    return oldest;
+  }
+
+private:
+  size_t const WAYS;
+  std::vector<uint64_t> clock;
+  std::vector<uint64_t> last_use;
+};
+
+/**
+ * True least recently used.
+ *
+ * Up to 8 ways, each set is a recency bit matrix in one word: row i has bit j set if way i was used
+ * after way j, so the LRU way is the zero row, found with a bit-parallel zero-byte search. Larger
+ * sets keep a per-set access count and evict the way with the oldest use.
+ */
+class lru_policy {
+public:
+  lru_policy(size_t sets, size_t ways)
+      : WAYS(ways)
+      , matrix(ways <= 8 ? sets : 0, 0)
+      , clock(ways > 8 ? sets : 0, 0)
+      , last_use(ways > 8 ? sets * ways : 0, 0)
+  {
+    // rows of missing ways are never the LRU row
+    for(size_t way = WAYS; way < 8; ++way) {
+      unused_rows |= uint64_t(0xFF) << (8 * way);
+    }
+    for(size_t way = 0; way < std::min<size_t>(WAYS, 8); ++way) {
+      column |= uint64_t(1) << (8 * way);
+    }
+  }
+
+  void touch(size_t set, size_t way)
+  {
+    if(WAYS <= 8) {
+      auto &rows = matrix[set];
+      rows |= (row_mask() << (8 * way));
+      rows &= ~(column << way);
+    } else {
+      last_use[set * WAYS + way] = ++clock[set];
+    }
+  }
+
+  void insert(size_t set, size_t way, bool)
+  {
+    touch(set, way);
+  }
+
+  size_t victim(size_t set) const
+  {
+    if(WAYS <= 8) {
+      auto const rows = matrix[set] | unused_rows;
+      auto const zero_bytes = (rows - 0x0101010101010101ull) & ~rows & 0x8080808080808080ull;
+
+      return __builtin_ctzll(zero_bytes) / 8;
+    }
+
+    auto const *ways = &last_use[set * WAYS];
+    size_t oldest = 0;
+    for(size_t way = 1; way < WAYS; ++way) {
+      if(ways[way] < ways[oldest]) {
+        oldest = way;
+      }
+    }
+
+    return oldest;
+  }
+
+private:
+  size_t const WAYS;
+  std::vector<uint64_t> matrix;
+  uint64_t unused_rows = 0;
+  // bit 0 of every used row
+  uint64_t column = 0;
+
+  std::vector<uint64_t> clock;
+  std::vector<uint64_t> last_use;
+
+  uint64_t row_mask() const
+  {
+    return (uint64_t(1) << WAYS) - 1;
+  }
+};
+
+/**
+ * Tree pseudo-LRU: a binary tree per set whose nodes point away from the most recently used half.
+ *
+ * Needs a power of two ways, up to 64.
+ */
+class plru_policy {
+public:
+  plru_policy(size_t sets, size_t ways)
+      : WAYS(ways)
+      , tree(sets, 0)
+  {
+    if(WAYS == 0 || WAYS > 64 || (WAYS & (WAYS - 1)) != 0) {
+      throw std::runtime_error("Tree PLRU needs a power of two ways, up to 64.");
+    }
+  }
+
+  void touch(size_t set, size_t way)
+  {
+    auto &nodes = tree[set];
+    // node 1 is the root, the children of node n are 2n and 2n + 1
+    size_t node = 1;
+    for(auto half = WAYS / 2; half > 0; half /= 2) {
+      auto const right = (way & half) != 0;
+      if(right) {
+        nodes &= ~(uint64_t(1) << node);
+      } else {
+        nodes |= uint64_t(1) << node;
+      }
+      node = 2 * node + right;
+    }
+  }
+
+  void insert(size_t set, size_t way, bool)
+  {
+    touch(set, way);
+  }
+
+  size_t victim(size_t set) const
+  {
+    auto const nodes = tree[set];
+    size_t node = 1;
+    size_t way = 0;
+    for(auto half = WAYS / 2; half > 0; half /= 2) {
+      auto const right = (nodes >> node) & 1;
+      way |= right ? half : 0;
+      node = 2 * node + right;
+    }
+
+    return way;
+  }
+
+private:
+  size_t const WAYS;
+  // bit n is node n, set if the victim is in its right half
+  std::vector<uint64_t> tree;
+};
+
+/**
+ * First in, first out: the ways of a set are replaced round-robin, hits do not matter.
+ */
+class fifo_policy {
+public:
+  fifo_policy(size_t sets, size_t ways)
+      : WAYS(ways)
+      , next(sets, 0)
+  {
+  }
+
+  void touch(size_t, size_t)
+  {
+  }
+
+  void insert(size_t set, size_t way, bool)
+  {
+    if(way == next[set]) {
+      next[set] = way + 1 == WAYS ? 0 : way + 1;
+    }
+  }
+
+  size_t victim(size_t set) const
+  {
+    return next[set];
+  }
+
+private:
+  size_t const WAYS;
+  std::vector<uint32_t> next;
+};
+
+/**
+ * Uniformly random victims, from a fixed seed so runs are repeatable.
+ */
+class random_policy {
+public:
+  random_policy(size_t, size_t ways)
+      : WAYS(ways)
+  {
+  }
+
+  void touch(size_t, size_t)
+  {
+  }
+
+  void insert(size_t, size_t, bool)
+  {
+  }
+
+  size_t victim(size_t)
+  {
+    // xorshift64
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    return state % WAYS;
+  }
+
+private:
+  size_t const WAYS;
+  uint64_t state = 0x9E3779B97F4A7C15ull;
+};
+
+/**
+ * Static re-reference interval prediction with 2-bit predictions (Jaleel et al., ISCA 2010).
+ *
+ * Hits predict a near re-reference (0), fills a long one (2), and the victim is the first way with a
+ * distant prediction (3) after aging the whole set until there is one. The predictions of 32 ways
+ * are packed in a word, so finding and aging are bit-parallel.
+ */
+class srrip_policy {
+public:
+  srrip_policy(size_t sets, size_t ways)
+      : WAYS(ways)
+      , WORDS((ways + 31) / 32)
+      , predictions(sets * WORDS, 0)
+  {
+  }
+
+  void touch(size_t set, size_t way)
+  {
+    set_prediction(set, way, 0);
+  }
+
+  void insert(size_t set, size_t way, bool)
+  {
+    set_prediction(set, way, 2);
+  }
+
+  size_t victim(size_t set)
+  {
+    auto *words = &predictions[set * WORDS];
+
+    uint64_t highest = 0;
+    for(size_t word = 0; word < WORDS; ++word) {
+      auto const fields = words[word];
+      auto const used = used_fields(word);
+      if((fields & (fields >> 1) & used) != 0) {
+        highest = 3;
+        break;
+      }
+      if((fields >> 1) & used) {
+        highest = 2;
+      } else if(highest == 0 && (fields & used) != 0) {
+        highest = 1;
+      }
+    }
+
+    // age every way by the same amount, no field goes past 3
+    if(highest < 3) {
+      for(size_t word = 0; word < WORDS; ++word) {
+        words[word] += (3 - highest) * used_fields(word);
+      }
+    }
+
+    for(size_t word = 0; word < WORDS; ++word) {
+      auto const distant = words[word] & (words[word] >> 1) & used_fields(word);
+      if(distant != 0) {
+        return word * 32 + __builtin_ctzll(distant) / 2;
+      }
+    }
+
+    return 0;
+  }
+
+private:
+  size_t const WAYS;
+  size_t const WORDS;
+  std::vector<uint64_t> predictions;
+
+  // the low bit of every field in use in a word
+  uint64_t used_fields(size_t word) const
+  {
+    auto const ways = std::min<size_t>(WAYS - word * 32, 32);
+    auto const all = ways == 32 ? ~uint64_t(0) : (uint64_t(1) << (2 * ways)) - 1;
+
+    return all & 0x5555555555555555ull;
+  }
+
+  void set_prediction(size_t set, size_t way, uint64_t prediction)
+  {
+    auto &word = predictions[set * WORDS + way / 32];
+    auto const shift = 2 * (way % 32);
+    word = (word & ~(uint64_t(3) << shift)) | (prediction << shift);
+  }
+};
+}
+
+#endif //THUMBULATOR_REPLACEMENT_HPP
@@ -0,0 +1,153 @@
+#ifndef THUMBULATOR_STACK_DISTANCE_H
+#define THUMBULATOR_STACK_DISTANCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace thumbulator {
+
+/**
+ * The hits, misses and write-backs of one cache geometry over a profiled run.
+ */
+struct cache_profile_point {
+  uint32_t size = 0;
+  size_t sets = 0;
+  size_t ways = 0;
+
+  uint64_t load_hits = 0;
+  uint64_t load_misses = 0;
+  uint64_t store_hits = 0;
+  uint64_t store_misses = 0;
+
+  /**
+   * Dirty lines evicted.
+   */
+  uint64_t writebacks = 0;
+
+  uint64_t hits() const
+  {
+    return load_hits + store_hits;
+  }
+
+  uint64_t misses() const
+  {
+    return load_misses + store_misses;
+  }
+
+  double miss_ratio() const
+  {
+    auto const accesses = hits() + misses();
+    return accesses > 0 ? static_cast<double>(misses()) / accesses : 0.0;
+  }
+};
+
+/**
+ * Profiles the accesses of a run for every LRU cache geometry at once (Mattson et al., 1970).
+ *
+ * Each set of an LRU cache is a stack ordered by recency, and a cache with more ways holds the top
+ * of the same stack, so the depth an access is found at tells which associativities hit. With
+ * bit-selection indexing, the sets of a cache also refine the sets of any cache with fewer (Hill
+ * and Smith, 1989). Keeping the stacks for every power of two sets therefore gives the hits of every
+ * size and associativity with the same line size from one run.
+ *
+ * Write-backs are counted with the stacks as well: a line remembers the shallowest depth it is
+ * clean at, and a dirty line sinking out of the top w entries is a write-back of the cache with w
+ * ways. Caches write back and allocate on stores, as thumbulator's cache does.
+ *
+ * The profile matches the hits of a cache with the lru replacement policy exactly, and approximates
+ * the other policies. It sees the accesses of the program only, as if the cache kept its contents
+ * through power failures.
+ */
+class stack_distance_profiler {
+public:
+  /**
+   * Profile the caches with a line size, up to a cache size.
+   *
+   * @param block_size The line size in bytes, a power of two.
+   * @param max_cache_size The largest cache profiled in bytes, a power of two.
+   * @param max_assoc The most ways profiled, 0 for any number up to a fully-associative cache.
+   *
+   * Profiling takes time proportional to the depth of the stacks, so limit max_assoc when larger
+   * associativities are not of interest.
+   */
+  stack_distance_profiler(uint32_t block_size, uint32_t max_cache_size, size_t max_assoc = 0);
+
+  /**
+   * The program accessed memory.
+   *
+   * @param address The address accessed.
+   * @param write true for a store.
+   */
+  void access(uint32_t address, bool write);
+
+  /**
+   * The caches of one associativity, from the smallest to the largest size profiled.
+   *
+   * @param ways The number of ways, 0 for fully-associative caches.
+   */
+  std::vector<cache_profile_point> miss_curve(size_t ways) const;
+
+  uint32_t get_block_size() const
+  {
+    return BLOCK_SIZE;
+  }
+
+  /**
+   * The most ways a curve can have, at one set.
+   */
+  size_t get_max_assoc() const
+  {
+    return levels.front().depth;
+  }
+
+  uint64_t get_num_loads() const
+  {
+    return loads;
+  }
+
+  uint64_t get_num_stores() const
+  {
+    return stores;
+  }
+
+private:
+  static constexpr uint32_t CLEAN = UINT32_MAX;
+
+  /**
+   * The LRU stacks of the caches with one number of sets.
+   */
+  struct level {
+    size_t sets;
+    size_t depth;
+
+    // depth blocks per set, most recent first, and how many are in use
+    std::vector<uint32_t> blocks;
+    std::vector<uint32_t> in_use;
+
+    // per entry: the line is dirty in the caches with more ways than this, CLEAN if in none
+    std::vector<uint32_t> clean_depth;
+
+    // accesses found at each depth
+    std::vector<uint64_t> load_hits;
+    std::vector<uint64_t> store_hits;
+
+    // dirty lines sinking to each depth, i.e. written back by the cache with that many ways
+    std::vector<uint64_t> writebacks;
+  };
+
+  uint32_t const BLOCK_SIZE;
+  uint32_t const MAX_CACHE_SIZE;
+  uint32_t block_offset = 0;
+
+  uint64_t loads = 0;
+  uint64_t stores = 0;
+
+  // level k has 2^k sets
+  std::vector<level> levels;
+
+  cache_profile_point point(level const &stacks, size_t ways) const;
+};
+}
+
+#endif //THUMBULATOR_STACK_DISTANCE_H
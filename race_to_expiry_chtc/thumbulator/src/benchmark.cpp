@@ -0,0 +1,306 @@
+#include "thumbulator/benchmark.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace thumbulator {
+namespace benchmark {
+
+namespace {
+
+/**
+ * What a benchmark process reports back to the parent.
+ */
+struct child_report {
+  uint64_t instructions;
+  double startup_ms;
+  double run_ms;
+};
+
+// startup takes milliseconds, so a relative threshold alone would fail on scheduling noise
+constexpr double STARTUP_SLACK_MS = 1.0;
+
+measurement run_once(std::string const &name, std::function<void(measurement &)> const &job)
+{
+  int channel[2];
+  if(pipe(channel) != 0) {
+    throw std::runtime_error("Could not create a pipe for benchmark " + name + ".");
+  }
+
+  // buffered output would be written again by the child
+  std::cout.flush();
+  std::cerr.flush();
+
+  auto const child = fork();
+  if(child < 0) {
+    close(channel[0]);
+    close(channel[1]);
+    throw std::runtime_error("Could not fork a process for benchmark " + name + ".");
+  }
+
+  if(child == 0) {
+    close(channel[0]);
+
+    auto succeeded = false;
+    try {
+      measurement measured;
+      measured.name = name;
+      job(measured);
+
+      child_report const report{measured.instructions, measured.startup_ms, measured.run_ms};
+      succeeded = write(channel[1], &report, sizeof(report)) == sizeof(report);
+    } catch(std::exception const &e) {
+      std::cerr << name << ": " << e.what() << "\n";
+    }
+
+    std::cout.flush();
+    std::cerr.flush();
+    // skip the destructors and exit handlers of the parent's state
+    _exit(succeeded ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  close(channel[1]);
+  child_report report{};
+  auto const received = read(channel[0], &report, sizeof(report));
+  close(channel[0]);
+
+  int status = 0;
+  struct rusage usage {};
+  while(wait4(child, &status, 0, &usage) < 0) {
+    if(errno != EINTR) {
+      throw std::runtime_error("Lost track of the process of benchmark " + name + ".");
+    }
+  }
+
+  if(!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS || received != sizeof(report)) {
+    throw std::runtime_error("Benchmark " + name + " failed.");
+  }
+
+  measurement measured;
+  measured.name = name;
+  measured.instructions = report.instructions;
+  measured.startup_ms = report.startup_ms;
+  measured.run_ms = report.run_ms;
+  // kilobytes on Linux
+  measured.peak_rss_kb = usage.ru_maxrss;
+
+  return measured;
+}
+
+double growth(double value, double baseline)
+{
+  return baseline > 0 ? 100.0 * (value - baseline) / baseline : 0.0;
+}
+
+std::string escape(std::string const &text)
+{
+  std::string escaped;
+  for(auto const c : text) {
+    if(c == '"' || c == '\\') {
+      escaped += '\\';
+    }
+    escaped += c;
+  }
+
+  return escaped;
+}
+
+/**
+ * The string value of a key in a line written by write_json, false if the key is missing.
+ */
+bool find_string(std::string const &line, std::string const &key, std::string &value)
+{
+  auto position = line.find("\"" + key + "\":");
+  if(position == std::string::npos) {
+    return false;
+  }
+  position = line.find('"', position + key.size() + 3);
+  if(position == std::string::npos) {
+    return false;
+  }
+
+  value.clear();
+  for(++position; position < line.size() && line[position] != '"'; ++position) {
+    if(line[position] == '\\' && position + 1 < line.size()) {
+      ++position;
+    }
+    value += line[position];
+  }
+
+  return position < line.size();
+}
+
+double find_number(std::string const &line, std::string const &key)
+{
+  auto const position = line.find("\"" + key + "\":");
+  if(position == std::string::npos) {
+    throw std::runtime_error("Baseline entry without " + key + ": " + line);
+  }
+
+  return std::strtod(line.c_str() + position + key.size() + 3, nullptr);
+}
+}
+
+double measurement::mips() const
+{
+  return run_ms > 0 ? instructions / (run_ms * 1e3) : 0.0;
+}
+
+double measurement::ns_per_instruction() const
+{
+  return instructions > 0 ? run_ms * 1e6 / instructions : 0.0;
+}
+
+measurement run_isolated(std::string const &name,
+    std::function<void(measurement &)> const &job,
+    unsigned repetitions)
+{
+  auto best = run_once(name, job);
+  for(unsigned i = 1; i < repetitions; ++i) {
+    auto const again = run_once(name, job);
+    best.startup_ms = std::min(best.startup_ms, again.startup_ms);
+    best.run_ms = std::min(best.run_ms, again.run_ms);
+    best.peak_rss_kb = std::min(best.peak_rss_kb, again.peak_rss_kb);
+  }
+
+  return best;
+}
+
+void print_table(std::ostream &stream, std::vector<measurement> const &results)
+{
+  size_t name_width = 9;
+  for(auto const &result : results) {
+    name_width = std::max(name_width, result.name.size());
+  }
+
+  stream << std::left << std::setw(name_width) << "benchmark" << std::right << std::setw(14)
+         << "instructions" << std::setw(10) << "MIPS" << std::setw(10) << "ns/insn" << std::setw(12)
+         << "startup ms" << std::setw(12) << "peak RSS kB" << "\n";
+  for(auto const &result : results) {
+    stream << std::left << std::setw(name_width) << result.name << std::right << std::setw(14)
+           << result.instructions << std::fixed << std::setprecision(2) << std::setw(10)
+           << result.mips() << std::setw(10) << result.ns_per_instruction() << std::setw(12)
+           << result.startup_ms << std::setw(12) << result.peak_rss_kb << "\n";
+  }
+}
+
+void write_json(std::ostream &stream, std::vector<measurement> const &results)
+{
+  stream << "{\n  \"benchmarks\": [\n";
+  for(size_t i = 0; i < results.size(); ++i) {
+    auto const &result = results[i];
+    stream << std::fixed << std::setprecision(3) << "    {\"name\": \"" << escape(result.name)
+           << "\", \"instructions\": " << result.instructions
+           << ", \"startup_ms\": " << result.startup_ms << ", \"run_ms\": " << result.run_ms
+           << ", \"mips\": " << result.mips()
+           << ", \"ns_per_instruction\": " << result.ns_per_instruction()
+           << ", \"peak_rss_kb\": " << result.peak_rss_kb << "}"
+           << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  stream << "  ]\n}\n";
+}
+
+std::vector<measurement> read_json(std::string const &path_to_baseline)
+{
+  std::ifstream baseline(path_to_baseline);
+  if(!baseline.good()) {
+    throw std::runtime_error("Could not open benchmark baseline: " + path_to_baseline);
+  }
+
+  std::vector<measurement> results;
+  std::string line;
+  while(std::getline(baseline, line)) {
+    measurement result;
+    if(!find_string(line, "name", result.name)) {
+      continue;
+    }
+
+    result.instructions = static_cast<uint64_t>(find_number(line, "instructions"));
+    result.startup_ms = find_number(line, "startup_ms");
+    result.run_ms = find_number(line, "run_ms");
+    result.peak_rss_kb = static_cast<long>(find_number(line, "peak_rss_kb"));
+    results.push_back(result);
+  }
+
+  if(results.empty()) {
+    throw std::runtime_error("No benchmarks in baseline: " + path_to_baseline);
+  }
+
+  return results;
+}
+
+size_t compare(std::vector<measurement> const &results,
+    std::vector<measurement> const &baseline,
+    double threshold,
+    std::ostream &report)
+{
+  size_t num_regressed = 0;
+
+  report << std::fixed << std::setprecision(1);
+  for(auto const &result : results) {
+    auto const previous = std::find_if(baseline.begin(), baseline.end(),
+        [&](measurement const &m) { return m.name == result.name; });
+    if(previous == baseline.end()) {
+      report << result.name << ": new, not in the baseline\n";
+      continue;
+    }
+
+    auto const speed = growth(result.ns_per_instruction(), previous->ns_per_instruction());
+    auto const startup = growth(result.startup_ms, previous->startup_ms);
+    auto const memory = growth(result.peak_rss_kb, previous->peak_rss_kb);
+
+    std::vector<std::string> regressions;
+    if(result.instructions != previous->instructions) {
+      regressions.push_back("simulated " + std::to_string(result.instructions)
+                            + " instructions instead of "
+                            + std::to_string(previous->instructions));
+    }
+    if(speed > threshold) {
+      regressions.push_back("ns per instruction");
+    }
+    if(startup > threshold && result.startup_ms - previous->startup_ms > STARTUP_SLACK_MS) {
+      regressions.push_back("startup");
+    }
+    if(memory > threshold) {
+      regressions.push_back("peak RSS");
+    }
+
+    report << result.name << ": ns/insn " << std::showpos << speed << "%, startup " << startup
+           << "%, peak RSS " << memory << "%" << std::noshowpos;
+    if(regressions.empty()) {
+      report << "\n";
+      continue;
+    }
+
+    num_regressed++;
+    report << "  REGRESSED:";
+    for(size_t i = 0; i < regressions.size(); ++i) {
+      report << (i == 0 ? " " : ", ") << regressions[i];
+    }
+    report << "\n";
+  }
+
+  // a benchmark that stopped running would otherwise pass unnoticed
+  for(auto const &previous : baseline) {
+    auto const result = std::find_if(results.begin(), results.end(),
+        [&](measurement const &m) { return m.name == previous.name; });
+    if(result == results.end()) {
+      num_regressed++;
+      report << previous.name << ": missing, in the baseline but not run  REGRESSED\n";
+    }
+  }
+
+  return num_regressed;
+}
+}
+}
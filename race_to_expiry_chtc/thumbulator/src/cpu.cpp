@@ -1,5 +1,7 @@
 #include "thumbulator/cpu.hpp"
 
+#include "thumbulator/instrumentation.hpp"
+#include "thumbulator/machine.hpp"
 #include "thumbulator/memory.hpp"
 #include "cpu_flags.hpp"
 #include "exit.hpp"
@@ -8,18 +10,13 @@
 
 namespace thumbulator {
 
-uint16_t insn;
-
-bool BRANCH_WAS_TAKEN = false;
-bool EXIT_INSTRUCTION_ENCOUNTERED = false;
-bool OPTIMAL_BACKUP_POLICY = false;
-bool mock_exmemwb = false;
-
 // Reset CPU state in accordance with B1.5.5 and B3.2.2
 void cpu_reset()
 {
   constexpr auto ESPR_T = (1 << 24);
 
+  auto &cpu = active_machine().cpu;
+
   // Initialize the special-purpose registers
   cpu.apsr = 0;       // No flags set
   cpu.ipsr = 0;       // No exception number
@@ -58,37 +55,37 @@ void cpu_reset()
   }
 
   // Reset the SYSTICK unit
-  SYSTICK.control = 0x4;
-  SYSTICK.reload = 0x0;
-  SYSTICK.value = 0x0;
-  SYSTICK.calib = CPU_FREQ / 100 | 0x80000000;
+  auto &systick = active_machine().systick;
+  systick.control = 0x4;
+  systick.reload = 0x0;
+  systick.value = 0x0;
+  systick.calib = CPU_FREQ / 100 | 0x80000000;
 }
 
 uint32_t cpu_get_gpr(uint8_t x)
 {
-  return cpu.gpr[x][0];
+  return active_machine().cpu.gpr[x][0];
 }
 
 bool cpu_get_gpr_dbit(uint8_t x)
 {
-  return cpu.gpr[x][1];
+  return active_machine().cpu.gpr[x][1];
 }
 
 void cpu_set_gpr(uint8_t x, uint32_t y)
 {
+  auto &cpu = active_machine().cpu;
   cpu.gpr[x][0] = y;
   cpu.gpr[x][1] = 1;
 }
 
 void cpu_clear_gpr_dbit()
 {
+  auto &cpu = active_machine().cpu;
   for (uint8_t x=0; x<16; x++)
     cpu.gpr[x][1] = 0;
 }
 
-cpu_state cpu;
-system_tick SYSTICK;
-
 uint32_t adcs(decode_result const *);
 uint32_t adds_i3(decode_result const *);
 uint32_t adds_i8(decode_result const *);
@@ -166,11 +163,35 @@ uint32_t exmemwb_error(decode_result const *decoded)
 
 uint32_t exmemwb_exit_simulation(decode_result const *decoded)
 {
-  EXIT_INSTRUCTION_ENCOUNTERED = true;
+  active_machine().exit_instruction_encountered = true;
 
   return 0;
 }
 
+// Every function that executes an instruction, used to number the handlers for the threaded core
+#define FOR_EACH_HANDLER(X) \
+  X(adcs) X(adds_i3) X(adds_i8) X(adds_r) X(add_r) X(add_sp) X(adr) X(subs_i3) X(subs_i8) \
+  X(subs) X(sub_sp) X(sbcs) X(rsbs) X(muls) X(cmn) X(cmp_i) X(cmp_r) X(tst) X(b) X(b_c) X(blx) \
+  X(bx) X(bl) X(ands) X(bics) X(eors) X(orrs) X(mvns) X(asrs_i) X(asrs_r) X(lsls_i) X(lsrs_i) \
+  X(lsls_r) X(lsrs_r) X(rors) X(ldm) X(stm) X(pop) X(push) X(ldr_i) X(ldr_sp) X(ldr_lit) \
+  X(ldr_r) X(ldrb_i) X(ldrb_r) X(ldrh_i) X(ldrh_r) X(ldrsb_r) X(ldrsh_r) X(str_i) X(str_sp) \
+  X(str_r) X(strb_i) X(strb_r) X(strh_i) X(strh_r) X(movs_i) X(mov_r) X(movs_r) X(sxtb) X(sxth) \
+  X(uxtb) X(uxth) X(rev) X(rev16) X(revsh) X(breakpoint) X(exmemwb_error) \
+  X(exmemwb_exit_simulation)
+
+enum handler_id : uint8_t {
+#define HANDLER_ID(name) id_##name,
+  FOR_EACH_HANDLER(HANDLER_ID)
+#undef HANDLER_ID
+  NUM_HANDLERS
+};
+
+execute_function const handlers[NUM_HANDLERS] = {
+#define HANDLER_FUNCTION(name) name,
+    FOR_EACH_HANDLER(HANDLER_FUNCTION)
+#undef HANDLER_FUNCTION
+};
+
 // Execute functions that require more opcode bits than the first 6
 uint32_t (*executeJumpTable6[2])(decode_result const *) = {
     adds_r, /* 060 - 067 */
@@ -179,7 +200,7 @@ uint32_t (*executeJumpTable6[2])(decode_result const *) = {
 
 uint32_t entry6(decode_result const *decoded)
 {
-  return executeJumpTable6[(insn >> 9) & 0x1](decoded);
+  return executeJumpTable6[(active_machine().insn >> 9) & 0x1](decoded);
 }
 
 uint32_t (*executeJumpTable7[2])(decode_result const *) = {
@@ -189,7 +210,7 @@ uint32_t (*executeJumpTable7[2])(decode_result const *) = {
 
 uint32_t entry7(decode_result const *decoded)
 {
-  return executeJumpTable7[(insn >> 9) & 0x1](decoded);
+  return executeJumpTable7[(active_machine().insn >> 9) & 0x1](decoded);
 }
 
 uint32_t (*executeJumpTable16[16])(decode_result const *) = {ands, eors, lsls_r, lsrs_r, asrs_r,
@@ -197,7 +218,7 @@ uint32_t (*executeJumpTable16[16])(decode_result const *) = {ands, eors, lsls_r,
 
 uint32_t entry16(decode_result const *decoded)
 {
-  return executeJumpTable16[(insn >> 6) & 0xF](decoded);
+  return executeJumpTable16[(active_machine().insn >> 6) & 0xF](decoded);
 }
 
 uint32_t (*executeJumpTable17[8])(decode_result const *) = {
@@ -210,7 +231,7 @@ uint32_t (*executeJumpTable17[8])(decode_result const *) = {
 
 uint32_t entry17(decode_result const *decoded)
 {
-  return executeJumpTable17[(insn >> 7) & 0x7](decoded);
+  return executeJumpTable17[(active_machine().insn >> 7) & 0x7](decoded);
 }
 
 uint32_t (*executeJumpTable20[2])(decode_result const *) = {
@@ -220,7 +241,7 @@ uint32_t (*executeJumpTable20[2])(decode_result const *) = {
 
 uint32_t entry20(decode_result const *decoded)
 {
-  return executeJumpTable20[(insn >> 9) & 0x1](decoded);
+  return executeJumpTable20[(active_machine().insn >> 9) & 0x1](decoded);
 }
 
 uint32_t (*executeJumpTable21[2])(decode_result const *) = {
@@ -230,7 +251,7 @@ uint32_t (*executeJumpTable21[2])(decode_result const *) = {
 
 uint32_t entry21(decode_result const *decoded)
 {
-  return executeJumpTable21[(insn >> 9) & 0x1](decoded);
+  return executeJumpTable21[(active_machine().insn >> 9) & 0x1](decoded);
 }
 
 uint32_t (*executeJumpTable22[2])(decode_result const *) = {
@@ -240,7 +261,7 @@ uint32_t (*executeJumpTable22[2])(decode_result const *) = {
 
 uint32_t entry22(decode_result const *decoded)
 {
-  return executeJumpTable22[(insn >> 9) & 0x1](decoded);
+  return executeJumpTable22[(active_machine().insn >> 9) & 0x1](decoded);
 }
 
 uint32_t (*executeJumpTable23[2])(decode_result const *) = {
@@ -250,7 +271,7 @@ uint32_t (*executeJumpTable23[2])(decode_result const *) = {
 
 uint32_t entry23(decode_result const *decoded)
 {
-  return executeJumpTable23[(insn >> 9) & 0x1](decoded);
+  return executeJumpTable23[(active_machine().insn >> 9) & 0x1](decoded);
 }
 
 uint32_t (*executeJumpTable44[16])(decode_result const *) = {add_sp, /* (2C0 - 2C1) */
@@ -260,7 +281,7 @@ uint32_t (*executeJumpTable44[16])(decode_result const *) = {add_sp, /* (2C0 - 2
 
 uint32_t entry44(decode_result const *decoded)
 {
-  return executeJumpTable44[(insn >> 6) & 0xF](decoded);
+  return executeJumpTable44[(active_machine().insn >> 6) & 0xF](decoded);
 }
 
 uint32_t (*executeJumpTable46[16])(decode_result const *) = {exmemwb_error, exmemwb_error,
@@ -270,7 +291,7 @@ uint32_t (*executeJumpTable46[16])(decode_result const *) = {exmemwb_error, exme
 
 uint32_t entry46(decode_result const *decoded)
 {
-  return executeJumpTable46[(insn >> 6) & 0xF](decoded);
+  return executeJumpTable46[(active_machine().insn >> 6) & 0xF](decoded);
 }
 
 uint32_t (*executeJumpTable47[2])(decode_result const *) = {
@@ -280,11 +301,12 @@ uint32_t (*executeJumpTable47[2])(decode_result const *) = {
 
 uint32_t entry47(decode_result const *decoded)
 {
-  return executeJumpTable47[(insn >> 9) & 0x1](decoded);
+  return executeJumpTable47[(active_machine().insn >> 9) & 0x1](decoded);
 }
 
 uint32_t entry55(decode_result const *decoded)
 {
+  auto const insn = active_machine().insn;
   if((insn & 0x0300) != 0x0300) {
     return b_c(decoded);
   }
@@ -314,30 +336,144 @@ uint32_t (*executeJumpTable[64])(decode_result const *) = {lsls_i, lsls_i, lsrs_
     bl,                                                                /* 61 ignore udef */
     exmemwb_error, exmemwb_error};
 
+execute_function resolve_execute(uint16_t instruction)
+{
+  switch(instruction >> 10) {
+    case 6: return executeJumpTable6[(instruction >> 9) & 0x1];
+    case 7: return executeJumpTable7[(instruction >> 9) & 0x1];
+    case 16: return executeJumpTable16[(instruction >> 6) & 0xF];
+    case 17: return executeJumpTable17[(instruction >> 7) & 0x7];
+    case 20: return executeJumpTable20[(instruction >> 9) & 0x1];
+    case 21: return executeJumpTable21[(instruction >> 9) & 0x1];
+    case 22: return executeJumpTable22[(instruction >> 9) & 0x1];
+    case 23: return executeJumpTable23[(instruction >> 9) & 0x1];
+    case 44: return executeJumpTable44[(instruction >> 6) & 0xF];
+    case 46: return executeJumpTable46[(instruction >> 6) & 0xF];
+    case 47: return executeJumpTable47[(instruction >> 9) & 0x1];
+    case 55:
+      if((instruction & 0x0300) != 0x0300) {
+        return b_c;
+      }
+
+      if(instruction == 0xDF01) {
+        return exmemwb_exit_simulation;
+      }
+
+      return exmemwb_error;
+    default: return executeJumpTable[instruction >> 10];
+  }
+}
+
+// Update the SYSTICK unit and look for resets
+void update_systick(uint32_t insnTicks)
+{
+  auto &systick = active_machine().systick;
+  if(systick.control & 0x1) {
+    if(insnTicks >= systick.value) {
+      // Ignore resets due to reads
+      if(systick.value > 0)
+        systick.control |= 0x00010000;
+
+      systick.value = systick.reload - insnTicks + systick.value;
+    } else
+      systick.value -= insnTicks;
+  }
+}
+
 uint32_t exmemwb(uint16_t instruction, decode_result const *decoded)
 {
-  insn = instruction;
+  active_machine().insn = instruction;
   // fprintf(stdout, "%x\n", insn);
 
   uint32_t insnTicks = executeJumpTable[instruction >> 10](decoded);
+  update_systick(insnTicks);
 
-  // Update the SYSTICK unit and look for resets
-  if(SYSTICK.control & 0x1) {
-    if(insnTicks >= SYSTICK.value) {
-      // Ignore resets due to reads
-      if(SYSTICK.value > 0)
-        SYSTICK.control |= 0x00010000;
+  return insnTicks;
+}
 
-      SYSTICK.value = SYSTICK.reload - insnTicks + SYSTICK.value;
-    } else
-      SYSTICK.value -= insnTicks;
+uint8_t resolve_handler(uint16_t instruction)
+{
+  // resolve every encoding through the jump tables once, so both cores agree by construction
+  static auto const *const table = [] {
+    static uint8_t resolved[0x10000];
+    for(uint32_t encoding = 0; encoding < 0x10000; ++encoding) {
+      auto const execute = resolve_execute(static_cast<uint16_t>(encoding));
+      resolved[encoding] = id_exmemwb_error;
+      for(uint8_t id = 0; id < NUM_HANDLERS; ++id) {
+        if(handlers[id] == execute) {
+          resolved[encoding] = id;
+          break;
+        }
+      }
+    }
+
+    return resolved;
+  }();
+
+  return table[instruction];
+}
+
+uint32_t exmemwb_table(predecoded_instruction const &predecoded)
+{
+  // the handler is already resolved, so the second-level tables and insn are not needed
+  uint32_t insnTicks = predecoded.execute(&predecoded.decoded);
+  update_systick(insnTicks);
+
+  return insnTicks;
+}
+
+uint32_t exmemwb_threaded(predecoded_instruction const &predecoded)
+{
+  auto const decoded = &predecoded.decoded;
+  uint32_t insnTicks;
+
+#if defined(__GNUC__) && !defined(THUMBULATOR_PORTABLE_DISPATCH)
+  static void *const targets[NUM_HANDLERS] = {
+#define HANDLER_TARGET(name) &&execute_##name,
+      FOR_EACH_HANDLER(HANDLER_TARGET)
+#undef HANDLER_TARGET
+  };
+
+  goto *targets[predecoded.handler];
+
+#define HANDLER_LABEL(name)     \
+  execute_##name:               \
+  insnTicks = name(decoded);    \
+  goto executed;
+  FOR_EACH_HANDLER(HANDLER_LABEL)
+#undef HANDLER_LABEL
+
+executed:
+#else
+  switch(predecoded.handler) {
+#define HANDLER_CASE(name)     \
+  case id_##name:              \
+    insnTicks = name(decoded); \
+    break;
+    FOR_EACH_HANDLER(HANDLER_CASE)
+#undef HANDLER_CASE
+    default: insnTicks = exmemwb_error(decoded); break;
   }
+#endif
+
+  update_systick(insnTicks);
 
   return insnTicks;
 }
 
+uint32_t exmemwb(predecoded_instruction const &predecoded)
+{
+  instrumentation::scoped_timer timer(instrumentation::stage::execute);
+#ifdef THUMBULATOR_THREADED_DISPATCH
+  return exmemwb_threaded(predecoded);
+#else
+  return exmemwb_table(predecoded);
+#endif
+}
+
 uint32_t exmemwb_mock(uint16_t instruction, decode_result const *decoded, bool& mem_write, bool& mem_op, bool& branch, bool& branch_link, uint32_t& numMemAccess)
 {
+  auto &insn = active_machine().insn;
   insn = instruction >> 10;
   //fprintf(stdout, "%x\n", insn);
 
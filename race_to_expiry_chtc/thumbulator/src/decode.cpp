@@ -1,6 +1,8 @@
 #include "thumbulator/decode.hpp"
 
 #include "thumbulator/cpu.hpp"
+#include "thumbulator/instrumentation.hpp"
+#include "thumbulator/machine.hpp"
 #include "thumbulator/memory.hpp"
 
 #include "cpu_flags.hpp"
@@ -133,13 +135,10 @@ decode_result decode_push(const uint16_t pInsn)
   return decoded;
 }
 
-decode_result decode_bl(const uint16_t pInsn)
+decode_result decode_bl(const uint16_t pInsn, const uint16_t secondHalf)
 {
   decode_result decoded;
 
-  uint16_t secondHalf;
-  fetch_instruction(cpu_get_pc() - 0x2, &secondHalf);
-
   uint32_t S = (pInsn >> 10) & 0x1;
   uint32_t J1 = (secondHalf >> 13) & 0x1;
   uint32_t J2 = (secondHalf >> 11) & 0x1;
@@ -153,6 +152,14 @@ decode_result decode_bl(const uint16_t pInsn)
   return decoded;
 }
 
+decode_result decode_bl(const uint16_t pInsn)
+{
+  uint16_t secondHalf;
+  fetch_instruction(cpu_get_pc() - 0x2, &secondHalf);
+
+  return decode_bl(pInsn, secondHalf);
+}
+
 decode_result decode_1all(const uint16_t pInsn)
 {
   decode_result decoded;
@@ -176,8 +183,8 @@ decode_result decode_mov_r(const uint16_t pInsn)
 // Stop simulation if we cannot decode the instruction
 decode_result decode_error(const uint16_t pInsn)
 {
-  fprintf(stderr, "Error: Malformed instruction: Unable to decode: 0x%4.4X at 0x%08X\n", pInsn,
-      cpu_get_pc() - 4);
+  fprintf(stderr, "Error: Malformed instruction: Unable to decode: 0x%4.4X at 0x%08X%s\n", pInsn,
+      cpu_get_pc() - 4, describe_address(cpu_get_pc() - 4).c_str());
   terminate_simulation(1);
 }
 
@@ -200,15 +207,15 @@ decode_result (*decodeJumpTable47[4])(const uint16_t pInsn) = {
 
 decode_result decode_17(const uint16_t pInsn)
 {
-  decodeJumpTable17[(pInsn >> 8) & 0x3](pInsn);
+  return decodeJumpTable17[(pInsn >> 8) & 0x3](pInsn);
 }
 decode_result decode_44(const uint16_t pInsn)
 {
-  decodeJumpTable44[(pInsn >> 8) & 0x3](pInsn);
+  return decodeJumpTable44[(pInsn >> 8) & 0x3](pInsn);
 }
 decode_result decode_47(const uint16_t pInsn)
 {
-  decodeJumpTable47[(pInsn >> 8) & 0x3](pInsn);
+  return decodeJumpTable47[(pInsn >> 8) & 0x3](pInsn);
 }
 
 // Use a table of function pointers indexed by the instruction
@@ -241,4 +248,98 @@ decode_result decode(const uint16_t instruction)
 {
   return decodeJumpTable[instruction >> 10](instruction);
 }
+
+bool is_bl(const uint16_t instruction)
+{
+  return (instruction >> 11) == 0x1E;
+}
+
+uint16_t flash_halfword(uint32_t address)
+{
+  if(address >= (FLASH_START + FLASH_SIZE_BYTES)) {
+    fprintf(stderr, "Error: ILF Memory access out of range: 0x%8.8X, pc=%x%s\n", address,
+        cpu_get_pc(), describe_address(cpu_get_pc() - 4).c_str());
+    terminate_simulation(1);
+  }
+
+  auto const word = active_machine().flash.read((address & FLASH_ADDRESS_MASK) >> 2);
+  return ((address & 0x2) != 0) ? (uint16_t)(word >> 16) : (uint16_t)word;
+}
+
+predecoded_instruction const &fetch_predecoded(const uint32_t address)
+{
+  instrumentation::scoped_timer timer(instrumentation::stage::fetch);
+  auto &active = active_machine();
+
+  if(address >= (FLASH_START + FLASH_SIZE_BYTES)) {
+    // code outside of flash may change at any time, decode it on every execution
+    auto &uncached = active.uncached_instruction;
+    fetch_instruction(address, &uncached.instruction);
+    instrumentation::scoped_timer decode_timer(instrumentation::stage::decode);
+    uncached.decoded = decode(uncached.instruction);
+    uncached.execute = resolve_execute(uncached.instruction);
+    uncached.handler = resolve_handler(uncached.instruction);
+
+    return uncached;
+  }
+
+  uint16_t instruction;
+  if(active.icache || active.icache_profiler != nullptr) {
+    // keep the modeled instruction cache in the same state as a real fetch would
+    fetch_instruction(address, &instruction);
+  }
+
+  auto &predecoded = active.predecoded[address >> 1];
+  if(predecoded.execute == nullptr) {
+    instrumentation::scoped_timer decode_timer(instrumentation::stage::decode);
+    predecoded.instruction = flash_halfword(address);
+    if(is_bl(predecoded.instruction)) {
+      predecoded.decoded = decode_bl(predecoded.instruction, flash_halfword(address + 0x2));
+    } else {
+      predecoded.decoded = decode(predecoded.instruction);
+    }
+    predecoded.handler = resolve_handler(predecoded.instruction);
+    predecoded.execute = resolve_execute(predecoded.instruction);
+  }
+
+  if((active.icache || active.icache_profiler != nullptr) && is_bl(predecoded.instruction)) {
+    // decoding bl fetches the second halfword
+    uint16_t second_half;
+    fetch_instruction(address + 0x2, &second_half);
+  }
+
+  return predecoded;
+}
+
+void fetch_replayed(const uint32_t address, const uint16_t instruction)
+{
+  instrumentation::scoped_timer timer(instrumentation::stage::fetch);
+  auto &active = active_machine();
+
+  // code outside of flash is fetched on every execution, code in flash only for the cache
+  if(address < (FLASH_START + FLASH_SIZE_BYTES) && !active.icache
+      && active.icache_profiler == nullptr) {
+    return;
+  }
+
+  uint16_t fetched;
+  fetch_instruction(address, &fetched);
+  if(is_bl(instruction)) {
+    // decoding bl fetches the second halfword
+    fetch_instruction(address + 0x2, &fetched);
+  }
+}
+
+void invalidate_predecoded(const uint32_t address)
+{
+  auto &active = active_machine();
+  auto const first = (address & FLASH_ADDRESS_MASK & ~0x3u) >> 1;
+
+  // a bl starting in the halfword before the word also depends on it
+  if(first > 0) {
+    active.predecoded[first - 1].execute = nullptr;
+  }
+  active.predecoded[first].execute = nullptr;
+  active.predecoded[first + 1].execute = nullptr;
+}
 }
@@ -0,0 +1,198 @@
+#include "thumbulator/execution_trace.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace thumbulator {
+
+namespace {
+
+char const MAGIC[4] = {'T', 'H', 'X', 'T'};
+constexpr uint32_t VERSION = 1;
+
+// magic, version, record count
+constexpr size_t HEADER_SIZE = 16;
+constexpr size_t RECORD_COUNT_OFFSET = 8;
+
+constexpr size_t FLUSH_THRESHOLD = 1 << 16;
+
+uint32_t zigzag(uint32_t value, uint32_t reference)
+{
+  auto const delta = static_cast<int32_t>(value - reference);
+  return (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31);
+}
+
+uint32_t unzigzag(uint32_t encoded, uint32_t reference)
+{
+  return reference + ((encoded >> 1) ^ (0u - (encoded & 1)));
+}
+}
+
+trace_writer::trace_writer(std::string const &path_to_trace)
+    : file(std::fopen(path_to_trace.c_str(), "wb"))
+{
+  if(file == nullptr) {
+    throw std::runtime_error("Could not create execution trace: " + path_to_trace);
+  }
+
+  uint8_t header[HEADER_SIZE] = {};
+  std::memcpy(header, MAGIC, sizeof(MAGIC));
+  std::memcpy(header + sizeof(MAGIC), &VERSION, sizeof(VERSION));
+  std::fwrite(header, 1, sizeof(header), file);
+}
+
+trace_writer::~trace_writer()
+{
+  if(file != nullptr) {
+    try {
+      close();
+    } catch(std::exception const &) {
+      // write errors are only reported by an explicit close
+    }
+  }
+}
+
+void trace_writer::put(uint64_t value)
+{
+  while(value >= 0x80) {
+    buffer.push_back(static_cast<uint8_t>(value) | 0x80);
+    value >>= 7;
+  }
+  buffer.push_back(static_cast<uint8_t>(value));
+}
+
+void trace_writer::record_access(uint32_t address, uint32_t value, trace_access::kind type)
+{
+  pending.push_back({address, type == trace_access::store ? value : 0, type});
+}
+
+void trace_writer::record_instruction(uint32_t pc,
+    uint16_t instruction,
+    uint16_t registers_written,
+    uint32_t cycles,
+    uint32_t probe_address)
+{
+  auto const has_probe = probe_address != 0xFFFFFFFF;
+
+  put(zigzag(pc, next_pc));
+  put(instruction);
+  put(registers_written);
+  put(cycles);
+  put((static_cast<uint64_t>(pending.size()) << 1) | (has_probe ? 1 : 0));
+  if(has_probe) {
+    put(zigzag(probe_address, last_address));
+  }
+
+  for(auto const &access : pending) {
+    put((static_cast<uint64_t>(zigzag(access.address, last_address)) << 2) | access.type);
+    if(access.type == trace_access::store) {
+      put(access.value);
+    }
+    last_address = access.address;
+  }
+  pending.clear();
+
+  next_pc = pc + 2;
+  record_count++;
+
+  if(buffer.size() >= FLUSH_THRESHOLD) {
+    std::fwrite(buffer.data(), 1, buffer.size(), file);
+    buffer.clear();
+  }
+}
+
+void trace_writer::close()
+{
+  std::fwrite(buffer.data(), 1, buffer.size(), file);
+  buffer.clear();
+
+  std::fseek(file, RECORD_COUNT_OFFSET, SEEK_SET);
+  std::fwrite(&record_count, sizeof(record_count), 1, file);
+
+  auto const failed = std::ferror(file) != 0;
+  std::fclose(file);
+  file = nullptr;
+
+  if(failed) {
+    throw std::runtime_error("Could not write execution trace.");
+  }
+}
+
+execution_trace::execution_trace(std::string const &path_to_trace)
+{
+  std::FILE *file = std::fopen(path_to_trace.c_str(), "rb");
+  if(file == nullptr) {
+    throw std::runtime_error("Could not open execution trace: " + path_to_trace);
+  }
+
+  uint8_t header[HEADER_SIZE];
+  uint32_t version = 0;
+  auto const header_read = std::fread(header, 1, sizeof(header), file) == sizeof(header);
+  if(header_read) {
+    std::memcpy(&version, header + sizeof(MAGIC), sizeof(version));
+  }
+
+  if(!header_read || std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0 || version != VERSION) {
+    std::fclose(file);
+    throw std::runtime_error("Not a supported execution trace: " + path_to_trace);
+  }
+  std::memcpy(&record_count, header + RECORD_COUNT_OFFSET, sizeof(record_count));
+
+  uint8_t chunk[FLUSH_THRESHOLD];
+  size_t bytes_read;
+  while((bytes_read = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+    data.insert(data.end(), chunk, chunk + bytes_read);
+  }
+  std::fclose(file);
+}
+
+trace_reader::trace_reader(execution_trace const &trace) : trace(trace), current{0, 0, 0}
+{
+}
+
+uint64_t trace_reader::get(size_t &offset) const
+{
+  uint64_t value = 0;
+  for(unsigned shift = 0; offset < trace.data.size(); shift += 7) {
+    auto const byte = trace.data[offset++];
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+
+  throw std::runtime_error("Truncated execution trace.");
+}
+
+trace_record const &trace_reader::next()
+{
+  auto &offset = current.offset;
+
+  record.pc = unzigzag(get(offset), current.next_pc);
+  record.instruction = get(offset);
+  record.registers_written = get(offset);
+  record.cycles = get(offset);
+
+  auto const accesses = get(offset);
+  record.probe_address =
+      (accesses & 1) != 0 ? unzigzag(get(offset), current.last_address) : 0xFFFFFFFF;
+
+  record.accesses.resize(accesses >> 1);
+  for(auto &access : record.accesses) {
+    auto const encoded = get(offset);
+    access.address = unzigzag(encoded >> 2, current.last_address);
+    access.type = static_cast<trace_access::kind>(encoded & 0x3);
+    access.value = access.type == trace_access::store ? get(offset) : 0;
+    current.last_address = access.address;
+  }
+
+  current.next_pc = record.pc + 2;
+  return record;
+}
+
+uint32_t trace_reader::peek_pc() const
+{
+  auto offset = current.offset;
+  return unzigzag(get(offset), current.next_pc);
+}
+}
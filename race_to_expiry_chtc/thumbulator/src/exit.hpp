@@ -1,20 +1,28 @@
 #ifndef THUMBULATOR_EXIT_HPP
 #define THUMBULATOR_EXIT_HPP
 
+#include <cstdint>
 #include <cstdio>
-#include <cstdlib>
+#include <stdexcept>
+#include <string>
 
 namespace thumbulator {
 
+/**
+ * " in function+offset" for an address of the active machine's program, empty without symbols.
+ */
+std::string describe_address(uint32_t address);
+
 /**
  * Terminate the simulation prematurely.
  *
- * Use this on a fatal error.
+ * Use this on a fatal error. Throws instead of exiting so other simulations in the same process
+ * keep running.
  */
 inline void terminate_simulation(int exit_code)
 {
-  printf("Simulation was terminated prematurely.\n");
-  exit(exit_code);
+  throw std::runtime_error(
+      "Simulation was terminated prematurely (exit code " + std::to_string(exit_code) + ").");
 }
 }
 #endif //THUMBULATOR_EXIT_HPP
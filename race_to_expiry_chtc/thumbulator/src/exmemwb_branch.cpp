@@ -82,7 +82,7 @@ uint32_t b(decode_result const *decoded)
 
   uint32_t result = offset + cpu_get_pc();
   cpu_set_pc(result);
-  BRANCH_WAS_TAKEN = 1;
+  active_machine().branch_was_taken = 1;
 
   return TIMING_BRANCH;
 }
@@ -177,7 +177,7 @@ uint32_t b_c(decode_result const *decoded)
   uint32_t pc = cpu_get_pc();
   uint32_t result = offset + pc;
   cpu_set_pc(result);
-  BRANCH_WAS_TAKEN = 1;
+  active_machine().branch_was_taken = 1;
 
   return TIMING_BRANCH;
 }
@@ -196,7 +196,7 @@ uint32_t blx(decode_result const *decoded)
 
   cpu_set_lr(cpu_get_pc() - 0x2);
   cpu_set_pc(address);
-  BRANCH_WAS_TAKEN = 1;
+  active_machine().branch_was_taken = 1;
 
   return TIMING_BRANCH;
 }
@@ -220,7 +220,7 @@ uint32_t bx(decode_result const *decoded)
     cpu_set_pc(address);
   }
 
-  BRANCH_WAS_TAKEN = 1;
+  active_machine().branch_was_taken = 1;
 
   return TIMING_BRANCH;
 }
@@ -237,7 +237,7 @@ uint32_t bl(decode_result const *decoded)
 
   cpu_set_lr(cpu_get_pc());
   cpu_set_pc(result);
-  BRANCH_WAS_TAKEN = 1;
+  active_machine().branch_was_taken = 1;
 
   return TIMING_BRANCH_LINK;
 }
@@ -11,14 +11,14 @@ namespace thumbulator {
 // LDM - Load multiple registers from the stack
 uint32_t ldm(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("ldm r%u!, {0x%X}\n", decoded->Rn, decoded->register_list);
 
   uint32_t numLoaded = 0;
   uint32_t rNWritten = (1 << decoded->Rn) & decoded->register_list;
   uint32_t address = cpu_get_gpr(decoded->Rn);
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return address;
 
   for(int i = 0; i < 8; ++i) {
@@ -28,12 +28,12 @@ uint32_t ldm(decode_result const *decoded)
       auto hit = load(address, &data, 0);
       cpu_set_gpr(i, data);
       address += 4;
-      if(dcache) {
+      if(active_machine().dcache) {
 	if(hit) {
 	  numLoaded = 1;
 	}
 	else {	
-          numLoaded += ((dcache->get_block_size() >> 2) + 1);
+          numLoaded += ((active_machine().dcache->get_block_size() >> 2) + 1);
 	}
       }
       else {
@@ -45,7 +45,7 @@ uint32_t ldm(decode_result const *decoded)
   if(rNWritten == 0)
     cpu_set_gpr(decoded->Rn, address);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     return numLoaded;
   }
 
@@ -55,13 +55,13 @@ uint32_t ldm(decode_result const *decoded)
 // STM - Store multiple registers to the stack
 uint32_t stm(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("stm r%u!, {0x%X}\n", decoded->Rn, decoded->register_list);
 
   uint32_t numStored = 0;
   uint32_t address = cpu_get_gpr(decoded->Rn);
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return address;
 
   for(int i = 0; i < 8; ++i) {
@@ -75,12 +75,12 @@ uint32_t stm(decode_result const *decoded)
       uint32_t data = cpu_get_gpr(i);
       auto hit = store(address, data);
       address += 4;
-      if(dcache) {
+      if(active_machine().dcache) {
 	if(hit) {
 	  numStored = 1;
 	}
 	else {	
-          numStored += ((dcache->get_block_size() >> 2) + 1);
+          numStored += ((active_machine().dcache->get_block_size() >> 2) + 1);
 	}
       }
       else {
@@ -91,7 +91,7 @@ uint32_t stm(decode_result const *decoded)
 
   cpu_set_gpr(decoded->Rn, address);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     return numStored;
   }
 
@@ -103,13 +103,13 @@ uint32_t stm(decode_result const *decoded)
 // Pop multiple reg values from the stack and update SP
 uint32_t pop(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("pop {0x%X}\n", decoded->register_list);
 
   uint32_t numLoaded = 0;
   uint32_t address = cpu_get_sp();
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return address;
 
   for(int i = 0; i < 16; ++i) {
@@ -120,19 +120,19 @@ uint32_t pop(decode_result const *decoded)
       cpu_set_gpr(i, data);
       // fprintf(stdout, "r%d<-0x%x\n", i, data);
 
-      if(dcache) {
+      if(active_machine().dcache) {
 	if(hit) {
 	  numLoaded = 1;
 	}
 	else {	
-          numLoaded += ((dcache->get_block_size() >> 2) + 1);
+          numLoaded += ((active_machine().dcache->get_block_size() >> 2) + 1);
 	}
       }
       else {
         ++numLoaded;
       }
       if(i == 15)
-        BRANCH_WAS_TAKEN = 1;
+        active_machine().branch_was_taken = 1;
       address += 4;
     }
 
@@ -143,23 +143,23 @@ uint32_t pop(decode_result const *decoded)
 
   cpu_set_sp(address);
 
-  if(dcache) {
-    return numLoaded + BRANCH_WAS_TAKEN ? TIMING_PC_UPDATE : 0;
+  if(active_machine().dcache) {
+    return numLoaded + active_machine().branch_was_taken ? TIMING_PC_UPDATE : 0;
   }
 
-  return 1 + numLoaded + BRANCH_WAS_TAKEN ? TIMING_PC_UPDATE : 0;
+  return 1 + numLoaded + active_machine().branch_was_taken ? TIMING_PC_UPDATE : 0;
 }
 
 // Push multiple reg values to the stack and update SP
 uint32_t push(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("push {0x%4.4X}\n", decoded->register_list);
 
   uint32_t numStored = 0;
   uint32_t address = cpu_get_sp();
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return address;
 
   for(int i = 14; i >= 0; --i) {
@@ -169,12 +169,12 @@ uint32_t push(decode_result const *decoded)
       uint32_t data = cpu_get_gpr(i);
       // fprintf(stdout, "r%d->0x%x\n", i, data);
       auto hit = store(address, data);
-      if(dcache) {
+      if(active_machine().dcache) {
 	if(hit) {
 	  numStored = 1;
 	}
 	else {	
-          numStored += ((dcache->get_block_size() >> 2) + 1);
+          numStored += ((active_machine().dcache->get_block_size() >> 2) + 1);
 	}
       }
       else {
@@ -189,7 +189,7 @@ uint32_t push(decode_result const *decoded)
 
   cpu_set_sp(address);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     return numStored;
   }
 
@@ -201,7 +201,7 @@ uint32_t push(decode_result const *decoded)
 // LDR - Load from offset from register
 uint32_t ldr_i(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("ldr r%u, [r%u, #0x%X]\n", decoded->Rd, decoded->Rn, decoded->imm << 2);
 
   uint32_t numLoaded = 0;
@@ -209,17 +209,17 @@ uint32_t ldr_i(decode_result const *decoded)
   uint32_t offset = zeroExtend32(decoded->imm << 2);
   uint32_t effectiveAddress = base + offset;
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return effectiveAddress;
 
   uint32_t result = 0;
   auto hit = load(effectiveAddress, &result, 0);
-  if(dcache) {
+  if(active_machine().dcache) {
     if(hit) {
       numLoaded = 1;
     }
     else {	
-      numLoaded += ((dcache->get_block_size() >> 2) + 1);
+      numLoaded += ((active_machine().dcache->get_block_size() >> 2) + 1);
     }
   }
   else {
@@ -228,7 +228,7 @@ uint32_t ldr_i(decode_result const *decoded)
 
   cpu_set_gpr(decoded->Rd, result);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     return numLoaded;
   }
 
@@ -238,7 +238,7 @@ uint32_t ldr_i(decode_result const *decoded)
 // LDR - Load from offset from SP
 uint32_t ldr_sp(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("ldr r%u, [SP, #0x%X]\n", decoded->Rd, decoded->imm << 2);
 
   uint32_t numLoaded = 0;
@@ -246,18 +246,18 @@ uint32_t ldr_sp(decode_result const *decoded)
   uint32_t offset = zeroExtend32(decoded->imm << 2);
   uint32_t effectiveAddress = base + offset;
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return effectiveAddress;
 
   uint32_t result = 0;
   auto hit = load(effectiveAddress, &result, 0);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     if(hit) {
       numLoaded = 1;
     }
     else {	
-      numLoaded += ((dcache->get_block_size() >> 2) + 1);
+      numLoaded += ((active_machine().dcache->get_block_size() >> 2) + 1);
     }
   }
   else {
@@ -268,7 +268,7 @@ uint32_t ldr_sp(decode_result const *decoded)
 
   // fprintf(stdout, "result=0x%8.8X base=0x%8.8X offset=0x%8.8X\n", result, base, offset);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     return numLoaded;
   }
 
@@ -278,7 +278,7 @@ uint32_t ldr_sp(decode_result const *decoded)
 // LDR - Load from offset from PC
 uint32_t ldr_lit(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("ldr r%u, [PC, #%d]\n", decoded->Rd, decoded->imm << 2);
 
   uint32_t numLoaded = 0;
@@ -286,18 +286,18 @@ uint32_t ldr_lit(decode_result const *decoded)
   uint32_t offset = zeroExtend32(decoded->imm << 2);
   uint32_t effectiveAddress = base + offset;
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return effectiveAddress;
 
   uint32_t result = 0;
   auto hit = load(effectiveAddress, &result, 0);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     if(hit) {
       numLoaded = 1;
     }
     else {	
-      numLoaded += ((dcache->get_block_size() >> 2) + 1);
+      numLoaded += ((active_machine().dcache->get_block_size() >> 2) + 1);
     }
   }
   else {
@@ -308,7 +308,7 @@ uint32_t ldr_lit(decode_result const *decoded)
 
   // fprintf(stdout, "r%d=0x%x\n", decoded->Rd, result);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     return numLoaded;
   }
 
@@ -318,7 +318,7 @@ uint32_t ldr_lit(decode_result const *decoded)
 // LDR - Load from an offset from a reg based on another reg value
 uint32_t ldr_r(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("ldr r%u, [r%u, r%u]\n", decoded->Rd, decoded->Rn, decoded->Rm);
 
   uint32_t numLoaded = 0;
@@ -326,18 +326,18 @@ uint32_t ldr_r(decode_result const *decoded)
   uint32_t offset = cpu_get_gpr(decoded->Rm);
   uint32_t effectiveAddress = base + offset;
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return effectiveAddress;
 
   uint32_t result = 0;
   auto hit = load(effectiveAddress, &result, 0);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     if(hit) {
       numLoaded = 1;
     }
     else {	
-      numLoaded += ((dcache->get_block_size() >> 2) + 1);
+      numLoaded += ((active_machine().dcache->get_block_size() >> 2) + 1);
     }
   }
   else {
@@ -346,7 +346,7 @@ uint32_t ldr_r(decode_result const *decoded)
 
   cpu_set_gpr(decoded->Rd, result);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     return numLoaded;
   }
 
@@ -356,7 +356,7 @@ uint32_t ldr_r(decode_result const *decoded)
 // LDRB - Load byte from offset from register
 uint32_t ldrb_i(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("ldrb r%u, [r%u, #0x%X]\n", decoded->Rd, decoded->Rn, decoded->imm);
 
   uint32_t numLoaded = 0;
@@ -365,18 +365,18 @@ uint32_t ldrb_i(decode_result const *decoded)
   uint32_t effectiveAddress = base + offset;
   uint32_t effectiveAddressWordAligned = effectiveAddress & ~0x3;
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return effectiveAddressWordAligned;
 
   uint32_t result = 0;
   auto hit = load(effectiveAddressWordAligned, &result, 0);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     if(hit) {
       numLoaded = 1;
     }
     else {	
-      numLoaded += ((dcache->get_block_size() >> 2) + 1);
+      numLoaded += ((active_machine().dcache->get_block_size() >> 2) + 1);
     }
   }
   else {
@@ -401,7 +401,7 @@ uint32_t ldrb_i(decode_result const *decoded)
 
   cpu_set_gpr(decoded->Rd, result);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     return numLoaded;
   }
 
@@ -411,7 +411,7 @@ uint32_t ldrb_i(decode_result const *decoded)
 // LDRB - Load byte from an offset from a reg based on another reg value
 uint32_t ldrb_r(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("ldrb r%u, [r%u, r%u]\n", decoded->Rd, decoded->Rn, decoded->Rm);
 
   uint32_t numLoaded = 0;
@@ -420,18 +420,18 @@ uint32_t ldrb_r(decode_result const *decoded)
   uint32_t effectiveAddress = base + offset;
   uint32_t effectiveAddressWordAligned = effectiveAddress & ~0x3;
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return effectiveAddressWordAligned;
 
   uint32_t result = 0;
   auto hit = load(effectiveAddressWordAligned, &result, 0);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     if(hit) {
       numLoaded = 1;
     }
     else {	
-      numLoaded += ((dcache->get_block_size() >> 2) + 1);
+      numLoaded += ((active_machine().dcache->get_block_size() >> 2) + 1);
     }
   }
   else {
@@ -456,7 +456,7 @@ uint32_t ldrb_r(decode_result const *decoded)
 
   cpu_set_gpr(decoded->Rd, result);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     return numLoaded;
   }
 
@@ -466,7 +466,7 @@ uint32_t ldrb_r(decode_result const *decoded)
 // LDRH - Load halfword from offset from register
 uint32_t ldrh_i(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("ldrh r%u, [r%u, #0x%X]\n", decoded->Rd, decoded->Rn, decoded->imm);
 
   uint32_t numLoaded = 0;
@@ -476,18 +476,18 @@ uint32_t ldrh_i(decode_result const *decoded)
   uint32_t effectiveAddress = base + offset;
   uint32_t effectiveAddressWordAligned = effectiveAddress & ~0x3;
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return effectiveAddressWordAligned;
 
   uint32_t result = 0;
   auto hit = load(effectiveAddressWordAligned, &result, 0);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     if(hit) {
       numLoaded = 1;
     }
     else {	
-      numLoaded += ((dcache->get_block_size() >> 2) + 1);
+      numLoaded += ((active_machine().dcache->get_block_size() >> 2) + 1);
     }
   }
   else {
@@ -507,7 +507,7 @@ uint32_t ldrh_i(decode_result const *decoded)
 
   cpu_set_gpr(decoded->Rd, result);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     return numLoaded;
   }
 
@@ -517,7 +517,7 @@ uint32_t ldrh_i(decode_result const *decoded)
 // LDRH - Load halfword from an offset from a reg based on another reg value
 uint32_t ldrh_r(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("ldrh r%u, [r%u, r%u]\n", decoded->Rd, decoded->Rn, decoded->Rm);
 
   uint32_t numLoaded = 0;
@@ -526,18 +526,18 @@ uint32_t ldrh_r(decode_result const *decoded)
   uint32_t effectiveAddress = base + offset;
   uint32_t effectiveAddressWordAligned = effectiveAddress & ~0x3;
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return effectiveAddressWordAligned;
 
   uint32_t result = 0;
   auto hit = load(effectiveAddressWordAligned, &result, 0);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     if(hit) {
       numLoaded = 1;
     }
     else {	
-      numLoaded += ((dcache->get_block_size() >> 2) + 1);
+      numLoaded += ((active_machine().dcache->get_block_size() >> 2) + 1);
     }
   }
   else {
@@ -557,7 +557,7 @@ uint32_t ldrh_r(decode_result const *decoded)
 
   cpu_set_gpr(decoded->Rd, result);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     return numLoaded;
   }
 
@@ -567,7 +567,7 @@ uint32_t ldrh_r(decode_result const *decoded)
 // LDRSB - Load signed byte from an offset from a reg based on another reg value
 uint32_t ldrsb_r(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("ldrsb r%u, [r%u, r%u]\n", decoded->Rd, decoded->Rn, decoded->Rm);
 
   uint32_t numLoaded = 0;
@@ -576,18 +576,18 @@ uint32_t ldrsb_r(decode_result const *decoded)
   uint32_t effectiveAddress = base + offset;
   uint32_t effectiveAddressWordAligned = effectiveAddress & ~0x3;
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return effectiveAddressWordAligned;
 
   uint32_t result = 0;
   auto hit = load(effectiveAddressWordAligned, &result, 0);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     if(hit) {
       numLoaded = 1;
     }
     else {	
-      numLoaded += ((dcache->get_block_size() >> 2) + 1);
+      numLoaded += ((active_machine().dcache->get_block_size() >> 2) + 1);
     }
   }
   else {
@@ -612,7 +612,7 @@ uint32_t ldrsb_r(decode_result const *decoded)
 
   cpu_set_gpr(decoded->Rd, result);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     return numLoaded;
   }
 
@@ -622,7 +622,7 @@ uint32_t ldrsb_r(decode_result const *decoded)
 // LDRSH - Load signed halfword from an offset from a reg based on another reg value
 uint32_t ldrsh_r(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("ldrsh r%u, [r%u, r%u]\n", decoded->Rd, decoded->Rn, decoded->Rm);
 
   uint32_t numLoaded = 0;
@@ -631,18 +631,18 @@ uint32_t ldrsh_r(decode_result const *decoded)
   uint32_t effectiveAddress = base + offset;
   uint32_t effectiveAddressWordAligned = effectiveAddress & ~0x3;
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return effectiveAddressWordAligned;
 
   uint32_t result = 0;
   auto hit = load(effectiveAddressWordAligned, &result, 0);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     if(hit) {
       numLoaded = 1;
     }
     else {	
-      numLoaded += ((dcache->get_block_size() >> 2) + 1);
+      numLoaded += ((active_machine().dcache->get_block_size() >> 2) + 1);
     }
   }
   else {
@@ -661,7 +661,7 @@ uint32_t ldrsh_r(decode_result const *decoded)
 
   cpu_set_gpr(decoded->Rd, result);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     return numLoaded;
   }
 
@@ -673,7 +673,7 @@ uint32_t ldrsh_r(decode_result const *decoded)
 // STR - Store to offset from register
 uint32_t str_i(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("str r%u, [r%u, #%d]\n", decoded->Rd, decoded->Rn, decoded->imm << 2);
 
   uint32_t numStored = 0;
@@ -681,17 +681,17 @@ uint32_t str_i(decode_result const *decoded)
   uint32_t offset = zeroExtend32(decoded->imm << 2);
   uint32_t effectiveAddress = base + offset;
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return effectiveAddress;
 
   auto hit = store(effectiveAddress, cpu_get_gpr(decoded->Rd));
 
-  if(dcache) {
+  if(active_machine().dcache) {
     if(hit) {
       numStored = 1;
     }
     else {	
-      numStored += ((dcache->get_block_size() >> 2) + 1);
+      numStored += ((active_machine().dcache->get_block_size() >> 2) + 1);
     }
   }
   else {
@@ -704,7 +704,7 @@ uint32_t str_i(decode_result const *decoded)
 // STR - Store to offset from SP
 uint32_t str_sp(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("str r%u, [SP, #%d]\n", decoded->Rd, decoded->imm << 2);
 
   uint32_t numStored = 0;
@@ -712,24 +712,24 @@ uint32_t str_sp(decode_result const *decoded)
   uint32_t offset = zeroExtend32(decoded->imm << 2);
   uint32_t effectiveAddress = base + offset;
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return effectiveAddress;
 
   auto hit = store(effectiveAddress, cpu_get_gpr(decoded->Rd));
 
-  if(dcache) {
+  if(active_machine().dcache) {
     if(hit) {
       numStored = 1;
     }
     else {	
-      numStored += ((dcache->get_block_size() >> 2) + 1);
+      numStored += ((active_machine().dcache->get_block_size() >> 2) + 1);
     }
   }
   else {
     ++numStored;
   }
 
-  if(dcache) {
+  if(active_machine().dcache) {
     return numStored;
   }
 
@@ -739,7 +739,7 @@ uint32_t str_sp(decode_result const *decoded)
 // STR - Store to an offset from a reg based on another reg value
 uint32_t str_r(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("str r%u, [r%u, r%u]\n", decoded->Rd, decoded->Rn, decoded->Rm);
 
   uint32_t numStored = 0;
@@ -747,24 +747,24 @@ uint32_t str_r(decode_result const *decoded)
   uint32_t offset = cpu_get_gpr(decoded->Rm);
   uint32_t effectiveAddress = base + offset;
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return effectiveAddress;
 
   auto hit = store(effectiveAddress, cpu_get_gpr(decoded->Rd));
 
-  if(dcache) {
+  if(active_machine().dcache) {
     if(hit) {
       numStored = 1;
     }
     else {	
-      numStored += ((dcache->get_block_size() >> 2) + 1);
+      numStored += ((active_machine().dcache->get_block_size() >> 2) + 1);
     }
   }
   else {
     ++numStored;
   }
 
-  if(dcache) {
+  if(active_machine().dcache) {
     return numStored;
   }
 
@@ -774,7 +774,7 @@ uint32_t str_r(decode_result const *decoded)
 // STRB - Store byte to offset from register
 uint32_t strb_i(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("strb r%u, [r%u, #0x%X]\n", decoded->Rd, decoded->Rn, decoded->imm);
 
   uint32_t numStored = 0;
@@ -784,7 +784,7 @@ uint32_t strb_i(decode_result const *decoded)
   uint32_t effectiveAddressWordAligned = effectiveAddress & ~0x3;
   uint32_t data = cpu_get_gpr(decoded->Rd) & 0xFF;
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return effectiveAddressWordAligned;
 
   uint32_t orig;
@@ -807,19 +807,19 @@ uint32_t strb_i(decode_result const *decoded)
 
   auto hit = store(effectiveAddressWordAligned, orig);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     if(hit) {
       numStored = 1;
     }
     else {	
-      numStored += ((dcache->get_block_size() >> 2) + 1);
+      numStored += ((active_machine().dcache->get_block_size() >> 2) + 1);
     }
   }
   else {
     ++numStored;
   }
 
-  if(dcache) {
+  if(active_machine().dcache) {
     return numStored;
   }
 
@@ -829,7 +829,7 @@ uint32_t strb_i(decode_result const *decoded)
 // STRB - Store byte to an offset from a reg based on another reg value
 uint32_t strb_r(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("strb r%u, [r%u, r%u]\n", decoded->Rd, decoded->Rn, decoded->Rm);
 
   uint32_t numStored = 0;
@@ -839,7 +839,7 @@ uint32_t strb_r(decode_result const *decoded)
   uint32_t effectiveAddressWordAligned = effectiveAddress & ~0x3;
   uint32_t data = cpu_get_gpr(decoded->Rd) & 0xFF;
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return effectiveAddressWordAligned;
 
   uint32_t orig;
@@ -862,19 +862,19 @@ uint32_t strb_r(decode_result const *decoded)
 
   auto hit = store(effectiveAddressWordAligned, orig);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     if(hit) {
       numStored = 1;
     }
     else {	
-      numStored += ((dcache->get_block_size() >> 2) + 1);
+      numStored += ((active_machine().dcache->get_block_size() >> 2) + 1);
     }
   }
   else {
     ++numStored;
   }
 
-  if(dcache) {
+  if(active_machine().dcache) {
     return numStored;
   }
 
@@ -884,7 +884,7 @@ uint32_t strb_r(decode_result const *decoded)
 // STRH - Store halfword to offset from register
 uint32_t strh_i(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("strh r%u, [r%u, #0x%X]\n", decoded->Rd, decoded->Rn, decoded->imm);
 
   uint32_t numStored = 0;
@@ -894,7 +894,7 @@ uint32_t strh_i(decode_result const *decoded)
   uint32_t effectiveAddressWordAligned = effectiveAddress & ~0x3;
   uint32_t data = cpu_get_gpr(decoded->Rd) & 0xFFFF;
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return effectiveAddressWordAligned;
 
   uint32_t orig;
@@ -911,19 +911,19 @@ uint32_t strh_i(decode_result const *decoded)
 
   auto hit = store(effectiveAddressWordAligned, orig);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     if(hit) {
       numStored = 1;
     }
     else {	
-      numStored += ((dcache->get_block_size() >> 2) + 1);
+      numStored += ((active_machine().dcache->get_block_size() >> 2) + 1);
     }
   }
   else {
     ++numStored;
   }
 
-  if(dcache) {
+  if(active_machine().dcache) {
     return numStored;
   }
 
@@ -933,7 +933,7 @@ uint32_t strh_i(decode_result const *decoded)
 // STRH - Store halfword to an offset from a reg based on another reg value
 uint32_t strh_r(decode_result const *decoded)
 {
-  if(!thumbulator::mock_exmemwb)
+  if(!active_machine().mock_exmemwb)
     TRACE_INSTRUCTION("strh r%u, [r%u, r%u]\n", decoded->Rd, decoded->Rn, decoded->Rm);
 
   uint32_t numStored = 0;
@@ -943,7 +943,7 @@ uint32_t strh_r(decode_result const *decoded)
   uint32_t effectiveAddressWordAligned = effectiveAddress & ~0x3;
   uint32_t data = cpu_get_gpr(decoded->Rd) & 0xFFFF;
 
-  if(thumbulator::mock_exmemwb)
+  if(active_machine().mock_exmemwb)
     return effectiveAddressWordAligned;
 
   uint32_t orig;
@@ -960,19 +960,19 @@ uint32_t strh_r(decode_result const *decoded)
 
   auto hit = store(effectiveAddressWordAligned, orig);
 
-  if(dcache) {
+  if(active_machine().dcache) {
     if(hit) {
       numStored = 1;
     }
     else {	
-      numStored += ((dcache->get_block_size() >> 2) + 1);
+      numStored += ((active_machine().dcache->get_block_size() >> 2) + 1);
     }
   }
   else {
     ++numStored;
   }
 
-  if(dcache) {
+  if(active_machine().dcache) {
     return numStored;
   }
 
@@ -0,0 +1,102 @@
+#include "thumbulator/instrumentation.hpp"
+
+#include <iomanip>
+#include <ostream>
+
+namespace thumbulator {
+namespace instrumentation {
+
+thread_local stage_counters counters{};
+
+char const *stage_name(stage timed)
+{
+  switch(timed) {
+  case stage::loop: return "loop";
+  case stage::fetch: return "fetch";
+  case stage::decode: return "decode";
+  case stage::execute: return "execute";
+  case stage::cache: return "cache";
+  case stage::scheme_hooks: return "scheme_hooks";
+  case stage::scheme: return "scheme";
+  case stage::liveness: return "liveness";
+  case stage::inference: return "inference";
+  case stage::energy: return "energy";
+  case stage::count: break;
+  }
+
+  return "unknown";
+}
+
+session::session()
+{
+  counters = stage_counters{};
+  counters.current = stage::loop;
+
+  start_time = std::chrono::steady_clock::now();
+  start_tick = read_tick();
+  counters.last_tick = start_tick;
+}
+
+void session::stop()
+{
+  auto const end_tick = read_tick();
+  counters.ticks[static_cast<size_t>(counters.current)] += end_tick - counters.last_tick;
+  counters.last_tick = end_tick;
+  totals = counters;
+
+  // calibrate the ticks against the steady clock over the whole session
+  elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start_time);
+  ns_per_tick = end_tick > start_tick ? static_cast<double>(elapsed.count()) / (end_tick - start_tick)
+                                      : 0.0;
+}
+
+double session::stage_ns(size_t index) const
+{
+  return totals.ticks[index] * ns_per_tick;
+}
+
+void session::report(std::ostream &stream, uint64_t instructions) const
+{
+  auto const per_instruction = [&](double value) {
+    return instructions > 0 ? value / instructions : 0.0;
+  };
+
+  stream << "Host time per simulated instruction (ns):\n";
+  double total = 0;
+  for(size_t i = 0; i < NUM_STAGES; ++i) {
+    auto const ns = stage_ns(i);
+    total += ns;
+
+    stream << "  " << std::left << std::setw(14) << stage_name(static_cast<stage>(i)) << std::right
+           << std::fixed << std::setprecision(2) << std::setw(10) << per_instruction(ns)
+           << std::setw(8) << std::setprecision(1)
+           << (elapsed.count() > 0 ? 100.0 * ns / elapsed.count() : 0.0) << "%"
+           << std::setw(12) << std::setprecision(2) << per_instruction(totals.calls[i])
+           << " calls\n";
+  }
+  stream << "  " << std::left << std::setw(14) << "total" << std::right << std::fixed
+         << std::setprecision(2) << std::setw(10) << per_instruction(total) << "\n";
+  stream << std::defaultfloat;
+}
+
+void session::write_json(std::ostream &stream, uint64_t instructions) const
+{
+  stream << "{\n";
+  stream << "  \"instructions\": " << instructions << ",\n";
+  stream << "  \"host_ns\": " << elapsed.count() << ",\n";
+  stream << "  \"stages\": {\n";
+  for(size_t i = 0; i < NUM_STAGES; ++i) {
+    auto const ns = stage_ns(i);
+    stream << "    \"" << stage_name(static_cast<stage>(i)) << "\": {\"ns\": " << std::fixed
+           << std::setprecision(0) << ns << ", \"calls\": " << totals.calls[i]
+           << ", \"ns_per_instruction\": " << std::setprecision(3)
+           << (instructions > 0 ? ns / instructions : 0.0) << "}"
+           << (i + 1 < NUM_STAGES ? ",\n" : "\n");
+  }
+  stream << "  }\n";
+  stream << "}\n";
+  stream << std::defaultfloat;
+}
+}
+}
@@ -0,0 +1,29 @@
+#include "thumbulator/machine.hpp"
+
+#include <new>
+
+namespace thumbulator {
+
+thread_local machine *current_machine = nullptr;
+
+namespace {
+predecoded_array allocate_predecoded(size_t elements)
+{
+  // zeroed entries have no handler yet, so they are decoded on first execution
+  auto predecoded =
+      static_cast<predecoded_instruction *>(std::calloc(elements, sizeof(predecoded_instruction)));
+  if(predecoded == nullptr) {
+    throw std::bad_alloc();
+  }
+
+  return predecoded_array(predecoded);
+}
+}
+
+machine::machine()
+    : ram(RAM_SIZE_ELEMENTS)
+    , flash(FLASH_SIZE_ELEMENTS)
+    , predecoded(allocate_predecoded(FLASH_SIZE_BYTES >> 1))
+{
+}
+}
@@ -1,35 +1,28 @@
 #include "thumbulator/memory.hpp"
 
 #include <cstdio>
+#include <vector>
+
+#include "thumbulator/execution_trace.hpp"
+#include "thumbulator/instrumentation.hpp"
+#include "thumbulator/machine.hpp"
+#include "thumbulator/stack_distance.hpp"
 
 #include "cpu_flags.hpp"
 #include "exit.hpp"
 
 namespace thumbulator {
 
-std::shared_ptr<cache> dcache = nullptr;
-std::shared_ptr<cache> icache = nullptr;
-std::shared_ptr<rename> renamer = nullptr;
-
-uint32_t RAM[RAM_SIZE_BYTES >> 2];
-
-std::function<uint32_t(uint32_t, uint32_t)> ram_load_hook;
-std::function<uint32_t(uint32_t, uint32_t, uint32_t, bool)> ram_store_hook;
-
-std::function<bool(cache_block&, uint32_t, bool, size_t, size_t)> cache_load_hook;
-std::function<bool(cache_block&, uint32_t, bool, size_t, size_t, bool&)> cache_store_hook;
-
-uint32_t FLASH_MEMORY[FLASH_SIZE_BYTES >> 2];
-
-bool icache_hit = false;
-bool dcache_hit = false;
+using instrumentation::stage;
 
 uint32_t ram_load(uint32_t address, bool false_read)
 {
-  auto data = RAM[(address & RAM_ADDRESS_MASK) >> 2];
+  auto &active = active_machine();
+  auto data = active.ram.read((address & RAM_ADDRESS_MASK) >> 2);
 
-  if(!false_read && ram_load_hook != nullptr) {
-    data = ram_load_hook(address, data);
+  if(!false_read && active.ram_load_hook != nullptr) {
+    instrumentation::scoped_timer timer(stage::scheme_hooks);
+    data = active.ram_load_hook(address, data);
   }
 
   // fprintf(stdout, "In ram_load: address=0x%8.8x data=0x%x\n", address, data);
@@ -38,15 +31,17 @@ uint32_t ram_load(uint32_t address, bool false_read)
 
 void ram_store(uint32_t address, uint32_t value, bool backup)
 {
-  if(ram_store_hook != nullptr) {
+  auto &active = active_machine();
+  if(active.ram_store_hook != nullptr) {
     auto const old_value = ram_load(address, true);
 
-    value = ram_store_hook(address, old_value, value, backup);
+    instrumentation::scoped_timer timer(stage::scheme_hooks);
+    value = active.ram_store_hook(address, old_value, value, backup);
   }
 
   // fprintf(stdout, "In ram_store: value=0x%x\n", value);
 
-  RAM[(address & RAM_ADDRESS_MASK) >> 2] = value;
+  active.ram.write((address & RAM_ADDRESS_MASK) >> 2, value);
 }
 
 uint32_t load_from_memory(uint32_t address, uint32_t false_read)
@@ -64,15 +59,16 @@ uint32_t load_from_memory(uint32_t address, uint32_t false_read)
 
       // Check for SYSTICK
       if((address >> 4) == 0xE000E01) {
-        auto value = ((uint32_t *)&SYSTICK)[(address >> 2) & 0x3];
+        auto &systick = active_machine().systick;
+        auto value = ((uint32_t *)&systick)[(address >> 2) & 0x3];
         if(address == 0xE000E010)
-          SYSTICK.control &= 0x00010000;
+          systick.control &= 0x00010000;
 
         return value;
       }
 
-      fprintf(
-          stderr, "Error: DLR Memory access out of range: 0x%8.8X, pc=%x\n", address, cpu_get_pc());
+      fprintf(stderr, "Error: DLR Memory access out of range: 0x%8.8X, pc=%x%s\n", address,
+          cpu_get_pc(), describe_address(cpu_get_pc() - 4).c_str());
       terminate_simulation(1);
     }
 
@@ -80,13 +76,13 @@ uint32_t load_from_memory(uint32_t address, uint32_t false_read)
     return ram_load(address, false_read == 1);
   } else {
     if(address >= (FLASH_START + FLASH_SIZE_BYTES)) {
-      fprintf(
-          stderr, "Error: DLF Memory access out of range: 0x%8.8X, pc=%x\n", address, cpu_get_pc());
+      fprintf(stderr, "Error: DLF Memory access out of range: 0x%8.8X, pc=%x%s\n", address,
+          cpu_get_pc(), describe_address(cpu_get_pc() - 4).c_str());
       terminate_simulation(1);
     }
 
     // fprintf(stdout, "FLASH load\n");
-    return FLASH_MEMORY[(address & FLASH_ADDRESS_MASK) >> 2];
+    return active_machine().flash.read((address & FLASH_ADDRESS_MASK) >> 2);
   }
 }
 
@@ -106,24 +102,25 @@ void store_in_memory(uint32_t address, uint32_t value, bool backup)
 
       // Check for SYSTICK
       if((address >> 4) == 0xE000E01 && address != 0xE000E01C) {
+        auto &systick = active_machine().systick;
         if(address == 0xE000E010) {
-          SYSTICK.control = (value & 0x1FFFD) | 0x4; // No external tick source, no interrupt
+          systick.control = (value & 0x1FFFD) | 0x4; // No external tick source, no interrupt
 
           if(value & 0x2) {
             fprintf(stderr, "Warning: SYSTICK interrupts not implemented, ignoring\n");
           }
         } else if(address == 0xE000E014) {
-          SYSTICK.reload = value & 0xFFFFFF;
+          systick.reload = value & 0xFFFFFF;
         } else if(address == 0xE000E018) {
           // Reads clears current value
-          SYSTICK.value = 0;
+          systick.value = 0;
         }
 
         return;
       }
 
-      fprintf(
-          stderr, "Error: DSR Memory access out of range: 0x%8.8X, pc=%x\n", address, cpu_get_pc());
+      fprintf(stderr, "Error: DSR Memory access out of range: 0x%8.8X, pc=%x%s\n", address,
+          cpu_get_pc(), describe_address(cpu_get_pc() - 4).c_str());
       terminate_simulation(1);
     }
 
@@ -131,63 +128,160 @@ void store_in_memory(uint32_t address, uint32_t value, bool backup)
     ram_store(address, value, backup);
   } else {
     if(address >= (FLASH_START + FLASH_SIZE_BYTES)) {
-      fprintf(
-          stderr, "Error: DSF Memory access out of range: 0x%8.8X, pc=%x\n", address, cpu_get_pc());
+      fprintf(stderr, "Error: DSF Memory access out of range: 0x%8.8X, pc=%x%s\n", address,
+          cpu_get_pc(), describe_address(cpu_get_pc() - 4).c_str());
       terminate_simulation(1);
     }
 
     // fprintf(stdout, "FLASH store\n");
-    FLASH_MEMORY[(address & FLASH_ADDRESS_MASK) >> 2] = value;
+    active_machine().flash.write((address & FLASH_ADDRESS_MASK) >> 2, value);
+    invalidate_predecoded(address);
   }
 }
 
-uint32_t cache_load(uint32_t address, bool false_read)
+namespace {
+
+// the line before and after a write-back for ram_line_store_hook, reused to avoid allocations
+thread_local std::vector<uint32_t> line_before;
+thread_local std::vector<uint32_t> line_after;
+
+/**
+ * Whether count words from address all lie in RAM, so they can move as one block.
+ */
+bool line_in_ram(uint32_t address, size_t count)
+{
+  return address >= RAM_START
+         && uint64_t(address) + (count << 2) <= uint64_t(RAM_START) + RAM_SIZE_BYTES;
+}
+
+/**
+ * Load consecutive words from RAM, the line counterpart of ram_load.
+ */
+void ram_load_line(uint32_t address, uint32_t *words, size_t count, bool false_read)
+{
+  auto &active = active_machine();
+  if(!false_read && active.ram_line_load_hook == nullptr && active.ram_load_hook != nullptr) {
+    // the scheme only hooks single words
+    for(size_t i = 0; i < count; ++i) {
+      words[i] = ram_load(address + (i << 2), false);
+    }
+    return;
+  }
+
+  active.ram.read((address & RAM_ADDRESS_MASK) >> 2, words, count);
+
+  if(!false_read && active.ram_line_load_hook != nullptr) {
+    instrumentation::scoped_timer timer(stage::scheme_hooks);
+    active.ram_line_load_hook(address, words, count);
+  }
+}
+
+/**
+ * Store consecutive words in RAM, the line counterpart of ram_store.
+ */
+void ram_store_line(uint32_t address, uint32_t const *words, size_t count, bool backup)
+{
+  auto &active = active_machine();
+  auto const first = (address & RAM_ADDRESS_MASK) >> 2;
+  if(active.ram_line_store_hook != nullptr) {
+    line_before.resize(count);
+    active.ram.read(first, line_before.data(), count);
+    line_after.assign(words, words + count);
+
+    {
+      instrumentation::scoped_timer timer(stage::scheme_hooks);
+      active.ram_line_store_hook(address, line_before.data(), line_after.data(), count, backup);
+    }
+
+    active.ram.write(first, line_after.data(), count);
+  } else if(active.ram_store_hook != nullptr) {
+    // the scheme only hooks single words
+    for(size_t i = 0; i < count; ++i) {
+      ram_store(address + (i << 2), words[i], backup);
+    }
+  } else {
+    active.ram.write(first, words, count);
+  }
+}
+
+/**
+ * Fill a cache line from memory: a line in RAM as one block, anything else word by word.
+ */
+void load_line(uint32_t address, uint32_t *words, size_t count, bool false_read)
+{
+  if(line_in_ram(address, count)) {
+    ram_load_line(address, words, count, false_read);
+    return;
+  }
+
+  for(size_t beat = 0; beat < count; beat++) {
+    words[beat] = load_from_memory(address + (beat << 2), false_read);
+  }
+}
+
+/**
+ * Write a cache line back to memory: a line in RAM as one block, anything else word by word.
+ */
+void store_line(uint32_t address, uint32_t const *words, size_t count)
+{
+  if(line_in_ram(address, count)) {
+    ram_store_line(address, words, count, false);
+    return;
+  }
+
+  for(size_t beat = 0; beat < count; beat++) {
+    store_in_memory(address + (beat << 2), words[beat], false);
+  }
+}
+
+template <typename Cache>
+uint32_t cached_load(Cache &dcache, uint32_t address, bool false_read)
 {
+  auto &active = active_machine();
+  auto &renamer = active.renamer;
   // fprintf(stdout, "In cache_load: addr=0x%8.8x\n", address);
-  auto word_offset  = (address & dcache->get_block_mask()) >> 2; 
-  auto load_addr    = address & (~dcache->get_block_mask());
-  auto mt_tag       = address >> (dcache->get_block_offset()); // map table tag
+  auto word_offset  = (address & dcache.get_block_mask()) >> 2; 
+  auto load_addr    = address & (~dcache.get_block_mask());
+  auto mt_tag       = address >> (dcache.get_block_offset()); // map table tag
 
   cache_attr attr;
-  dcache_hit = dcache->is_hit(load_addr, attr);
+  active.dcache_hit = dcache.is_hit(load_addr, attr);
 
-  if(dcache_hit) {
-    auto blk = dcache->cache_read(attr, false_read);
-    if(cache_load_hook != nullptr) {
-      cache_load_hook(blk, load_addr, true, attr.set, attr.way);
+  if(active.dcache_hit) {
+    auto blk = dcache.cache_read(attr, false_read);
+    if(active.cache_load_hook != nullptr) {
+      instrumentation::timed(stage::scheme_hooks,
+          [&]() { return active.cache_load_hook(blk, load_addr, true, attr.set, attr.way); });
     }
-    if(dcache->get_state(attr.set, attr.way, word_offset) == hmap::cUnknown) {
-      dcache->set_state(attr.set, attr.way, word_offset, hmap::cReadFirst);
+    if(dcache.get_state(attr.set, attr.way, word_offset) == hmap::cUnknown) {
+      dcache.set_state(attr.set, attr.way, word_offset, hmap::cReadFirst);
     }
 
-    return dcache->get_data(attr.set, attr.way, word_offset);
+    return dcache.get_data(attr.set, attr.way, word_offset);
   }
   else {
-    auto victim = dcache->get_victim(attr);
+    auto victim = dcache.get_victim(attr);
     auto lbf = false;
     if(victim.get_valid()) { 
-      lbf = dcache->get_block_state(attr.set, attr.way);
+      lbf = dcache.get_block_state(attr.set, attr.way);
     }
 
-    if(cache_load_hook != nullptr) {
+    if(active.cache_load_hook != nullptr) {
       auto actual_address = victim.get_address();
-      cache_load_hook(victim, load_addr, lbf, attr.set, attr.way);
+      instrumentation::timed(stage::scheme_hooks,
+          [&]() { return active.cache_load_hook(victim, load_addr, lbf, attr.set, attr.way); });
 
       // fprintf(stdout, "cache_load: [victim] v=%d, d=%d, wf=%d, set=%zu, way=%zu, tag=0x%x, actual_address=0x%8.8x, renamed_address=0x%8.8x\n",
         // victim.get_valid(), victim.get_dirty(), victim.get_wf(), attr.set, attr.way, victim.get_tag(), actual_address, victim.get_address());
 
-      if(dcache->get_block(attr.set, attr.way).get_valid() && dcache->get_block(attr.set, attr.way).get_dirty()) {
-        for(uint32_t beat=0; beat<(dcache->get_block_size() >> 2); beat++) {
-          // fprintf(stdout, "actual_address=0x%8.8x renamed_address=0x%8.8x data=0x%x\n", 
-          //   (actual_address + (beat << 2)), (victim.get_address() + (beat << 2)), dcache->get_data(attr.set, attr.way, beat));
-          store_in_memory(victim.get_address() + (beat << 2), dcache->get_data(attr.set, attr.way, beat), false);
-        }
+      if(dcache.get_block(attr.set, attr.way).get_valid() && dcache.get_block(attr.set, attr.way).get_dirty()) {
+        store_line(victim.get_address(), dcache.line_data(attr.set, attr.way), dcache.get_block_size() >> 2);
       }
     }
 
     cache_block blk;
     blk.set_valid(1);
-    blk.set_tag(load_addr >> (dcache->get_set_offset() + dcache->get_block_offset()));
+    blk.set_tag(load_addr >> (dcache.get_set_offset() + dcache.get_block_offset()));
     blk.set_address(load_addr);
 
     auto actual_address = load_addr;
@@ -200,62 +294,61 @@ uint32_t cache_load(uint32_t address, bool false_read)
       }
     }
 
-    dcache->clear_state(attr.set, attr.way);
+    dcache.clear_state(attr.set, attr.way);
 
-    for(uint32_t beat=0; beat<(dcache->get_block_size() >> 2); beat++) {
-      auto data  = load_from_memory(load_addr + (beat << 2), false_read);
-      // fprintf(stdout, "cache_load(load): actual_address=0x%8.8x renamed_address=0x%8.8x data=0x%x\n", actual_address + (beat << 2), load_addr + (beat << 2), data);
-      dcache->set_data(attr.set, attr.way, beat, data);
-      dcache->set_state(attr.set, attr.way, beat, hmap::cReadFirst);
-    }
-    dcache->cache_insert(attr, blk, false_read);
-    return dcache->get_data(attr.set, attr.way, word_offset);
+    load_line(load_addr, dcache.line_data(attr.set, attr.way), dcache.get_block_size() >> 2, false_read);
+    dcache.set_line_state(attr.set, attr.way, hmap::cReadFirst);
+    dcache.cache_insert(attr, blk, false_read);
+    return dcache.get_data(attr.set, attr.way, word_offset);
   }
 }
 
-void cache_store(uint32_t address, uint32_t value)
+template <typename Cache>
+void cached_store(Cache &dcache, uint32_t address, uint32_t value)
 {
+  auto &active = active_machine();
+  auto &renamer = active.renamer;
   // fprintf(stdout, "In cache_store: addr=0x%8.8x value=0x%x\n", address, value);
-  auto word_offset  = (address & dcache->get_block_mask()) >> 2; 
-  auto store_addr   = address & (~dcache->get_block_mask());
-  auto mt_tag       = address >> (dcache->get_block_offset()); // map table tag
+  auto word_offset  = (address & dcache.get_block_mask()) >> 2; 
+  auto store_addr   = address & (~dcache.get_block_mask());
+  auto mt_tag       = address >> (dcache.get_block_offset()); // map table tag
   bool start_backup = false;
   auto gbf_hit      = false;
 
   cache_attr attr;
-  dcache_hit = dcache->is_hit(store_addr, attr);
-
-  if(dcache_hit) { 
-    auto blk = dcache->cache_read(attr, false);
-    if(cache_store_hook != nullptr) {
-      cache_store_hook(blk, store_addr, true, attr.set, attr.way , gbf_hit);
+  active.dcache_hit = dcache.is_hit(store_addr, attr);
+
+  if(active.dcache_hit) { 
+    auto blk = dcache.cache_read(attr, false);
+    if(active.cache_store_hook != nullptr) {
+      instrumentation::timed(stage::scheme_hooks, [&]() {
+        return active.cache_store_hook(blk, store_addr, true, attr.set, attr.way, gbf_hit);
+      });
     }
-    dcache->cache_write(false, attr);
-    dcache->set_data(attr.set, attr.way, word_offset, value);
-    if(dcache->get_state(attr.set, attr.way, word_offset) == hmap::cUnknown) {
-      dcache->set_state(attr.set, attr.way, word_offset, hmap::cWriteFirst);
+    dcache.cache_write(false, attr);
+    dcache.set_data(attr.set, attr.way, word_offset, value);
+    if(dcache.get_state(attr.set, attr.way, word_offset) == hmap::cUnknown) {
+      dcache.set_state(attr.set, attr.way, word_offset, hmap::cWriteFirst);
     }
   }
   else {
-    auto victim = dcache->get_victim(attr);
+    auto victim = dcache.get_victim(attr);
     auto lbf = false;
     if(victim.get_valid()) { 
-      lbf = dcache->get_block_state(attr.set, attr.way);
+      lbf = dcache.get_block_state(attr.set, attr.way);
     }
     
-    if(cache_store_hook != nullptr) {
+    if(active.cache_store_hook != nullptr) {
       auto actual_address = victim.get_address();
-      cache_store_hook(victim, store_addr, lbf, attr.set, attr.way , gbf_hit);
+      instrumentation::timed(stage::scheme_hooks, [&]() {
+        return active.cache_store_hook(victim, store_addr, lbf, attr.set, attr.way, gbf_hit);
+      });
 
       // fprintf(stdout, "cache_store: [victim] v=%d, d=%d, wf=%d, set=%zu, way=%zu, tag=0x%x, actual_address=0x%8.8x, renamed_address=0x%8.8x\n", 
         // victim.get_valid(), victim.get_dirty(), victim.get_wf(), attr.set, attr.way, victim.get_tag(), actual_address, victim.get_address());
 
-      if(dcache->get_block(attr.set, attr.way).get_valid() && dcache->get_block(attr.set, attr.way).get_dirty()) {
-        for(uint32_t beat=0; beat<(dcache->get_block_size() >> 2); beat++) {
-          // fprintf(stdout, "actual_address=0x%8.8x renamed_address=0x%8.8x data=0x%x\n",
-          //   (actual_address + (beat << 2)), (victim.get_address() + (beat << 2)), dcache->get_data(attr.set, attr.way, beat));
-          store_in_memory(victim.get_address() + (beat << 2), dcache->get_data(attr.set, attr.way, beat), false);
-        }
+      if(dcache.get_block(attr.set, attr.way).get_valid() && dcache.get_block(attr.set, attr.way).get_dirty()) {
+        store_line(victim.get_address(), dcache.line_data(attr.set, attr.way), dcache.get_block_size() >> 2);
       }
     }
 
@@ -263,7 +356,7 @@ void cache_store(uint32_t address, uint32_t value)
     blk.set_valid(1);
     blk.set_dirty(1);
     blk.set_wf(false);
-    blk.set_tag(store_addr >> (dcache->get_set_offset() + dcache->get_block_offset()));
+    blk.set_tag(store_addr >> (dcache.get_set_offset() + dcache.get_block_offset()));
     blk.set_address(store_addr);
 
     auto actual_address = store_addr;
@@ -276,82 +369,126 @@ void cache_store(uint32_t address, uint32_t value)
       }
     }
 
-    dcache->clear_state(attr.set, attr.way);
+    dcache.clear_state(attr.set, attr.way);
 
-    for(uint32_t beat=0; beat<(dcache->get_block_size() >> 2); beat++) {
-      auto data = load_from_memory(store_addr + (beat << 2), false);
-      // fprintf(stdout, "cache_store(load): actual_address=0x%8.8x renamed_address=0x%8.8x data=0x%x\n", actual_address + (beat << 2), store_addr + (beat << 2), data);
-      dcache->set_data(attr.set, attr.way, beat, data);
-      if(gbf_hit) {
-        dcache->set_state(attr.set, attr.way, beat, hmap::cReadFirst);
-      }
+    load_line(store_addr, dcache.line_data(attr.set, attr.way), dcache.get_block_size() >> 2, false);
+    if(gbf_hit) {
+      dcache.set_line_state(attr.set, attr.way, hmap::cReadFirst);
     }
-    dcache->set_data(attr.set, attr.way, word_offset, value);
+    dcache.set_data(attr.set, attr.way, word_offset, value);
     if(gbf_hit)
-      dcache->set_state(attr.set, attr.way, word_offset, hmap::cReadFirst);
+      dcache.set_state(attr.set, attr.way, word_offset, hmap::cReadFirst);
     else
-      dcache->set_state(attr.set, attr.way, word_offset, hmap::cWriteFirst);
-    dcache->cache_insert(attr, blk, false);
+      dcache.set_state(attr.set, attr.way, word_offset, hmap::cWriteFirst);
+    dcache.cache_insert(attr, blk, false);
   }
 }
 
-// Memory access functions assume that RAM has a higher address than Flash
-void fetch_instruction(uint32_t address, uint16_t *value)
+/**
+ * Fetch a line word by word, for lines not wholly in flash or RAM.
+ */
+void fetch_line_by_word(uint32_t address, uint32_t *words, size_t count)
 {
-  // fprintf(stdout, "In fetch_instruction: address=0x%8.8x\n", address);
-  uint32_t fromMem;
-  auto icache_hit = false;
-
-  if(icache) {
-    auto word_offset  = (address & icache->get_block_mask()) >> 2; 
-    auto load_addr    = address & (~icache->get_block_mask());
+  auto &active = active_machine();
+  for(size_t beat = 0; beat < count; beat++) {
+    uint32_t const fetch_addr = address + (beat << 2);
+    if(fetch_addr >= RAM_START) {
+      if(fetch_addr >= (RAM_START + RAM_SIZE_BYTES)) {
+        fprintf(stderr, "Error: ILR Memory access out of range: 0x%8.8X, pc=%x%s\n", fetch_addr,
+            cpu_get_pc(), describe_address(cpu_get_pc() - 4).c_str());
+        terminate_simulation(1);
+      }
 
-    cache_attr attr;
-    icache_hit = icache->is_hit(load_addr, attr);
+      // fprintf(stdout, "RAM load\n");
+      words[beat] = ram_load(fetch_addr, false);
+    } else {
+      if(fetch_addr >= (FLASH_START + FLASH_SIZE_BYTES)) {
+        fprintf(stderr, "Error: ILF Memory access out of range: 0x%8.8X, pc=%x%s\n", fetch_addr,
+            cpu_get_pc(), describe_address(cpu_get_pc() - 4).c_str());
+        terminate_simulation(1);
+      }
 
-    if(icache_hit) {
-      auto blk = icache->cache_read(attr, false);
-      fromMem = icache->get_data(attr.set, attr.way, word_offset);
+      // fprintf(stdout, "FLASH load\n");
+      words[beat] = active.flash.read((fetch_addr & FLASH_ADDRESS_MASK) >> 2);
     }
-    else {
-      auto victim = icache->get_victim(attr);
-
-      cache_block blk;
-      blk.set_valid(1);
-      blk.set_tag(load_addr >> (icache->get_set_offset() + icache->get_block_offset()));
-
-      for(uint32_t beat=0; beat<(icache->get_block_size() >> 2); beat++) {
-	auto fetch_addr = load_addr + (beat << 2);
-        if(fetch_addr >= RAM_START) {
-          if(fetch_addr >= (RAM_START + RAM_SIZE_BYTES)) {
-            fprintf(
-                stderr, "Error: ILR Memory access out of range: 0x%8.8X, pc=%x\n", fetch_addr, cpu_get_pc());
-            terminate_simulation(1);
-          }
+  }
+}
 
-          // fprintf(stdout, "RAM load\n");
-          fromMem = ram_load(fetch_addr, false);
-        } else {
-          if(fetch_addr >= (FLASH_START + FLASH_SIZE_BYTES)) {
-            fprintf(
-                stderr, "Error: ILF Memory access out of range: 0x%8.8X, pc=%x\n", fetch_addr, cpu_get_pc());
-            terminate_simulation(1);
-          }
+template <typename Cache>
+uint32_t cached_fetch(Cache &icache, uint32_t address)
+{
+  auto &active = active_machine();
+  uint32_t fromMem;
+  auto word_offset  = (address & icache.get_block_mask()) >> 2; 
+  auto load_addr    = address & (~icache.get_block_mask());
 
-          // fprintf(stdout, "FLASH load\n");
-          fromMem = FLASH_MEMORY[(fetch_addr & FLASH_ADDRESS_MASK) >> 2];
-        }
-        icache->set_data(attr.set, attr.way, beat, fromMem);
-      }
-      icache->cache_insert(attr, blk, false);
-      fromMem = icache->get_data(attr.set, attr.way, word_offset);
+  cache_attr attr;
+  if(icache.is_hit(load_addr, attr)) {
+    icache.cache_read(attr, false);
+    fromMem = icache.get_data(attr.set, attr.way, word_offset);
+  }
+  else {
+    icache.get_victim(attr);
+
+    cache_block blk;
+    blk.set_valid(1);
+    blk.set_tag(load_addr >> (icache.get_set_offset() + icache.get_block_offset()));
+
+    auto const words = icache.get_block_size() >> 2;
+    auto *line = icache.line_data(attr.set, attr.way);
+    if(uint64_t(load_addr) + (words << 2) <= FLASH_START + FLASH_SIZE_BYTES) {
+      active.flash.read((load_addr & FLASH_ADDRESS_MASK) >> 2, line, words);
+    } else if(line_in_ram(load_addr, words)) {
+      ram_load_line(load_addr, line, words, false);
+    } else {
+      fetch_line_by_word(load_addr, line, words);
     }
+
+    icache.cache_insert(attr, blk, false);
+    fromMem = icache.get_data(attr.set, attr.way, word_offset);
+  }
+
+  return fromMem;
+}
+}
+
+uint32_t cache_load(uint32_t address, bool false_read)
+{
+  instrumentation::scoped_timer timer(stage::cache);
+
+  return with_policy(*active_machine().dcache,
+      [&](auto &dcache) { return cached_load(dcache, address, false_read); });
+}
+
+void cache_store(uint32_t address, uint32_t value)
+{
+  instrumentation::scoped_timer timer(stage::cache);
+
+  with_policy(*active_machine().dcache,
+      [&](auto &dcache) { cached_store(dcache, address, value); });
+}
+
+// Memory access functions assume that RAM has a higher address than Flash
+void fetch_instruction(uint32_t address, uint16_t *value)
+{
+  // fprintf(stdout, "In fetch_instruction: address=0x%8.8x\n", address);
+  uint32_t fromMem;
+  auto &active = active_machine();
+  auto &icache = active.icache;
+
+  if(active.icache_profiler != nullptr) {
+    active.icache_profiler->access(address, false);
+  }
+
+  if(icache) {
+    instrumentation::scoped_timer timer(stage::cache);
+    fromMem = with_policy(*icache, [&](auto &typed) { return cached_fetch(typed, address); });
   }
   else {
     if(address >= RAM_START) {
       if(address >= (RAM_START + RAM_SIZE_BYTES)) {
-        fprintf(
-            stderr, "Error: ILR Memory access out of range: 0x%8.8X, pc=%x\n", address, cpu_get_pc());
+        fprintf(stderr, "Error: ILR Memory access out of range: 0x%8.8X, pc=%x%s\n", address,
+            cpu_get_pc(), describe_address(cpu_get_pc() - 4).c_str());
         terminate_simulation(1);
       }
 
@@ -359,13 +496,13 @@ void fetch_instruction(uint32_t address, uint16_t *value)
       fromMem = ram_load(address, false);
     } else {
       if(address >= (FLASH_START + FLASH_SIZE_BYTES)) {
-        fprintf(
-            stderr, "Error: ILF Memory access out of range: 0x%8.8X, pc=%x\n", address, cpu_get_pc());
+        fprintf(stderr, "Error: ILF Memory access out of range: 0x%8.8X, pc=%x%s\n", address,
+            cpu_get_pc(), describe_address(cpu_get_pc() - 4).c_str());
         terminate_simulation(1);
       }
 
       // fprintf(stdout, "FLASH load\n");
-      fromMem = FLASH_MEMORY[(address & FLASH_ADDRESS_MASK) >> 2];
+      fromMem = active.flash.read((address & FLASH_ADDRESS_MASK) >> 2);
     }
   }
 
@@ -375,9 +512,21 @@ void fetch_instruction(uint32_t address, uint16_t *value)
 
 bool load(uint32_t address, uint32_t *value, uint32_t false_read)
 {
-  dcache_hit = false;
+  auto &active = active_machine();
+  active.dcache_hit = false;
+
+  if(active.trace_recorder != nullptr) {
+    active.trace_recorder->record_access(
+        address, 0, false_read ? trace_access::false_load : trace_access::load);
+  }
 
-  if(dcache) {
+  // the reads of byte and halfword stores fill and hit the cache like any other load
+  if(active.dcache_profiler != nullptr && address >= RAM_START
+      && address < (RAM_START + RAM_SIZE_BYTES)) {
+    active.dcache_profiler->access(address, false);
+  }
+
+  if(active.dcache) {
     if(address >= RAM_START && address < (RAM_START + RAM_SIZE_BYTES)) {
       *value = cache_load(address, false_read);
     }
@@ -389,14 +538,24 @@ bool load(uint32_t address, uint32_t *value, uint32_t false_read)
     *value = load_from_memory(address, false_read);
   }
 
-  return dcache_hit;
+  return active.dcache_hit;
 }
 
 bool store(uint32_t address, uint32_t value, bool backup)
 {
-  dcache_hit = false;
+  auto &active = active_machine();
+  active.dcache_hit = false;
+
+  if(active.trace_recorder != nullptr && !backup) {
+    active.trace_recorder->record_access(address, value, trace_access::store);
+  }
+
+  if(active.dcache_profiler != nullptr && !backup && address >= RAM_START
+      && address < (RAM_START + RAM_SIZE_BYTES)) {
+    active.dcache_profiler->access(address, true);
+  }
 
-  if(dcache && !backup) {
+  if(active.dcache && !backup) {
     if(address >= RAM_START && address < (RAM_START + RAM_SIZE_BYTES)) {
       cache_store(address, value);
     }
@@ -408,6 +567,6 @@ bool store(uint32_t address, uint32_t value, bool backup)
     store_in_memory(address, value, backup);
   }
 
-  return dcache_hit;
+  return active.dcache_hit;
 }
 }
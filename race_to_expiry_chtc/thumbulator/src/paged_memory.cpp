@@ -0,0 +1,88 @@
+#include "thumbulator/paged_memory.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace thumbulator {
+
+constexpr size_t paged_memory::PAGE_SIZE_BYTES;
+constexpr size_t paged_memory::PAGE_SIZE_WORDS;
+constexpr size_t paged_memory::NO_PAGE;
+
+paged_memory::paged_memory(size_t size_words)
+    : pages((size_words + PAGE_SIZE_WORDS - 1) / PAGE_SIZE_WORDS)
+    , dirty(pages.size(), false)
+{
+}
+
+void paged_memory::read(size_t first, uint32_t *words, size_t count) const
+{
+  while(count > 0) {
+    auto const offset = first % PAGE_SIZE_WORDS;
+    auto const chunk = std::min(count, PAGE_SIZE_WORDS - offset);
+    auto const page = pages[first / PAGE_SIZE_WORDS].get();
+    if(page == nullptr) {
+      std::fill(words, words + chunk, 0);
+    } else {
+      std::memcpy(words, page + offset, chunk * sizeof(uint32_t));
+    }
+
+    first += chunk;
+    words += chunk;
+    count -= chunk;
+  }
+}
+
+void paged_memory::write(size_t first, uint32_t const *words, size_t count)
+{
+  while(count > 0) {
+    auto const offset = first % PAGE_SIZE_WORDS;
+    auto const chunk = std::min(count, PAGE_SIZE_WORDS - offset);
+    std::memcpy(dirty_page(first / PAGE_SIZE_WORDS) + offset, words, chunk * sizeof(uint32_t));
+
+    first += chunk;
+    words += chunk;
+    count -= chunk;
+  }
+}
+
+void paged_memory::clear_dirty()
+{
+  for(auto const page : dirty_list) {
+    dirty[page] = false;
+  }
+  dirty_list.clear();
+
+  last_written_page = NO_PAGE;
+  last_written_words = nullptr;
+}
+
+void paged_memory::reset()
+{
+  clear_dirty();
+
+  for(auto const page : allocated) {
+    pages[page].reset();
+  }
+  allocated.clear();
+
+  last_read_page = NO_PAGE;
+  last_read_words = nullptr;
+}
+
+uint32_t *paged_memory::dirty_page(size_t page)
+{
+  auto &words = pages[page];
+  if(words == nullptr) {
+    words.reset(new uint32_t[PAGE_SIZE_WORDS]());
+    allocated.push_back(page);
+  }
+
+  if(!dirty[page]) {
+    dirty[page] = true;
+    dirty_list.push_back(page);
+  }
+
+  return words.get();
+}
+}
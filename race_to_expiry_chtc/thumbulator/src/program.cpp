@@ -0,0 +1,226 @@
+#include "thumbulator/program.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include <elf.h>
+
+#include "thumbulator/machine.hpp"
+
+#include "exit.hpp"
+
+namespace thumbulator {
+
+namespace {
+
+std::vector<uint8_t> read_file(std::string const &path_to_binary)
+{
+  std::ifstream file(path_to_binary, std::ios::binary);
+  if(!file.good()) {
+    throw std::runtime_error("Could not open binary file: " + path_to_binary);
+  }
+
+  return std::vector<uint8_t>(
+      std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+bool is_elf(std::vector<uint8_t> const &file)
+{
+  return file.size() >= SELFMAG && std::memcmp(file.data(), ELFMAG, SELFMAG) == 0;
+}
+
+/**
+ * A structure of the file, checked to be within it.
+ */
+template <typename T>
+T const &at(std::vector<uint8_t> const &file, uint64_t offset, std::string const &path_to_binary)
+{
+  if(offset + sizeof(T) > file.size()) {
+    throw std::runtime_error("Truncated ELF file: " + path_to_binary);
+  }
+
+  return *reinterpret_cast<T const *>(file.data() + offset);
+}
+
+void place_in_flash(
+    std::vector<uint32_t> &flash, uint32_t address, uint8_t const *bytes, size_t size)
+{
+  auto const end = static_cast<uint64_t>(address) + size;
+  auto const words = (end + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+  if(flash.size() < words) {
+    flash.resize(words, 0);
+  }
+
+  std::memcpy(reinterpret_cast<uint8_t *>(flash.data()) + address, bytes, size);
+}
+
+void load_symbols(std::vector<uint8_t> const &file,
+    Elf32_Ehdr const &header,
+    symbol_table &symbols,
+    std::string const &path_to_binary)
+{
+  for(unsigned i = 0; i < header.e_shnum; ++i) {
+    auto const &section =
+        at<Elf32_Shdr>(file, header.e_shoff + i * header.e_shentsize, path_to_binary);
+    if(section.sh_type != SHT_SYMTAB || section.sh_entsize < sizeof(Elf32_Sym)) {
+      continue;
+    }
+
+    auto const &strings =
+        at<Elf32_Shdr>(file, header.e_shoff + section.sh_link * header.e_shentsize, path_to_binary);
+    auto const names_end = static_cast<uint64_t>(strings.sh_offset) + strings.sh_size;
+    if(names_end > file.size()) {
+      throw std::runtime_error("Truncated ELF file: " + path_to_binary);
+    }
+
+    for(uint32_t entry = 0; entry < section.sh_size / section.sh_entsize; ++entry) {
+      auto const &symbol =
+          at<Elf32_Sym>(file, section.sh_offset + entry * section.sh_entsize, path_to_binary);
+      auto const type = ELF32_ST_TYPE(symbol.st_info);
+      if((type != STT_FUNC && type != STT_OBJECT) || symbol.st_shndx == SHN_UNDEF
+          || symbol.st_name >= strings.sh_size) {
+        continue;
+      }
+
+      auto const name_offset = strings.sh_offset + symbol.st_name;
+      auto const name = reinterpret_cast<char const *>(file.data() + name_offset);
+      auto const is_function = type == STT_FUNC;
+      // the Thumb bit of a function is not part of its address
+      auto const address = is_function ? symbol.st_value & ~0x1u : symbol.st_value;
+      symbols.add({address, symbol.st_size, is_function,
+          std::string(name, strnlen(name, names_end - name_offset))});
+    }
+  }
+}
+
+program_image load_elf(std::vector<uint8_t> const &file, std::string const &path_to_binary)
+{
+  auto const &header = at<Elf32_Ehdr>(file, 0, path_to_binary);
+  if(header.e_ident[EI_CLASS] != ELFCLASS32 || header.e_ident[EI_DATA] != ELFDATA2LSB
+      || header.e_machine != EM_ARM) {
+    throw std::runtime_error("Not a 32-bit little-endian ARM ELF file: " + path_to_binary);
+  }
+
+  program_image program;
+  for(unsigned i = 0; i < header.e_phnum; ++i) {
+    auto const &segment =
+        at<Elf32_Phdr>(file, header.e_phoff + i * header.e_phentsize, path_to_binary);
+    if(segment.p_type != PT_LOAD || segment.p_filesz == 0) {
+      continue;
+    }
+
+    if(static_cast<uint64_t>(segment.p_offset) + segment.p_filesz > file.size()) {
+      throw std::runtime_error("Truncated ELF file: " + path_to_binary);
+    }
+
+    auto const address = segment.p_paddr;
+    auto const end = static_cast<uint64_t>(address) + segment.p_filesz;
+    auto const bytes = file.data() + segment.p_offset;
+    if(end <= FLASH_START + FLASH_SIZE_BYTES) {
+      place_in_flash(program.flash, address, bytes, segment.p_filesz);
+    } else if(address >= RAM_START && end <= static_cast<uint64_t>(RAM_START) + RAM_SIZE_BYTES) {
+      program.ram.push_back({address, std::vector<uint8_t>(bytes, bytes + segment.p_filesz)});
+    } else {
+      char location[64];
+      std::snprintf(location, sizeof(location), "0x%08X", address);
+      throw std::runtime_error(
+          "Segment at " + std::string(location) + " is outside of memory: " + path_to_binary);
+    }
+  }
+
+  load_symbols(file, header, program.symbols, path_to_binary);
+
+  return program;
+}
+}
+
+void symbol_table::add(program_symbol symbol)
+{
+  auto const position = std::upper_bound(symbols.begin(), symbols.end(), symbol.address,
+      [](uint32_t address, program_symbol const &other) { return address < other.address; });
+  symbols.insert(position, std::move(symbol));
+}
+
+program_symbol const *symbol_table::find(uint32_t address) const
+{
+  auto candidate = std::upper_bound(symbols.begin(), symbols.end(), address,
+      [](uint32_t address, program_symbol const &other) { return address < other.address; });
+
+  // the symbols starting closest before the address, several if they share that address
+  while(candidate != symbols.begin()) {
+    --candidate;
+    if(address - candidate->address < std::max<uint32_t>(candidate->size, 1)) {
+      return &*candidate;
+    }
+    if(candidate == symbols.begin() || std::prev(candidate)->address != candidate->address) {
+      break;
+    }
+  }
+
+  return nullptr;
+}
+
+std::string symbol_table::describe(uint32_t address) const
+{
+  char text[16];
+  auto const symbol = find(address);
+  if(symbol == nullptr) {
+    std::snprintf(text, sizeof(text), "0x%08X", address);
+    return text;
+  }
+
+  if(address == symbol->address) {
+    return symbol->name;
+  }
+
+  std::snprintf(text, sizeof(text), "+0x%X", address - symbol->address);
+  return symbol->name + text;
+}
+
+program_image load_program(std::string const &path_to_binary)
+{
+  auto const file = read_file(path_to_binary);
+  if(is_elf(file)) {
+    return load_elf(file, path_to_binary);
+  }
+
+  // a raw image of the flash
+  program_image program;
+  auto const size = std::min<size_t>(file.size(), FLASH_SIZE_BYTES);
+  place_in_flash(program.flash, FLASH_START, file.data(), size);
+
+  return program;
+}
+
+std::string describe_address(uint32_t address)
+{
+  auto const symbols = active_machine().symbols;
+  if(symbols == nullptr) {
+    return "";
+  }
+
+  return " in " + symbols->describe(address);
+}
+
+void install_program(machine &target, program_image const &program)
+{
+  target.flash.write(0, program.flash.data(), program.flash.size());
+
+  for(auto const &segment : program.ram) {
+    auto address = segment.address;
+    for(auto const byte : segment.bytes) {
+      auto const index = (address & RAM_ADDRESS_MASK) >> 2;
+      auto const shift = (address & 0x3) * 8;
+      auto const word = target.ram.read(index);
+      target.ram.write(index, (word & ~(0xFFu << shift)) | (static_cast<uint32_t>(byte) << shift));
+      address++;
+    }
+  }
+
+  target.symbols = program.symbols.empty() ? nullptr : &program.symbols;
+}
+}
@@ -0,0 +1,148 @@
+#include "thumbulator/stack_distance.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace thumbulator {
+
+constexpr uint32_t stack_distance_profiler::CLEAN;
+
+namespace {
+
+bool is_power_of_two(uint64_t value)
+{
+  return value != 0 && (value & (value - 1)) == 0;
+}
+}
+
+stack_distance_profiler::stack_distance_profiler(uint32_t block_size,
+    uint32_t max_cache_size,
+    size_t max_assoc)
+    : BLOCK_SIZE(block_size)
+    , MAX_CACHE_SIZE(max_cache_size)
+{
+  if(!is_power_of_two(BLOCK_SIZE) || BLOCK_SIZE < 4) {
+    throw std::runtime_error(
+        "Cache profile block size must be a power of two of at least 4 bytes, not "
+        + std::to_string(BLOCK_SIZE) + ".");
+  }
+  if(!is_power_of_two(MAX_CACHE_SIZE) || MAX_CACHE_SIZE < BLOCK_SIZE) {
+    throw std::runtime_error("Cache profile size must be a power of two of at least a block, not "
+                             + std::to_string(MAX_CACHE_SIZE) + ".");
+  }
+
+  while((1u << block_offset) < BLOCK_SIZE) {
+    block_offset++;
+  }
+
+  size_t const max_lines = MAX_CACHE_SIZE / BLOCK_SIZE;
+  for(size_t sets = 1; sets <= max_lines; sets *= 2) {
+    level stacks;
+    stacks.sets = sets;
+    stacks.depth = max_lines / sets;
+    if(max_assoc > 0) {
+      stacks.depth = std::min(stacks.depth, max_assoc);
+    }
+
+    stacks.blocks.assign(sets * stacks.depth, 0);
+    stacks.in_use.assign(sets, 0);
+    stacks.clean_depth.assign(sets * stacks.depth, CLEAN);
+    stacks.load_hits.assign(stacks.depth, 0);
+    stacks.store_hits.assign(stacks.depth, 0);
+    stacks.writebacks.assign(stacks.depth + 1, 0);
+
+    levels.push_back(std::move(stacks));
+  }
+}
+
+void stack_distance_profiler::access(uint32_t address, bool write)
+{
+  auto const block = address >> block_offset;
+  if(write) {
+    stores++;
+  } else {
+    loads++;
+  }
+
+  for(auto &stacks : levels) {
+    auto const set = block & (stacks.sets - 1);
+    auto *blocks = &stacks.blocks[set * stacks.depth];
+    auto *clean_depth = &stacks.clean_depth[set * stacks.depth];
+    auto &in_use = stacks.in_use[set];
+
+    uint32_t depth = 0;
+    while(depth < in_use && blocks[depth] != block) {
+      depth++;
+    }
+
+    uint32_t clean = write ? 0 : CLEAN;
+    if(depth < in_use) {
+      (write ? stacks.store_hits : stacks.load_hits)[depth]++;
+      if(!write) {
+        // caches with no more ways than the depth missed and reloaded the line clean
+        clean = clean_depth[depth] == CLEAN ? CLEAN : std::max(clean_depth[depth], depth);
+      }
+    } else if(in_use < stacks.depth) {
+      in_use++;
+    } else {
+      // the least recent line leaves every cache profiled at this level
+      depth = in_use - 1;
+      if(stacks.depth > clean_depth[depth]) {
+        stacks.writebacks[stacks.depth]++;
+      }
+    }
+
+    // every line above sinks by one and leaves the cache with as many ways as its new depth
+    for(auto above = depth; above > 0; --above) {
+      if(above > clean_depth[above - 1]) {
+        stacks.writebacks[above]++;
+      }
+      blocks[above] = blocks[above - 1];
+      clean_depth[above] = clean_depth[above - 1];
+    }
+
+    blocks[0] = block;
+    clean_depth[0] = clean;
+  }
+}
+
+std::vector<cache_profile_point> stack_distance_profiler::miss_curve(size_t ways) const
+{
+  std::vector<cache_profile_point> curve;
+  if(ways == 0) {
+    auto const &stacks = levels.front();
+    for(size_t lines = 1; lines <= stacks.depth; lines *= 2) {
+      curve.push_back(point(stacks, lines));
+    }
+
+    return curve;
+  }
+
+  for(auto const &stacks : levels) {
+    if(ways <= stacks.depth && stacks.sets * ways * BLOCK_SIZE <= MAX_CACHE_SIZE) {
+      curve.push_back(point(stacks, ways));
+    }
+  }
+
+  return curve;
+}
+
+cache_profile_point stack_distance_profiler::point(level const &stacks, size_t ways) const
+{
+  cache_profile_point result;
+  result.sets = stacks.sets;
+  result.ways = ways;
+  result.size = static_cast<uint32_t>(stacks.sets * ways * BLOCK_SIZE);
+
+  for(size_t depth = 0; depth < ways; ++depth) {
+    result.load_hits += stacks.load_hits[depth];
+    result.store_hits += stacks.store_hits[depth];
+  }
+  result.load_misses = loads - result.load_hits;
+  result.store_misses = stores - result.store_hits;
+  result.writebacks = stacks.writebacks[ways];
+
+  return result;
+}
+}
@@ -0,0 +1,168 @@
+#include <thumbulator/benchmark.hpp>
+#include <thumbulator/cpu.hpp>
+#include <thumbulator/decode.hpp>
+#include <thumbulator/machine.hpp>
+#include <thumbulator/program.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+double milliseconds_since(clock_type::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+/**
+ * The name of a benchmark in reports: the directory of a MiBench-style BENCHMARK/main.bin, the
+ * file name otherwise.
+ */
+std::string benchmark_name(std::string const &path)
+{
+  auto const slash = path.rfind('/');
+  auto const file = slash == std::string::npos ? path : path.substr(slash + 1);
+  if(file != "main.bin" || slash == std::string::npos || slash == 0) {
+    return file;
+  }
+
+  auto const parent = path.rfind('/', slash - 1);
+  return path.substr(parent == std::string::npos ? 0 : parent + 1,
+      slash - (parent == std::string::npos ? 0 : parent + 1));
+}
+
+/**
+ * Execute a benchmark without interruption, as fast as the simulator goes.
+ */
+void run(std::string const &path_to_binary,
+    uint64_t max_instructions,
+    thumbulator::benchmark::measurement &measured)
+{
+  auto const start = clock_type::now();
+
+  auto const program = thumbulator::load_program(path_to_binary);
+
+  thumbulator::machine machine;
+  thumbulator::machine_scope scope(machine);
+  thumbulator::install_program(machine, program);
+  thumbulator::cpu_reset();
+  // PC seen is PC + 4
+  thumbulator::cpu_set_pc(thumbulator::cpu_get_pc() + 0x4);
+
+  measured.startup_ms = milliseconds_since(start);
+  auto const run_start = clock_type::now();
+
+  uint64_t instructions = 0;
+  while(!machine.exit_instruction_encountered && instructions < max_instructions) {
+    machine.branch_was_taken = false;
+
+    thumbulator::exmemwb(thumbulator::fetch_predecoded(thumbulator::cpu_get_pc() - 0x4));
+    instructions++;
+
+    if(!machine.branch_was_taken) {
+      thumbulator::cpu_set_pc(thumbulator::cpu_get_pc() + 0x2);
+    } else {
+      thumbulator::cpu_set_pc(thumbulator::cpu_get_pc() + 0x4);
+    }
+  }
+
+  measured.run_ms = milliseconds_since(run_start);
+  measured.instructions = instructions;
+}
+}
+
+/**
+ * Measure the simulation speed of thumbulator on benchmarks and check it against a baseline.
+ *
+ * thumbulator-bench [--baseline=FILE] [--threshold=PERCENT] [--output=FILE] [--repeat=N]
+ *                   [--max-instructions=N] BINARY...
+ *
+ * Fails if any benchmark regressed by more than the threshold (default 10%) against the baseline.
+ */
+int main(int argc, char *argv[])
+{
+  std::string path_to_baseline;
+  std::string path_to_output;
+  double threshold = 10.0;
+  unsigned repetitions = 1;
+  uint64_t max_instructions = UINT64_MAX;
+  std::vector<std::string> paths;
+
+  auto const value_of = [](char const *argument, char const *option) -> char const * {
+    auto const length = std::strlen(option);
+    return std::strncmp(argument, option, length) == 0 ? argument + length : nullptr;
+  };
+
+  for(int i = 1; i < argc; ++i) {
+    char const *value = nullptr;
+    if((value = value_of(argv[i], "--baseline=")) != nullptr) {
+      path_to_baseline = value;
+    } else if((value = value_of(argv[i], "--threshold=")) != nullptr) {
+      threshold = std::strtod(value, nullptr);
+    } else if((value = value_of(argv[i], "--output=")) != nullptr) {
+      path_to_output = value;
+    } else if((value = value_of(argv[i], "--repeat=")) != nullptr) {
+      repetitions = std::max(1ul, std::strtoul(value, nullptr, 10));
+    } else if((value = value_of(argv[i], "--max-instructions=")) != nullptr) {
+      max_instructions = std::strtoull(value, nullptr, 10);
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+
+  if(paths.empty()) {
+    std::cerr << "thumbulator-bench [--baseline=FILE] [--threshold=PERCENT] [--output=FILE] "
+                 "[--repeat=N] [--max-instructions=N] BINARY...\n";
+    return EXIT_FAILURE;
+  }
+
+  try {
+    // a missing baseline fails before the benchmarks run
+    std::vector<thumbulator::benchmark::measurement> baseline;
+    if(!path_to_baseline.empty()) {
+      baseline = thumbulator::benchmark::read_json(path_to_baseline);
+    }
+
+    std::vector<thumbulator::benchmark::measurement> results;
+    for(auto const &path : paths) {
+      results.push_back(thumbulator::benchmark::run_isolated(benchmark_name(path),
+          [&](thumbulator::benchmark::measurement &measured) {
+            run(path, max_instructions, measured);
+          },
+          repetitions));
+    }
+
+    thumbulator::benchmark::print_table(std::cout, results);
+
+    if(!path_to_output.empty()) {
+      std::ofstream output(path_to_output);
+      thumbulator::benchmark::write_json(output, results);
+    }
+
+    if(!path_to_baseline.empty()) {
+      auto const regressed =
+          thumbulator::benchmark::compare(results, baseline, threshold, std::cout);
+      if(regressed > 0) {
+        std::cout << regressed << " benchmarks regressed by more than " << threshold
+                  << "% or did not run\n";
+        return EXIT_FAILURE;
+      }
+    } else {
+      std::cerr << "Warning: no --baseline, the results are not checked for regressions\n";
+    }
+  } catch(std::exception const &e) {
+    std::cerr << "Error: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,127 @@
+#include <thumbulator/cpu.hpp>
+#include <thumbulator/decode.hpp>
+#include <thumbulator/execution_trace.hpp>
+#include <thumbulator/machine.hpp>
+#include <thumbulator/memory.hpp>
+#include <thumbulator/program.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * The address exmemwb_mock reports for the next instruction, as seen by the optimal backup policy.
+ */
+uint32_t probe_address(thumbulator::predecoded_instruction const &predecoded)
+{
+  auto &machine = thumbulator::active_machine();
+
+  bool is_memwr = false;
+  bool is_memop = false;
+  bool is_branch = false;
+  bool is_branch_link = false;
+  uint32_t num_mem_access = 0;
+
+  machine.mock_exmemwb = true;
+  auto const address = thumbulator::exmemwb_mock(predecoded.instruction, &predecoded.decoded,
+      is_memwr, is_memop, is_branch, is_branch_link, num_mem_access);
+  machine.mock_exmemwb = false;
+
+  return address;
+}
+
+/**
+ * Execute a benchmark without interruption and record every instruction.
+ *
+ * @return The number of instructions recorded.
+ */
+uint64_t record(char const *path_to_binary, char const *path_to_trace, uint64_t max_instructions)
+{
+  auto const program = thumbulator::load_program(path_to_binary);
+
+  thumbulator::machine machine;
+  thumbulator::machine_scope scope(machine);
+  thumbulator::trace_writer writer(path_to_trace);
+  machine.trace_recorder = &writer;
+
+  thumbulator::install_program(machine, program);
+  thumbulator::cpu_reset();
+  // PC seen is PC + 4
+  thumbulator::cpu_set_pc(thumbulator::cpu_get_pc() + 0x4);
+
+  while(!machine.exit_instruction_encountered && writer.num_records() < max_instructions) {
+    machine.branch_was_taken = false;
+
+    auto const pc = thumbulator::cpu_get_pc() - 0x4;
+    auto const &predecoded = thumbulator::fetch_predecoded(pc);
+    auto const probe = probe_address(predecoded);
+
+    // the dirty bits tell which registers the instruction writes
+    uint16_t dirty = 0;
+    for(int i = 0; i < 16; ++i) {
+      dirty |= machine.cpu.gpr[i][1] << i;
+      machine.cpu.gpr[i][1] = 0;
+    }
+
+    auto const ticks = thumbulator::exmemwb(predecoded);
+
+    uint16_t written = 0;
+    for(int i = 0; i < 16; ++i) {
+      written |= machine.cpu.gpr[i][1] << i;
+      machine.cpu.gpr[i][1] |= (dirty >> i) & 1;
+    }
+
+    writer.record_instruction(pc, predecoded.instruction, written, ticks, probe);
+
+    if(!machine.branch_was_taken) {
+      thumbulator::cpu_set_pc(thumbulator::cpu_get_pc() + 0x2);
+    } else {
+      thumbulator::cpu_set_pc(thumbulator::cpu_get_pc() + 0x4);
+    }
+  }
+
+  writer.close();
+  return writer.num_records();
+}
+}
+
+/**
+ * Record the execution trace of benchmarks, for replay by eh-sim --replay-trace.
+ *
+ * record-trace [--max-instructions=N] BINARY TRACE
+ */
+int main(int argc, char *argv[])
+{
+  uint64_t max_instructions = UINT64_MAX;
+  std::vector<char const *> paths;
+
+  std::string const limit_option = "--max-instructions=";
+  for(int i = 1; i < argc; ++i) {
+    if(std::strncmp(argv[i], limit_option.c_str(), limit_option.size()) == 0) {
+      max_instructions = std::strtoull(argv[i] + limit_option.size(), nullptr, 10);
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+
+  if(paths.size() != 2) {
+    std::cerr << "record-trace [--max-instructions=N] BINARY TRACE\n";
+    return EXIT_FAILURE;
+  }
+
+  try {
+    auto const instructions = record(paths[0], paths[1], max_instructions);
+    std::cout << paths[1] << ": " << instructions << " instructions recorded\n";
+  } catch(std::exception const &e) {
+    std::cerr << paths[0] << ": " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,185 @@
+#include <thumbulator/cpu.hpp>
+#include <thumbulator/decode.hpp>
+#include <thumbulator/machine.hpp>
+#include <thumbulator/memory.hpp>
+#include <thumbulator/program.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * The last store the program made, to compare memory side effects of both cores.
+ */
+struct store_record {
+  uint32_t address = 0;
+  uint32_t value = 0;
+  uint64_t count = 0;
+
+  bool operator==(store_record const &other) const
+  {
+    return address == other.address && value == other.value && count == other.count;
+  }
+};
+
+/**
+ * One machine executing a benchmark with either the reference or the threaded core.
+ */
+struct core {
+  core(thumbulator::program_image const &program, bool threaded) : threaded(threaded)
+  {
+    thumbulator::machine_scope scope(machine);
+
+    machine.ram_store_hook = thumbulator::ram_store_function::bind<core, &core::record_store>(this);
+
+    thumbulator::install_program(machine, program);
+    thumbulator::cpu_reset();
+    // PC seen is PC + 4
+    thumbulator::cpu_set_pc(thumbulator::cpu_get_pc() + 0x4);
+  }
+
+  /**
+   * Execute one instruction.
+   *
+   * @return The number of cycles taken.
+   */
+  uint32_t step()
+  {
+    thumbulator::machine_scope scope(machine);
+    machine.branch_was_taken = false;
+
+    uint32_t ticks;
+    if(threaded) {
+      ticks = thumbulator::exmemwb_threaded(
+          thumbulator::fetch_predecoded(thumbulator::cpu_get_pc() - 0x4));
+    } else {
+      // the original fetch, decode, and two-level jump table dispatch
+      uint16_t instruction;
+      thumbulator::fetch_instruction(thumbulator::cpu_get_pc() - 0x4, &instruction);
+      auto const decoded = thumbulator::decode(instruction);
+      ticks = thumbulator::exmemwb(instruction, &decoded);
+    }
+
+    if(!machine.branch_was_taken) {
+      thumbulator::cpu_set_pc(thumbulator::cpu_get_pc() + 0x2);
+    } else {
+      thumbulator::cpu_set_pc(thumbulator::cpu_get_pc() + 0x4);
+    }
+
+    return ticks;
+  }
+
+  uint32_t record_store(uint32_t address, uint32_t, uint32_t value, bool)
+  {
+    last_store.address = address;
+    last_store.value = value;
+    last_store.count++;
+
+    return value;
+  }
+
+  thumbulator::machine machine;
+  bool const threaded;
+  store_record last_store;
+};
+
+bool same_state(core const &reference, core const &threaded)
+{
+  auto const &a = reference.machine;
+  auto const &b = threaded.machine;
+
+  return std::memcmp(&a.cpu, &b.cpu, sizeof(a.cpu)) == 0
+         && std::memcmp(&a.systick, &b.systick, sizeof(a.systick)) == 0
+         && a.exit_instruction_encountered == b.exit_instruction_encountered
+         && reference.last_store == threaded.last_store;
+}
+
+void print_state(std::ostream &stream, char const *name, core const &state)
+{
+  auto const &cpu = state.machine.cpu;
+
+  stream << "  " << name << ":";
+  for(int i = 0; i < 16; ++i) {
+    stream << " r" << i << "=0x" << std::hex << cpu.gpr[i][0] << std::dec;
+  }
+  stream << " apsr=0x" << std::hex << cpu.apsr << " last store [0x" << state.last_store.address
+         << "]=0x" << state.last_store.value << std::dec << "\n";
+}
+
+/**
+ * Run a benchmark on both cores in lock step.
+ *
+ * @return true if both cores agree after every instruction.
+ */
+bool validate(char const *path_to_binary, uint64_t max_instructions)
+{
+  auto const program = thumbulator::load_program(path_to_binary);
+  core reference(program, false);
+  core threaded(program, true);
+
+  uint64_t instructions = 0;
+  while(!reference.machine.exit_instruction_encountered && instructions < max_instructions) {
+    auto const pc = reference.machine.cpu.gpr[15][0] - 0x4;
+    auto const reference_ticks = reference.step();
+    auto const threaded_ticks = threaded.step();
+    ++instructions;
+
+    if(reference_ticks != threaded_ticks || !same_state(reference, threaded)) {
+      std::cout << path_to_binary << ": cores diverge at instruction " << instructions << " (pc 0x"
+                << std::hex << pc << std::dec << ", " << reference_ticks << " vs. "
+                << threaded_ticks << " cycles)\n";
+      print_state(std::cout, "reference", reference);
+      print_state(std::cout, "threaded", threaded);
+      return false;
+    }
+  }
+
+  std::cout << path_to_binary << ": " << instructions << " instructions match\n";
+  return true;
+}
+}
+
+/**
+ * Check the threaded core against the jump table core, instruction by instruction.
+ *
+ * validate-dispatch [--max-instructions=N] BINARY [BINARY...]
+ */
+int main(int argc, char *argv[])
+{
+  uint64_t max_instructions = UINT64_MAX;
+  std::vector<char const *> binaries;
+
+  std::string const limit_option = "--max-instructions=";
+  for(int i = 1; i < argc; ++i) {
+    if(std::strncmp(argv[i], limit_option.c_str(), limit_option.size()) == 0) {
+      max_instructions = std::strtoull(argv[i] + limit_option.size(), nullptr, 10);
+    } else {
+      binaries.push_back(argv[i]);
+    }
+  }
+
+  if(binaries.empty()) {
+    std::cerr << "validate-dispatch [--max-instructions=N] BINARY [BINARY...]\n";
+    return EXIT_FAILURE;
+  }
+
+  int result = EXIT_SUCCESS;
+  for(auto const binary : binaries) {
+    try {
+      if(!validate(binary, max_instructions)) {
+        result = EXIT_FAILURE;
+      }
+    } catch(std::exception const &e) {
+      std::cerr << binary << ": " << e.what() << "\n";
+      result = EXIT_FAILURE;
+    }
+  }
+
+  return result;
+}